@@ -0,0 +1,37 @@
+#version 450
+
+// texture.vert that also passes on the material of the instance, see
+// BindlessTextures
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(set = 0, binding = 0) uniform UBO {
+    mat4 view;
+    mat4 proj;
+    vec4 cameraPos;
+} ubo;
+
+// one per instance, from the instance buffer
+layout(location = 3) in mat4 inModel;
+layout(location = 8) in uint inMaterial;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 fragPos;
+layout(location = 3) out vec3 viewPos;
+layout(location = 4) flat out uint outMaterial;
+
+void main() {    
+    fragPos = vec3(inModel * vec4(inPosition, 1.0));
+
+    outNormal = mat3(transpose(inverse(inModel))) * inNormal;  
+
+    viewPos = vec3(ubo.cameraPos);
+    fragTexCoord = inTexCoord;
+
+    gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 1.0);
+
+    outMaterial = inMaterial;
+}
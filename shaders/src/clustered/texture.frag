@@ -0,0 +1,342 @@
+#version 450
+
+// texture.frag with the lights of the cluster the fragment falls in instead
+// of fixed arrays, see ClusteredLights. built a second time with -DBINDLESS
+// into bindless_texture_frag.spv for the BindlessTextures path
+
+#ifdef BINDLESS
+layout(set = 2, binding = 0) uniform sampler2D textures[1024];
+
+layout(location = 4) flat in uint material;
+
+// one slot per texture, diffuse in the low 16 bits and specular above
+#define diffuseTexSampler textures[material & 0xffffu]
+#define specularTexSampler textures[material >> 16]
+#else
+layout(set = 2, binding = 0) uniform sampler2D diffuseTexSampler;
+layout(set = 2, binding = 1) uniform sampler2D specularTexSampler;
+#endif
+
+layout(set = 3, binding = 0) uniform sampler2D directionalShadowMap;
+layout(set = 3, binding = 1) uniform sampler2D spotPointShadowAtlas;
+
+layout(set = 1, binding = 0) uniform DirectionalLight{
+    vec4 direction;
+    vec4 color;
+    mat4 transform;
+} directionalLight;
+
+layout(set = 1, binding = 1) uniform Clusters {
+    mat4 view;
+    mat4 inverseProjection;
+    uvec4 grid; // w: most lights a cluster holds
+    vec4 tileSize;
+    vec4 depthSlices; // slice = log(depth) * x + y, z: cutoff
+    uvec4 lightCounts;
+} clusters;
+
+struct PointLight {
+    vec4 position;
+    vec4 color;
+    mat4 transform[6];
+    vec4 atlasCoordsPixel[6];
+    vec4 atlasCoordsNormalized[6];
+};
+
+layout(set = 1, binding = 2) readonly buffer PointLights {
+    PointLight pointLights[];
+} pointLights;
+
+struct SpotLight {
+  vec4 position;
+  vec4 direction;
+  vec4 color;
+  vec4 cutoff;
+  mat4 transform;
+  vec4 atlasCoordsPixel;
+  vec4 atlasCoordsNormalized;
+};
+
+layout(set = 1, binding = 3) readonly buffer SpotLights {
+    SpotLight spotLights[];
+} spotLights;
+
+// a (point, spot) count per cluster, then grid.w indices per cluster
+layout(set = 1, binding = 4) readonly buffer ClusterLights {
+    uint clusterLights[];
+};
+
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec3 fragPos;
+layout(location = 3) in vec3 viewPos;
+
+layout(location = 0) out vec4 outColor;
+
+float linear = 0.09;
+float quadratic = 0.032;
+
+vec3 baseAmbient = vec3(0.2f, 0.2f, 0.2f);
+vec3 baseDiffuse = vec3(0.5f, 0.5f, 0.5f);
+vec3 baseSpecular = vec3(1.0f, 1.0f, 1.0f);
+
+float CalculateShadow(vec4 fragPosLightSpace); 
+float CalculateShadow(vec4 fragPosLightSpavce, vec4 atlasCoords);
+vec3 CalcDirLight(vec3 lightDir, vec4 color, vec3 normal, vec3 viewDir);
+float RangeWindow(float distance, vec4 color);
+vec3 CalcPointLight(PointLight pointLight, vec3 normal, vec3 fragPos, vec3 viewDir);
+// vec3 CalcSpotLights(SpotLight spotlight, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcSpotLights(vec3 lightPos, vec3 lightDirection, vec4 lightColor, vec2 cutoff, vec3 normal, vec3 fragPos, vec3 viewDir, vec4 altasCoords, mat4 lightTransform);
+
+void main() {
+ vec3 norm = normalize(normal);
+ vec3 viewDir = normalize(viewPos - fragPos);
+
+ vec3 result = 0.2 * CalcDirLight(vec3(directionalLight.direction.xyz), directionalLight.color, norm, viewDir);
+
+ float depth = -(clusters.view * vec4(fragPos, 1.0)).z;
+ uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy / clusters.tileSize.xy),
+                       uint(max(log(depth) * clusters.depthSlices.x + clusters.depthSlices.y, 0.0)));
+ cluster = min(cluster, clusters.grid.xyz - 1u);
+ uint clusterIndex = (cluster.z * clusters.grid.y + cluster.y) * clusters.grid.x + cluster.x;
+ uint clusterCount = clusters.grid.x * clusters.grid.y * clusters.grid.z;
+
+ uint pointCount = clusterLights[2 * clusterIndex];
+ uint spotCount = clusterLights[2 * clusterIndex + 1];
+ uint first = 2 * clusterCount + clusterIndex * clusters.grid.w;
+
+ for(uint i = 0; i < pointCount; i++) {
+     result += CalcPointLight(pointLights.pointLights[clusterLights[first + i]], norm, fragPos, viewDir);
+ }
+
+ for(uint i = pointCount; i < pointCount + spotCount; i++) {
+    SpotLight spotLight = spotLights.spotLights[clusterLights[first + i]];
+    result += CalcSpotLights(vec3(spotLight.position.xyz), vec3(spotLight.direction.xyz), spotLight.color, vec2(spotLight.cutoff.xy), norm, fragPos, viewDir, spotLight.atlasCoordsNormalized, spotLight.transform);
+ }
+
+ outColor = vec4(result, 1.0);
+}
+
+float CalculateShadow(vec4 fragPosLightSpace)
+{
+	float shadow = 0.0;
+    fragPosLightSpace.st = fragPosLightSpace.st * 0.5 + 0.5;
+    
+	if (fragPosLightSpace.z > -1.0 && fragPosLightSpace.z < 1.0) {
+		float dist = texture(directionalShadowMap, fragPosLightSpace.st).r;
+		if (fragPosLightSpace.w > 0.0 && dist < fragPosLightSpace.z) {
+			shadow = 1.0;
+		}
+	}
+	return shadow;
+}
+
+float CalculateShadow(vec4 fragPosLightSpace, vec4 atlasCoords)
+{    
+    fragPosLightSpace.st = fragPosLightSpace.st * 0.5 + 0.5;
+
+    if (fragPosLightSpace.z < -1.0 || fragPosLightSpace.z > 1.0 ||
+        fragPosLightSpace.x < -1.0 || fragPosLightSpace.x > 1.0 ||
+        fragPosLightSpace.y < -1.0 || fragPosLightSpace.y > 1.0) {
+        return 0.0;
+    }
+        
+    vec2 atlasUV = atlasCoords.xy + fragPosLightSpace.xy * atlasCoords.zw;
+    
+    float closestDepth = texture(spotPointShadowAtlas, atlasUV).r;
+    float currentDepth = fragPosLightSpace.z;
+    
+    float shadow = (currentDepth) > closestDepth ? 1.0 : 0.0;
+    
+    return shadow;
+}
+
+// fades a light out towards the distance ClusteredLights assigned it up to,
+// so it reaches zero before the clusters stop listing it
+float RangeWindow(float distance, vec4 color)
+{
+    float range = sqrt(max(color.r, max(color.g, color.b)) / clusters.depthSlices.z);
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window;
+}
+
+vec3 CalcDirLight(vec3 lightDir, vec4 color, vec3 normal, vec3 viewDir)
+{
+    lightDir = normalize(-lightDir);
+
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    // specular shading
+    // phong
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+
+    // blinn-phong 
+    // vec3 halfwayDir = normalize(lightDir + viewDir);  
+    // float spec = pow(max(dot(normal, halfwayDir), 0.0), 16.0);
+
+    // combine results
+    vec3 ambient = baseAmbient * color.xyz * vec3(texture(diffuseTexSampler, fragTexCoord));
+    vec3 diffuse = baseDiffuse * color.xyz * diff * vec3(texture(diffuseTexSampler, fragTexCoord));
+    vec3 specular = baseSpecular * color.xyz * spec * vec3(texture(specularTexSampler, fragTexCoord));
+
+    vec4 fragPosLightSpace = directionalLight.transform * vec4(fragPos, 1.0);
+
+    float shadow = 0;
+
+    if(color.w == 1.0) {
+        shadow = CalculateShadow(fragPosLightSpace / fragPosLightSpace.w);
+    }
+
+    return ambient + ((1.0 - shadow) * (diffuse + specular));
+    // return (ambient + diffuse + specular);
+}
+
+vec3 CalcPointLight(PointLight pointLight, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(pointLight.position.xyz - fragPos);
+
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    // specular shading
+    // phong
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+
+    // blinn-phong 
+    // vec3 halfwayDir = normalize(lightDir + viewDir);  
+    // float spec = pow(max(dot(normal, halfwayDir), 0.0), 16.0);
+
+    // attenuation
+    float distance = length(fragPos - pointLight.position.xyz);
+
+    // float attenuation = 1.0 / (1.0 + linear * distance + quadratic * (distance * distance));    
+    float attenuation = RangeWindow(distance, pointLight.color) / (distance * distance);
+
+    float shadow = 0;
+    if(pointLight.color.w == 1.0) {
+        vec3 fragToLight = fragPos - pointLight.position.xyz;
+        vec3 absFragToLight = abs(fragToLight);
+        
+        float maxComponent = max(absFragToLight.x, max(absFragToLight.y, absFragToLight.z));
+
+        int faceIndex = 0;
+        if (maxComponent == absFragToLight.x) {
+            faceIndex = (fragToLight.x > 0.0) ? 3 : 2; // RIGHT=3, LEFT=2
+        } else if (maxComponent == absFragToLight.y) {
+            faceIndex = (fragToLight.y > 0.0) ? 0 : 1; // UP=0, DOWN=1
+        } else {
+            faceIndex = (fragToLight.z > 0.0) ? 4 : 5; // FORWARD=4, BACK=5
+        }
+
+        // vec3 isMax = step(absFragToLight.yxx, absFragToLight) * step(absFragToLight.zzy, absFragToLight);
+        // vec3 faceSign = sign(fragToLight);
+        // int faceIndex = int(dot(isMax, vec3(3, 2, 4)) + dot(faceSign * isMax, vec3(1, 1, 1)));
+
+        mat4 transformMatrix;
+        vec4 atlasCoords;
+        switch(faceIndex) {
+        case 0: 
+            transformMatrix = pointLight.transform[0];
+            atlasCoords = pointLight.atlasCoordsNormalized[0];
+            break;
+        case 1:
+            transformMatrix = pointLight.transform[1];
+            atlasCoords = pointLight.atlasCoordsNormalized[1];
+            break;
+        case 2:
+            transformMatrix = pointLight.transform[2];
+            atlasCoords = pointLight.atlasCoordsNormalized[2];
+            break;
+        case 3:
+            transformMatrix = pointLight.transform[3];
+            atlasCoords = pointLight.atlasCoordsNormalized[3];
+            break;
+        case 4:
+            transformMatrix = pointLight.transform[4];
+            atlasCoords = pointLight.atlasCoordsNormalized[4];
+            break;
+        case 5:
+            transformMatrix = pointLight.transform[5];
+            atlasCoords = pointLight.atlasCoordsNormalized[5];
+            break;
+        }
+
+        // vec4 fragPosLightSpace = pointLight.transform[faceIndex]* vec4(fragPos, 1.0);
+        vec4 fragPosLightSpace = transformMatrix * vec4(fragPos, 1.0);
+
+        shadow = CalculateShadow(fragPosLightSpace / fragPosLightSpace.w, atlasCoords);
+        // shadow = CalculateShadow(fragPosLightSpace / fragPosLightSpace.w, pointLight.atlasCoordsNormalized[faceIndex]);
+    }
+
+    // combine results
+    // vec3 resultAmbient = baseAmbient * pointLight.color.xyz * vec3(texture(diffuseTexSampler, fragTexCoord));
+    vec3 resultDiffuse = baseDiffuse * pointLight.color.xyz * diff * vec3(texture(diffuseTexSampler, fragTexCoord));
+    vec3 resultSpecular = baseSpecular * pointLight.color.xyz * spec * vec3(texture(specularTexSampler, fragTexCoord));
+    // resultAmbient *= attenuation;
+    vec3 resultAmbient = vec3(0);
+    resultDiffuse *= attenuation;
+    resultSpecular *= attenuation;
+    // return (resultAmbient + resultDiffuse + resultSpecular);
+    return resultAmbient + ((1.0 - shadow) * (resultDiffuse + resultSpecular));
+}
+
+// vec3 CalcSpotLights(SpotLight spotLight, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcSpotLights(vec3 lightPos, vec3 lightDirection, vec4 lightColor, vec2 cutoff, vec3 normal, vec3 fragPos, vec3 viewDir, vec4 atlasCoords, mat4 lightTransform)
+{
+    // vec3 lightDir = normalize(spotLight.position.xyz - fragPos);
+    vec3 lightDir = normalize(lightPos - fragPos);
+
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    // specular shading phong
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+
+    // specular blinn-phong 
+    // vec3 halfwayDir = normalize(lightDir + viewDir);  
+    // float spec = pow(max(dot(normal, halfwayDir), 0.0), 16.0);
+
+    // attenuation
+    // float distance = length(fragPos - spotLight.position.xyz);
+    float distance = length(fragPos - lightPos);
+
+    // float innerCutoff = cos(radians(spotLight.cutoff.x));
+    // float outerCutoff = cos(radians(spotLight.cutoff.x));
+    float innerCutoff = cos(radians(cutoff.x));
+    float outerCutoff = cos(radians(cutoff.y));
+
+    // float theta = dot(lightDir, normalize(-spotLight.direction.xyz));
+    float theta = dot(lightDir, normalize(-lightDirection));
+    float epsilon = (innerCutoff - outerCutoff);
+    float intensity = clamp((theta - outerCutoff) / epsilon, 0.0, 1.0);
+    diff *= intensity;
+    spec *= intensity;
+
+    // float attenuation = 1.0 / (1.0 + linear * distance + quadratic * (distance * distance));    
+    float attenuation = RangeWindow(distance, lightColor) / (distance * distance);
+
+    // vec4 fragPosLightSpace = spotLight.transform * vec4(fragPos, 1.0);
+    vec4 fragPosLightSpace = lightTransform * vec4(fragPos, 1.0);
+
+    float shadow = 0;
+    // if(spotLight.color.w == 1.0) {
+    if(lightColor.w == 1.0) {
+        // shadow = CalculateShadow(fragPosLightSpace / fragPosLightSpace.w, spotLight.atlasCoordsNormalized);
+        shadow = CalculateShadow(fragPosLightSpace / fragPosLightSpace.w, atlasCoords);
+    }
+
+    // combine results
+    vec3 resultAmbient = vec3(0);
+    // vec3 resultAmbient = baseAmbient * spotLight.color.xyz * vec3(texture(diffuseTexSampler, fragTexCoord));
+    vec3 resultDiffuse = baseDiffuse * lightColor.xyz * diff * vec3(texture(diffuseTexSampler, fragTexCoord));
+    vec3 resultSpecular = baseSpecular * lightColor.xyz * spec * vec3(texture(specularTexSampler, fragTexCoord));
+    // resultAmbient *= attenuation;
+    resultDiffuse *= attenuation;
+    resultSpecular *= attenuation;
+    return resultAmbient + ((1.0 - shadow) * (resultDiffuse + resultSpecular));
+}
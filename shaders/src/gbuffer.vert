@@ -10,20 +10,19 @@ layout(binding = 0) uniform UBO {
     vec4 cameraPos;
 } ubo;
 
-layout(push_constant) uniform Model {
-    mat4 model;
-};
+// one per instance, from the instance buffer
+layout(location = 3) in mat4 inModel;
 
 layout(location = 0) out vec3 fragPos;
 layout(location = 1) out vec2 texCoord;
 layout(location = 2) out vec3 normal;
 
 void main() {
-    vec4 worldPos = model * vec4(inPosition, 1.0);
+    vec4 worldPos = inModel * vec4(inPosition, 1.0);
     fragPos = worldPos.xyz;
     texCoord = inTexCoords;
     
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
+    mat3 normalMatrix = transpose(inverse(mat3(inModel)));
     normal = normalMatrix * inNormal;
 
     gl_Position = ubo.proj * ubo.view * worldPos;
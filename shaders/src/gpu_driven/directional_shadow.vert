@@ -0,0 +1,29 @@
+#version 450
+
+// shadows/directional_shadow.vert with the model matrix read from the
+// instance the draw was culled for, see GpuCuller
+
+layout (location = 0) in vec3 inPos;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(push_constant) uniform UBO {
+    mat4 lightSpaceMatrix;
+} ubo;
+
+struct Instance {
+    mat4 transformation;
+    vec4 worldMin;
+    vec4 worldMax;
+    uvec4 ids;
+};
+
+layout(set = 0, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+void main()
+{
+	gl_Position = ubo.lightSpaceMatrix *
+	              instances[gl_InstanceIndex].transformation * vec4(inPos, 1.0);
+}
@@ -0,0 +1,47 @@
+#version 450
+
+// texture.vert with the model matrix read from the instance the draw was
+// culled for, see GpuCuller
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(set = 0, binding = 0) uniform UBO {
+    mat4 view;
+    mat4 proj;
+    vec4 cameraPos;
+} ubo;
+
+struct Instance {
+    mat4 transformation;
+    vec4 worldMin;
+    vec4 worldMax;
+    uvec4 ids;
+};
+
+layout(set = 4, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec3 fragPos;
+layout(location = 3) out vec3 viewPos;
+// for bindless/texture.frag, the other fragment shader ignores it
+layout(location = 4) flat out uint outMaterial;
+
+void main() {
+    mat4 model = instances[gl_InstanceIndex].transformation;
+
+    fragPos = vec3(model * vec4(inPosition, 1.0));
+
+    outNormal = mat3(transpose(inverse(model))) * inNormal;
+
+    viewPos = vec3(ubo.cameraPos);
+    fragTexCoord = inTexCoord;
+
+    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
+
+    outMaterial = instances[gl_InstanceIndex].ids.y;
+}
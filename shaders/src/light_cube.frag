@@ -2,9 +2,7 @@
 
 layout(location = 0) out vec4 outColor;
 
-layout(push_constant) uniform LightColor {
-    layout(offset = 64) vec4 lightColor;
-};
+layout(location = 0) in vec4 lightColor;
 
 void main() {
     outColor = lightColor;
@@ -10,10 +10,13 @@ layout(binding = 0) uniform UBO {
     vec4 cameraPos;
 } ubo;
 
-layout(push_constant) uniform Model {
-    mat4 model;
-};
+// one per instance, from the instance buffer
+layout(location = 3) in mat4 inModel;
+layout(location = 7) in vec4 inColor;
+
+layout(location = 0) out vec4 lightColor;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 1.0);
+    lightColor = inColor;
 }
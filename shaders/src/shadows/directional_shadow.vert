@@ -3,6 +3,8 @@
 layout (location = 0) in vec3 inPos;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoord;
+// one per instance, from the instance buffer
+layout(location = 3) in mat4 inModel;
 
 layout(push_constant) uniform UBO {
     mat4 lightSpaceMatrix;
@@ -10,5 +12,5 @@ layout(push_constant) uniform UBO {
 
 void main()
 {
-	gl_Position =  ubo.lightSpaceMatrix * vec4(inPos, 1.0);
+	gl_Position =  ubo.lightSpaceMatrix * inModel * vec4(inPos, 1.0);
 }
@@ -20,7 +20,9 @@ struct PointLight {
     vec4 atlasCoordsNormalized[6];
 };
 
-#define NR_POINT_LIGHTS 5
+// MAX_POINT_LIGHTS and MAX_SPOT_LIGHTS of LightManager.h, set by
+// BlinnPhongPass when it creates the pipeline
+layout(constant_id = 0) const int NR_POINT_LIGHTS = 5;
 layout(set = 1, binding = 2) uniform PointLights {
     PointLight pointLights[NR_POINT_LIGHTS];
 } pointLights;
@@ -35,7 +37,7 @@ struct SpotLight {
   vec4 atlasCoordsNormalized;
 };
 
-#define NR_SPOT_LIGHTS 2
+layout(constant_id = 1) const int NR_SPOT_LIGHTS = 2;
 layout(set = 1, binding = 3) uniform SpotLights {
     SpotLight spotLights[NR_SPOT_LIGHTS];
 } spotLights;
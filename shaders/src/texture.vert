@@ -10,9 +10,8 @@ layout(set = 0, binding = 0) uniform UBO {
     vec4 cameraPos;
 } ubo;
 
-layout(push_constant) uniform Model {
-    mat4 model;
-};
+// one per instance, from the instance buffer
+layout(location = 3) in mat4 inModel;
 
 layout(location = 0) out vec2 fragTexCoord;
 layout(location = 1) out vec3 outNormal;
@@ -20,12 +19,12 @@ layout(location = 2) out vec3 fragPos;
 layout(location = 3) out vec3 viewPos;
 
 void main() {    
-    fragPos = vec3(model * vec4(inPosition, 1.0));
+    fragPos = vec3(inModel * vec4(inPosition, 1.0));
 
-    outNormal = mat3(transpose(inverse(model))) * inNormal;  
+    outNormal = mat3(transpose(inverse(inModel))) * inNormal;  
 
     viewPos = vec3(ubo.cameraPos);
     fragTexCoord = inTexCoord;
 
-    gl_Position = ubo.proj * ubo.view * model * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 1.0);
 }
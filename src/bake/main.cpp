@@ -0,0 +1,70 @@
+// Offline model baker: runs the assimp import once and writes the result in
+// the layout the engine uploads, next to the source as <model>.baked. Models
+// with an up to date bake are then loaded by mapping the file, without assimp.
+// The import also reorders every mesh for the vertex cache, the numbers
+// printed show the simulated vertex shader work before and after.
+//
+// usage: Vulkan_Bake <model> [<model> ...]
+
+#include "engine/ModelLoading/ModelData.h"
+
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+int
+main(int argc, char** argv)
+{
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <model> [<model> ...]" << std::endl;
+    return 1;
+  }
+
+  int failed = 0;
+  for (int i = 1; i < argc; i++) {
+    std::string source = argv[i];
+    std::string output = getBakedModelPath(source);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    ModelData data;
+    MeshOptimizationStats stats;
+    if (!importModel(source, data, &stats)) {
+      std::cerr << "failed to import " << source << std::endl;
+      failed++;
+      continue;
+    }
+
+    try {
+      writeBakedModel(output, data);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      failed++;
+      continue;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    float ms = std::chrono::duration<float, std::milli>(end - start).count();
+
+    std::cout << source << " -> " << output << ": " << data.vertices.size()
+              << " vertices, " << data.indices.size() << " indices, "
+              << data.meshes.size() << " meshes, " << data.instances.size()
+              << " instances, " << data.textures.size() << " textures ("
+              << ms << " ms)" << std::endl;
+
+    std::cout << std::fixed << std::setprecision(3) << "  ACMR "
+              << stats.before.getAcmr() << " -> " << stats.after.getAcmr()
+              << ", ATVR " << stats.before.getAtvr() << " -> "
+              << stats.after.getAtvr() << ", " << stats.weldedVertices
+              << " vertices welded";
+    if (stats.overdrawSkipped > 0) {
+      std::cout << ", overdraw order skipped on " << stats.overdrawSkipped
+                << " meshes";
+    }
+    std::cout << std::defaultfloat << std::endl;
+  }
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+// Scripted benchmark: flies the camera along a fixed path for a fixed number
+// of frames with no frame pacing and writes frame time percentiles as json,
+// so two builds can be diffed.
+//
+// usage: Vulkan_Benchmark [--frames N] [--warmup N] [--path camera.txt]
+//                         [--out report.json] [--windowed]
+//                         [--width W] [--height H]
+
+#include "GLFW/glfw3.h"
+
+#include "engine/CameraPath.h"
+#include "engine/Profiler.h"
+#include "engine/Renderer.h"
+
+#include "engine/VulkanInitializer.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define VMA_IMPLEMENTATION
+#include <vk_mem_alloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct BenchmarkOptions
+{
+  uint32_t frames = 2000;
+  uint32_t warmupFrames = 100;
+  std::string pathFile;
+  std::string outFile = "benchmark.json";
+  bool windowed = false;
+  int width = 1280;
+  int height = 720;
+};
+
+struct Percentiles
+{
+  float min = 0.0f;
+  float avg = 0.0f;
+  float p50 = 0.0f;
+  float p95 = 0.0f;
+  float p99 = 0.0f;
+  float max = 0.0f;
+  size_t samples = 0;
+};
+
+Percentiles
+computePercentiles(std::vector<float> samples)
+{
+  Percentiles result;
+  if (samples.empty()) {
+    return result;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  // nearest rank
+  auto rank = [&samples](float percentile) {
+    size_t index = static_cast<size_t>(percentile * samples.size());
+    return samples[std::min(index, samples.size() - 1)];
+  };
+
+  float sum = 0.0f;
+  for (float sample : samples) {
+    sum += sample;
+  }
+
+  result.min = samples.front();
+  result.avg = sum / samples.size();
+  result.p50 = rank(0.50f);
+  result.p95 = rank(0.95f);
+  result.p99 = rank(0.99f);
+  result.max = samples.back();
+  result.samples = samples.size();
+  return result;
+}
+
+void
+writePercentiles(std::ostream& out, const Percentiles& p)
+{
+  out << "{\"min\": " << p.min << ", \"avg\": " << p.avg
+      << ", \"p50\": " << p.p50 << ", \"p95\": " << p.p95
+      << ", \"p99\": " << p.p99 << ", \"max\": " << p.max
+      << ", \"samples\": " << p.samples << "}";
+}
+
+BenchmarkOptions
+parseOptions(int argc, char** argv)
+{
+  BenchmarkOptions options;
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--frames") == 0 && hasValue) {
+      options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+      options.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (strcmp(argv[i], "--path") == 0 && hasValue) {
+      options.pathFile = argv[++i];
+    } else if (strcmp(argv[i], "--out") == 0 && hasValue) {
+      options.outFile = argv[++i];
+    } else if (strcmp(argv[i], "--width") == 0 && hasValue) {
+      options.width = std::stoi(argv[++i]);
+    } else if (strcmp(argv[i], "--height") == 0 && hasValue) {
+      options.height = std::stoi(argv[++i]);
+    } else if (strcmp(argv[i], "--windowed") == 0) {
+      options.windowed = true;
+    } else {
+      throw std::runtime_error(std::string("unknown argument ") + argv[i]);
+    }
+  }
+  return options;
+}
+
+int
+main(int argc, char** argv)
+{
+  BenchmarkOptions options = parseOptions(argc, argv);
+
+  CameraPath path = options.pathFile.empty()
+                      ? CameraPath::createDefault()
+                      : CameraPath::load(options.pathFile);
+
+  // a window is only needed to measure the real present path, the default is
+  // headless so it also runs on machines without a display
+  GLFWwindow* window = nullptr;
+  std::unique_ptr<VulkanInitializer> vkInitializer;
+  if (options.windowed) {
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    window = glfwCreateWindow(
+      options.width, options.height, "Vulkan Benchmark", nullptr, nullptr);
+    vkInitializer = std::make_unique<VulkanInitializer>(window);
+  } else {
+    vkInitializer =
+      std::make_unique<VulkanInitializer>(options.width, options.height);
+  }
+
+  VulkanContext* vkContext = vkInitializer->vkContext;
+  VulkanSwapchain* vkSwapchain = vkInitializer->vkSwapchain;
+  Profiler* profiler = vkContext->profiler;
+
+  std::vector<float> cpuFrameTimes;
+  cpuFrameTimes.reserve(options.frames);
+
+  {
+    Scene scene(vkContext);
+    scene.camera->resizeCamera(vkSwapchain->swapChainExtent.width,
+                               vkSwapchain->swapChainExtent.height);
+
+    Renderer renderer(vkContext, vkSwapchain, scene);
+
+    uint32_t totalFrames = options.warmupFrames + options.frames;
+    for (uint32_t frame = 0; frame < totalFrames; frame++) {
+      if (frame == options.warmupFrames) {
+        profiler->clearHistory();
+        profiler->keepHistory = true;
+      }
+
+      if (window) {
+        glfwPollEvents();
+      }
+
+      auto frameStart = std::chrono::steady_clock::now();
+
+      // the path is indexed by frame, not by time, so every run renders the
+      // exact same sequence of images
+      float t = static_cast<float>(frame) / totalFrames;
+      path.apply(scene.camera, t);
+      scene.update();
+      renderer.draw(scene);
+
+      std::chrono::duration<float, std::milli> frameTime =
+        std::chrono::steady_clock::now() - frameStart;
+      if (frame >= options.warmupFrames) {
+        cpuFrameTimes.push_back(frameTime.count());
+      }
+    }
+
+    vkDeviceWaitIdle(vkContext->logicalDevice);
+  }
+
+  // -------------------- REPORT --------------------
+  const VkPhysicalDeviceProperties& deviceProperties =
+    vkContext->deviceProperties;
+
+  std::ofstream report(options.outFile);
+  if (!report.is_open()) {
+    throw std::runtime_error("failed to open file! " + options.outFile);
+  }
+
+  report << std::fixed << std::setprecision(4);
+  report << "{\n";
+  report << "  \"device\": \"" << deviceProperties.deviceName << "\",\n";
+  report << "  \"width\": " << vkSwapchain->swapChainExtent.width << ",\n";
+  report << "  \"height\": " << vkSwapchain->swapChainExtent.height << ",\n";
+  report << "  \"frames\": " << options.frames << ",\n";
+  report << "  \"warmup_frames\": " << options.warmupFrames << ",\n";
+  report << "  \"headless\": " << (options.windowed ? "false" : "true")
+         << ",\n";
+  report << "  \"gpu_timing\": "
+         << (profiler->gpuTimingSupported() ? "true" : "false") << ",\n";
+
+  report << "  \"cpu_frame_ms\": ";
+  writePercentiles(report, computePercentiles(cpuFrameTimes));
+  report << ",\n";
+
+  // gpu results lag behind by MAX_FRAMES_IN_FLIGHT frames, the very last
+  // frames of the run never get resolved and are left out
+  report << "  \"gpu_frame_ms\": ";
+  writePercentiles(report,
+                   computePercentiles(profiler->getHistory("gpu/frame")));
+  report << ",\n";
+
+  report << "  \"scopes\": {";
+  bool first = true;
+  for (const auto& name : profiler->getScopeNames()) {
+    const std::vector<float>& samples = profiler->getHistory(name);
+    if (samples.empty()) {
+      continue;
+    }
+
+    report << (first ? "\n" : ",\n") << "    \"" << name << "\": ";
+    writePercentiles(report, computePercentiles(samples));
+    first = false;
+  }
+  report << "\n  }\n";
+  report << "}\n";
+
+  Percentiles cpu = computePercentiles(cpuFrameTimes);
+  std::cout << "benchmark: " << options.frames << " frames, cpu p50 " << cpu.p50
+            << " ms, p95 " << cpu.p95 << " ms, p99 " << cpu.p99 << " ms"
+            << std::endl;
+  profiler->printSummary(std::cout);
+  std::cout << "report written to " << options.outFile << std::endl;
+
+  vkInitializer.reset();
+  if (window) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
+
+  return 0;
+}
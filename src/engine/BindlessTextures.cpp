@@ -0,0 +1,146 @@
+#include "engine/BindlessTextures.h"
+#include "engine/ModelLoading/Texture.h"
+
+#include <iostream>
+#include <stdexcept>
+
+BindlessTextures::BindlessTextures(VulkanContext* vkContext)
+  : vkContext(vkContext)
+{
+  // --------------------- Create Layout ---------------------
+  VkDescriptorSetLayoutBinding binding{};
+  binding.binding = 0;
+  binding.descriptorCount = BINDLESS_MAX_TEXTURES;
+  binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  // free slots and the ones past nextSlot are never written
+  VkDescriptorBindingFlagsEXT bindingFlags =
+    VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo{};
+  flagsInfo.sType =
+    VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  flagsInfo.bindingCount = 1;
+  flagsInfo.pBindingFlags = &bindingFlags;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &flagsInfo;
+  layoutInfo.bindingCount = 1;
+  layoutInfo.pBindings = &binding;
+
+  if (vkCreateDescriptorSetLayout(
+        vkContext->logicalDevice, &layoutInfo, nullptr, &setLayout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor set layout!");
+  }
+
+  // --------------------- Create Pool ---------------------
+  VkDescriptorPoolSize poolSize{};
+  poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSize.descriptorCount = BINDLESS_MAX_TEXTURES * MAX_FRAMES_IN_FLIGHT;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+  poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+  if (vkCreateDescriptorPool(
+        vkContext->logicalDevice, &poolInfo, nullptr, &descriptorPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor pool!");
+  }
+
+  // --------------------- Create Descriptorsets ---------------------
+  std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+  layouts.fill(setLayout);
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+  allocInfo.pSetLayouts = layouts.data();
+
+  if (vkAllocateDescriptorSets(vkContext->logicalDevice,
+                               &allocInfo,
+                               descriptorSets.data()) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate descriptor sets!");
+  }
+
+  for (std::vector<Written>& frame : written) {
+    frame.resize(BINDLESS_MAX_TEXTURES);
+  }
+}
+
+BindlessTextures::~BindlessTextures()
+{
+  vkDestroyDescriptorPool(vkContext->logicalDevice, descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(vkContext->logicalDevice, setLayout, nullptr);
+}
+
+uint32_t
+BindlessTextures::acquire(Texture& texture)
+{
+  if (texture.bindlessSlot != BINDLESS_NO_SLOT) {
+    return texture.bindlessSlot;
+  }
+
+  if (!freeSlots.empty()) {
+    texture.bindlessSlot = freeSlots.back();
+    freeSlots.pop_back();
+  } else if (nextSlot < BINDLESS_MAX_TEXTURES) {
+    texture.bindlessSlot = nextSlot++;
+  } else {
+    static bool warned = false;
+    if (!warned) {
+      std::cout << "bindless texture array is full, falling back to per mesh "
+                   "descriptor sets"
+                << std::endl;
+      warned = true;
+    }
+  }
+  return texture.bindlessSlot;
+}
+
+void
+BindlessTextures::release(uint32_t slot)
+{
+  // the old view stays in the sets until the slot is written again, nothing
+  // indexes it in the meantime
+  for (std::vector<Written>& frame : written) {
+    frame[slot] = Written{};
+  }
+  freeSlots.push_back(slot);
+}
+
+void
+BindlessTextures::write(uint32_t frameIndex, const Texture& texture)
+{
+  Written& slot = written[frameIndex][texture.bindlessSlot];
+  VkImageView view = texture.getView();
+  if (slot.view == view && slot.sampler == texture.sampler) {
+    return;
+  }
+
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = view;
+  imageInfo.sampler = texture.sampler;
+
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSets[frameIndex];
+  descriptorWrite.dstBinding = 0;
+  descriptorWrite.dstArrayElement = texture.bindlessSlot;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pImageInfo = &imageInfo;
+
+  vkUpdateDescriptorSets(
+    vkContext->logicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+  slot.view = view;
+  slot.sampler = texture.sampler;
+}
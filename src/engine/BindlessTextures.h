@@ -0,0 +1,84 @@
+#ifndef _BINDLESS_TEXTURES_H_
+#define _BINDLESS_TEXTURES_H_
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "engine/VulkanContext.h"
+
+class Texture;
+
+// size of the texture array, has to match the one in
+// shaders/src/bindless/texture.frag
+const uint32_t BINDLESS_MAX_TEXTURES = 1024;
+// what acquire returns when every slot is taken
+const uint32_t BINDLESS_NO_SLOT = UINT32_MAX;
+
+// a material packs both slots into 16 bits each
+static_assert(BINDLESS_MAX_TEXTURES <= 0x10000,
+              "bindless slots have to fit into 16 bits");
+
+// every material texture of the scene in one array of combined image
+// samplers, so the forward pass binds a single set per frame and the fragment
+// shader picks the textures with the material index of the instance instead
+// of every mesh binding its own set.
+//
+// every Texture gets one slot, the TextureCache already shares textures
+// between meshes so a texture used by many materials still takes a single
+// slot. the slot goes back when the texture is destroyed. the slots are
+// written per frame in flight like the sets of the meshes, a frame only
+// touches its own set once its fence has been waited on, so nothing needs
+// update after bind.
+//
+// only created when the device has VK_EXT_descriptor_indexing, see
+// VulkanContext::bindlessTextures
+class BindlessTextures
+{
+public:
+  BindlessTextures(VulkanContext* vkContext);
+  ~BindlessTextures();
+
+  BindlessTextures(const BindlessTextures&) = delete;
+  BindlessTextures& operator=(const BindlessTextures&) = delete;
+
+  // the slot of texture, taking a free one the first time it's asked for.
+  // BINDLESS_NO_SLOT when the array is full, the meshes of that texture are
+  // drawn with their own sets then
+  uint32_t acquire(Texture& texture);
+  // called by the texture when it's destroyed
+  void release(uint32_t slot);
+
+  // points the slot of texture in the set of frameIndex at whatever view it's
+  // bound as now, cheap when nothing changed since the last call
+  void write(uint32_t frameIndex, const Texture& texture);
+
+  VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout; }
+  VkDescriptorSet getDescriptorSet(uint32_t frameIndex) const
+  {
+    return descriptorSets[frameIndex];
+  }
+
+private:
+  VulkanContext* vkContext;
+
+  VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+
+  // slots below nextSlot that have been released again
+  std::vector<uint32_t> freeSlots;
+  uint32_t nextSlot = 0;
+
+  // what each slot of each set was last written with
+  struct Written
+  {
+    VkImageView view = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+  };
+  std::array<std::vector<Written>, MAX_FRAMES_IN_FLIGHT> written;
+};
+
+#endif
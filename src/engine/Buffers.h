@@ -10,6 +10,7 @@ enum BufferType
 {
   STAGING_BUFFER,
   GPU_BUFFER,
+  READBACK_BUFFER, // gpu -> cpu copies, cached so reading it back isn't slow
 };
 
 // --------------------- Vulkan Buffer Definition ---------------------
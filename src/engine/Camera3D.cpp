@@ -12,6 +12,7 @@ Camera3D::Camera3D(glm::vec3 cameraPos, glm::vec3 cameraFront)
 void
 Camera3D::resizeCamera(uint32_t width, uint32_t height)
 {
+  viewportHeight = height;
   cameraProjection = glm::perspective(
     glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
 }
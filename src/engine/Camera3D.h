@@ -32,6 +32,7 @@ public:
   }
 
   const glm::vec3& getCameraPos() const { return cameraPos; }
+  uint32_t getViewportHeight() const { return viewportHeight; }
   const glm::vec3& getCameraFront() const { return cameraFront; }
 
   float pitch;
@@ -44,6 +45,8 @@ private:
   glm::vec3 cameraPos;
   glm::vec3 cameraFront;
 
+  uint32_t viewportHeight = 1;
+
   bool needsUpdating;
 };
 
@@ -0,0 +1,140 @@
+#include "engine/CameraPath.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+CameraPath::CameraPath(std::vector<CameraKeyframe> keyframes)
+  : keyframes(std::move(keyframes))
+{
+}
+
+CameraPath
+CameraPath::createDefault()
+{
+  // remember y points down in this scene: the floor is at +1 and the lights
+  // hang at negative y
+  return CameraPath({
+    { glm::vec3(0.0f, 0.0f, 3.0f), -90.0f, 0.0f },
+    { glm::vec3(3.0f, -1.0f, 0.0f), -130.0f, 10.0f },
+    { glm::vec3(2.0f, -1.5f, -8.0f), -100.0f, 5.0f },
+    { glm::vec3(-1.5f, -1.0f, -18.0f), -80.0f, 0.0f },
+    { glm::vec3(0.0f, -1.5f, -32.0f), -90.0f, -5.0f },
+    { glm::vec3(-3.0f, -2.5f, -20.0f), 60.0f, 15.0f },
+    { glm::vec3(-3.0f, -2.0f, -6.0f), 80.0f, 20.0f },
+    { glm::vec3(-2.0f, -0.5f, 2.0f), -60.0f, 5.0f },
+  });
+}
+
+CameraPath
+CameraPath::load(const std::string& filePath)
+{
+  std::ifstream file(filePath);
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open file! " + filePath);
+  }
+
+  std::vector<CameraKeyframe> keyframes;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::istringstream stream(line);
+    CameraKeyframe keyframe;
+    if (stream >> keyframe.position.x >> keyframe.position.y >>
+        keyframe.position.z >> keyframe.yaw >> keyframe.pitch) {
+      keyframes.push_back(keyframe);
+    }
+  }
+
+  if (keyframes.size() < 2) {
+    throw std::runtime_error("camera path needs at least two keyframes! " +
+                             filePath);
+  }
+
+  return CameraPath(std::move(keyframes));
+}
+
+void
+CameraPath::save(const std::string& filePath) const
+{
+  std::ofstream file(filePath);
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open file! " + filePath);
+  }
+
+  file << "# x y z yaw pitch\n";
+  for (const auto& keyframe : keyframes) {
+    file << keyframe.position.x << " " << keyframe.position.y << " "
+         << keyframe.position.z << " " << keyframe.yaw << " " << keyframe.pitch
+         << "\n";
+  }
+}
+
+void
+CameraPath::addKeyframe(const Camera3D& camera)
+{
+  keyframes.push_back({ camera.getCameraPos(), camera.yaw, camera.pitch });
+}
+
+static float
+catmullRom(float p0, float p1, float p2, float p3, float t)
+{
+  float t2 = t * t;
+  float t3 = t2 * t;
+  return 0.5f * ((2.0f * p1) + (-p0 + p2) * t +
+                 (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                 (-p0 + 3.0f * p1 - 3.0f * p2 + p3) * t3);
+}
+
+CameraKeyframe
+CameraPath::sample(float t) const
+{
+  if (keyframes.empty()) {
+    throw std::runtime_error("sampling an empty camera path!");
+  }
+
+  size_t count = keyframes.size();
+
+  t = t - std::floor(t);
+  float segment = t * count;
+  size_t i1 = static_cast<size_t>(segment) % count;
+  float localT = segment - std::floor(segment);
+
+  const CameraKeyframe& k0 = keyframes[(i1 + count - 1) % count];
+  const CameraKeyframe& k1 = keyframes[i1];
+  const CameraKeyframe& k2 = keyframes[(i1 + 1) % count];
+  const CameraKeyframe& k3 = keyframes[(i1 + 2) % count];
+
+  CameraKeyframe result;
+  for (int axis = 0; axis < 3; axis++) {
+    result.position[axis] = catmullRom(k0.position[axis],
+                                       k1.position[axis],
+                                       k2.position[axis],
+                                       k3.position[axis],
+                                       localT);
+  }
+  result.yaw = catmullRom(k0.yaw, k1.yaw, k2.yaw, k3.yaw, localT);
+  result.pitch = catmullRom(k0.pitch, k1.pitch, k2.pitch, k3.pitch, localT);
+
+  if (result.pitch > 89.0f)
+    result.pitch = 89.0f;
+  if (result.pitch < -89.0f)
+    result.pitch = -89.0f;
+
+  return result;
+}
+
+void
+CameraPath::apply(Camera3D* camera, float t) const
+{
+  CameraKeyframe keyframe = sample(t);
+
+  camera->yaw = keyframe.yaw;
+  camera->pitch = keyframe.pitch;
+  camera->setPos(keyframe.position);
+  camera->update();
+}
@@ -0,0 +1,46 @@
+#ifndef _CAMERA_PATH_H_
+#define _CAMERA_PATH_H_
+
+#include <glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "engine/Camera3D.h"
+
+struct CameraKeyframe
+{
+  glm::vec3 position;
+  float yaw;
+  float pitch;
+};
+
+// closed catmull-rom spline through a list of camera keyframes. used to fly
+// the camera along the exact same path every run so benchmarks can be
+// compared between builds.
+class CameraPath
+{
+public:
+  CameraPath() = default;
+  explicit CameraPath(std::vector<CameraKeyframe> keyframes);
+
+  // fly-through of the demo scene, used when no recorded path is given
+  static CameraPath createDefault();
+
+  // one keyframe per line: "x y z yaw pitch"
+  static CameraPath load(const std::string& filePath);
+  void save(const std::string& filePath) const;
+
+  void addKeyframe(const Camera3D& camera);
+
+  // t in [0, 1], wraps around
+  CameraKeyframe sample(float t) const;
+  void apply(Camera3D* camera, float t) const;
+
+  bool empty() const { return keyframes.empty(); }
+
+private:
+  std::vector<CameraKeyframe> keyframes;
+};
+
+#endif
@@ -0,0 +1,489 @@
+#include "engine/ClusteredLights.h"
+
+#include "engine/FrameArena.h"
+#include "engine/JobSystem.h"
+#include "engine/Lights.h"
+#include "engine/PipelineCache.h"
+#include "engine/Scene.h"
+#include "engine/ShaderLibrary.h"
+#include "engine/StagingRing.h"
+
+#include <gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// mirrors the std140 block in shaders/src/clustered/texture.frag and
+// assign.comp
+struct ClusterParams
+{
+  glm::mat4 view;
+  glm::mat4 inverseProjection;
+  // x, y, z: clusters along each axis, w: CLUSTER_MAX_LIGHTS
+  glm::uvec4 grid;
+  // xy: pixels a cluster covers on screen
+  glm::vec4 tileSize;
+  // x, y: the slice of a view depth is log(depth) * x + y, z: the cutoff
+  glm::vec4 depthSlices;
+  // x: point lights, y: spot lights
+  glm::uvec4 lightCounts;
+};
+
+const uint32_t ASSIGN_GROUP_SIZE = 64;
+
+// two counts and CLUSTER_MAX_LIGHTS indices for every cluster
+const VkDeviceSize CLUSTER_DATA_SIZE =
+  sizeof(uint32_t) * (2 + CLUSTER_MAX_LIGHTS) * ClusteredLights::CLUSTER_COUNT;
+
+// 1 / d^2 falls under the cutoff at this distance
+float
+lightRange(const glm::vec4& color)
+{
+  float intensity = std::max(color.r, std::max(color.g, color.b));
+  return std::sqrt(std::max(intensity, 0.0f) / CLUSTER_LIGHT_CUTOFF);
+}
+
+bool
+intersects(const glm::vec3& center,
+           float radius,
+           const glm::vec3& min,
+           const glm::vec3& max)
+{
+  glm::vec3 outside =
+    glm::max(min - center, glm::vec3(0.0f)) +
+    glm::max(center - max, glm::vec3(0.0f));
+  return glm::dot(outside, outside) <= radius * radius;
+}
+
+} // namespace
+
+ClusteredLights::ClusteredLights(VulkanContext* vkContext)
+  : vkContext(vkContext)
+{
+  createDescriptors();
+
+#if CLUSTERED_COMPUTE
+  VkDeviceSize alignment =
+    vkContext->deviceProperties.limits.minStorageBufferOffsetAlignment;
+  clusterRegionSize =
+    (CLUSTER_DATA_SIZE + alignment - 1) / alignment * alignment;
+
+  vkContext->createBuffer(clusterRegionSize * MAX_FRAMES_IN_FLIGHT,
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          BufferType::GPU_BUFFER,
+                          clusterBuffer,
+                          clusterAllocation);
+  vmaSetAllocationName(
+    vkContext->allocator, clusterAllocation, "clusteredLightsClusters");
+
+  createPipeline();
+#endif
+}
+
+ClusteredLights::~ClusteredLights()
+{
+  if (pipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(vkContext->logicalDevice, pipeline, nullptr);
+    vkDestroyPipelineLayout(vkContext->logicalDevice, pipelineLayout, nullptr);
+  }
+  if (clusterBuffer != VK_NULL_HANDLE) {
+    vmaDestroyBuffer(vkContext->allocator, clusterBuffer, clusterAllocation);
+  }
+
+  vkDestroyDescriptorPool(vkContext->logicalDevice, descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(vkContext->logicalDevice, setLayout, nullptr);
+}
+
+void
+ClusteredLights::createDescriptors()
+{
+  // --------------------- Create Layout ---------------------
+  // the light buffers change size with the number of lights, so the sets
+  // aren't dynamic like the ones of the scene. record() rewrites the set of
+  // the frame instead, its fence has been waited on by then
+  std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+  for (uint32_t i = 0; i < bindings.size(); i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorCount = 1;
+    bindings[i].descriptorType = i < 2 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                       : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].stageFlags =
+      VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(
+        vkContext->logicalDevice, &layoutInfo, nullptr, &setLayout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor set layout!");
+  }
+
+  // --------------------- Create Pool ---------------------
+  std::array<VkDescriptorPoolSize, 2> poolSizes;
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  poolSizes[0].descriptorCount = 2 * MAX_FRAMES_IN_FLIGHT;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[1].descriptorCount = 3 * MAX_FRAMES_IN_FLIGHT;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+  if (vkCreateDescriptorPool(
+        vkContext->logicalDevice, &poolInfo, nullptr, &descriptorPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor pool!");
+  }
+
+  // --------------------- Create Descriptorsets ---------------------
+  std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+  layouts.fill(setLayout);
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+  allocInfo.pSetLayouts = layouts.data();
+
+  if (vkAllocateDescriptorSets(
+        vkContext->logicalDevice, &allocInfo, descriptorSets.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate descriptor sets!");
+  }
+}
+
+void
+ClusteredLights::createPipeline()
+{
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &setLayout;
+
+  if (vkCreatePipelineLayout(vkContext->logicalDevice,
+                             &pipelineLayoutInfo,
+                             nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+
+  // a compute pipeline like the one of GpuCuller, created here directly
+  VkPipelineShaderStageCreateInfo stageInfo{};
+  stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  stageInfo.module = vkContext->shaderLibrary->get("clustered/assign_comp.spv");
+  stageInfo.pName = "main";
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = stageInfo;
+  pipelineInfo.layout = pipelineLayout;
+
+  if (vkCreateComputePipelines(vkContext->logicalDevice,
+                               vkContext->pipelineCache->get(),
+                               1,
+                               &pipelineInfo,
+                               nullptr,
+                               &pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline!");
+  }
+}
+
+void
+ClusteredLights::record(VkCommandBuffer commandBuffer,
+                        uint32_t frameIndex,
+                        const Scene& scene,
+                        VkExtent2D extent)
+{
+  currentFrame = frameIndex;
+
+  // near and far planes back out of the projection, it's a zero to one depth
+  // range like everywhere else
+  glm::mat4 view = scene.camera->getCameraMatrix();
+  glm::mat4 projection = scene.camera->getCameraProjectionMatrix();
+  float zNear = projection[3][2] / projection[2][2];
+  float zFar = projection[3][2] / (projection[2][2] + 1.0f);
+  float logDepthRange = std::log(zFar / zNear);
+
+  uint32_t pointCount = static_cast<uint32_t>(scene.pointLights.size());
+  uint32_t spotCount = static_cast<uint32_t>(scene.spotLights.size());
+
+  // -------------------- UPLOAD --------------------
+  StagingRing* ring = vkContext->stagingRing;
+  VkDeviceSize storageAlignment =
+    vkContext->deviceProperties.limits.minStorageBufferOffsetAlignment;
+
+  // a binding can't be empty, without lights a zeroed one is bound
+  auto upload = [&](const void* data, VkDeviceSize stride, uint32_t count) {
+    StagingAllocation allocation =
+      ring->allocateFrameData(stride * std::max(count, 1u), storageAlignment);
+    if (count == 0) {
+      memset(allocation.mapped, 0, static_cast<size_t>(stride));
+    } else {
+      memcpy(allocation.mapped, data, static_cast<size_t>(stride * count));
+    }
+    ring->flush(allocation);
+    return allocation;
+  };
+
+  StagingAllocation params =
+    ring->allocateFrameData(sizeof(ClusterParams), ring->getUniformAlignment());
+  ClusterParams* clusterParams = static_cast<ClusterParams*>(params.mapped);
+  clusterParams->view = view;
+  clusterParams->inverseProjection = glm::inverse(projection);
+  clusterParams->grid = glm::uvec4(
+    CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, CLUSTER_MAX_LIGHTS);
+  clusterParams->tileSize =
+    glm::vec4(static_cast<float>(extent.width) / CLUSTER_GRID_X,
+              static_cast<float>(extent.height) / CLUSTER_GRID_Y,
+              0.0f,
+              0.0f);
+  clusterParams->depthSlices =
+    glm::vec4(CLUSTER_GRID_Z / logDepthRange,
+              -CLUSTER_GRID_Z * std::log(zNear) / logDepthRange,
+              CLUSTER_LIGHT_CUTOFF,
+              0.0f);
+  clusterParams->lightCounts = glm::uvec4(pointCount, spotCount, 0, 0);
+  ring->flush(params);
+
+  StagingAllocation points =
+    upload(scene.pointLights.data(), sizeof(PointLight), pointCount);
+  StagingAllocation spots =
+    upload(scene.spotLights.data(), sizeof(SpotLight), spotCount);
+
+  VkDescriptorBufferInfo clustersInfo{};
+  StagingAllocation clusters;
+  if (pipeline != VK_NULL_HANDLE) {
+    clustersInfo = { clusterBuffer,
+                     clusterRegionSize * frameIndex,
+                     CLUSTER_DATA_SIZE };
+  } else {
+    clusters = ring->allocateFrameData(CLUSTER_DATA_SIZE, storageAlignment);
+    clustersInfo = { clusters.buffer, clusters.offset, clusters.size };
+  }
+
+  // -------------------- DESCRIPTORS --------------------
+  std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+  bufferInfos[0] = { ring->getBuffer(),
+                     scene.lightsUBOOffsets[0],
+                     sizeof(DirectionalLight) };
+  bufferInfos[1] = { params.buffer, params.offset, sizeof(ClusterParams) };
+  bufferInfos[2] = { points.buffer, points.offset, points.size };
+  bufferInfos[3] = { spots.buffer, spots.offset, spots.size };
+  bufferInfos[4] = clustersInfo;
+
+  std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+  for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+    descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[i].dstSet = descriptorSets[frameIndex];
+    descriptorWrites[i].dstBinding = i;
+    descriptorWrites[i].dstArrayElement = 0;
+    descriptorWrites[i].descriptorType = i < 2
+                                           ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                           : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrites[i].descriptorCount = 1;
+    descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+  }
+
+  vkUpdateDescriptorSets(vkContext->logicalDevice,
+                         static_cast<uint32_t>(descriptorWrites.size()),
+                         descriptorWrites.data(),
+                         0,
+                         nullptr);
+
+  // -------------------- ASSIGN --------------------
+  if (pipeline != VK_NULL_HANDLE) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            pipelineLayout,
+                            0,
+                            1,
+                            &descriptorSets[frameIndex],
+                            0,
+                            nullptr);
+    vkCmdDispatch(commandBuffer,
+                  (CLUSTER_COUNT + ASSIGN_GROUP_SIZE - 1) / ASSIGN_GROUP_SIZE,
+                  1,
+                  1);
+
+    VkMemoryBarrier assignBarrier{};
+    assignBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    assignBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    assignBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0,
+                         1,
+                         &assignBarrier,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+    return;
+  }
+
+  // every light as a sphere in view space, a spot light as the bounding
+  // sphere of its cone. wide cones are bounded by their base, narrow ones by
+  // the sphere through the tip and the rim of the base
+  LightSphere* spheres =
+    vkContext->frameArena->allocate<LightSphere>(pointCount + spotCount);
+  for (uint32_t i = 0; i < pointCount; i++) {
+    const PointLight& light = scene.pointLights[i];
+    spheres[i] = { glm::vec3(view * glm::vec4(glm::vec3(light.getPosition()),
+                                              1.0f)),
+                   lightRange(light.getColor()) };
+  }
+  for (uint32_t i = 0; i < spotCount; i++) {
+    const SpotLight& light = scene.spotLights[i];
+    glm::vec3 position =
+      glm::vec3(view * glm::vec4(glm::vec3(light.getPosition()), 1.0f));
+    glm::vec3 direction = glm::normalize(
+      glm::mat3(view) * glm::vec3(light.getDirection()));
+    float range = lightRange(light.getColor());
+    float angle = glm::radians(light.getCutoff().y);
+
+    LightSphere& sphere = spheres[pointCount + i];
+    if (angle > glm::quarter_pi<float>()) {
+      sphere.center = position + direction * (std::cos(angle) * range);
+      sphere.radius = std::sin(angle) * range;
+    } else {
+      sphere.radius = range / (2.0f * std::cos(angle));
+      sphere.center = position + direction * sphere.radius;
+    }
+  }
+
+  assignOnCpu(clusterParams->inverseProjection,
+              zNear,
+              zFar,
+              spheres,
+              pointCount,
+              spotCount,
+              static_cast<uint32_t*>(clusters.mapped));
+  ring->flush(clusters);
+}
+
+void
+ClusteredLights::assignOnCpu(const glm::mat4& inverseProjection,
+                             float zNear,
+                             float zFar,
+                             const LightSphere* spheres,
+                             uint32_t pointCount,
+                             uint32_t spotCount,
+                             uint32_t* clusters)
+{
+  // the corners of the tiles as rays through view space, scaled so they're
+  // at a depth of 1. a corner at depth d is then just ray * d
+  const uint32_t cornersX = CLUSTER_GRID_X + 1;
+  glm::vec3* rays =
+    vkContext->frameArena->allocate<glm::vec3>(cornersX * (CLUSTER_GRID_Y + 1));
+  for (uint32_t y = 0; y <= CLUSTER_GRID_Y; y++) {
+    for (uint32_t x = 0; x <= CLUSTER_GRID_X; x++) {
+      glm::vec4 corner =
+        inverseProjection *
+        glm::vec4(-1.0f + 2.0f * x / CLUSTER_GRID_X,
+                  -1.0f + 2.0f * y / CLUSTER_GRID_Y,
+                  1.0f,
+                  1.0f);
+      glm::vec3 ray = glm::vec3(corner) / corner.w;
+      rays[y * cornersX + x] = ray / -ray.z;
+    }
+  }
+
+  uint32_t* counts = clusters;
+  uint32_t* indices = clusters + 2 * CLUSTER_COUNT;
+  uint32_t lightCount = pointCount + spotCount;
+
+  auto assignSlices = [=](uint32_t first, uint32_t last) {
+    for (uint32_t z = first; z < last; z++) {
+      float sliceNear = zNear * std::pow(zFar / zNear,
+                                         static_cast<float>(z) /
+                                           CLUSTER_GRID_Z);
+      float sliceFar = zNear * std::pow(zFar / zNear,
+                                        static_cast<float>(z + 1) /
+                                          CLUSTER_GRID_Z);
+
+      for (uint32_t y = 0; y < CLUSTER_GRID_Y; y++) {
+        for (uint32_t x = 0; x < CLUSTER_GRID_X; x++) {
+          glm::vec3 min(std::numeric_limits<float>::max());
+          glm::vec3 max(std::numeric_limits<float>::lowest());
+          for (uint32_t corner = 0; corner < 4; corner++) {
+            const glm::vec3& ray =
+              rays[(y + corner / 2) * cornersX + x + corner % 2];
+            min = glm::min(min, glm::min(ray * sliceNear, ray * sliceFar));
+            max = glm::max(max, glm::max(ray * sliceNear, ray * sliceFar));
+          }
+
+          uint32_t cluster = (z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x;
+          uint32_t* clusterIndices = indices + cluster * CLUSTER_MAX_LIGHTS;
+
+          // points first, then spots. whatever doesn't fit is dropped
+          uint32_t count = 0;
+          uint32_t clusterPoints = 0;
+          for (uint32_t i = 0; i < lightCount; i++) {
+            if (i == pointCount) {
+              clusterPoints = count;
+            }
+            if (count < CLUSTER_MAX_LIGHTS &&
+                intersects(spheres[i].center, spheres[i].radius, min, max)) {
+              clusterIndices[count++] = i < pointCount ? i : i - pointCount;
+            }
+          }
+          if (spotCount == 0) {
+            clusterPoints = count;
+          }
+
+          counts[2 * cluster] = clusterPoints;
+          counts[2 * cluster + 1] = count - clusterPoints;
+        }
+      }
+    }
+  };
+
+  // the slices are split between the workers and this thread, which takes
+  // the first share. nothing here waits on another job
+  JobSystem* jobSystem = vkContext->jobSystem;
+  uint32_t shares =
+    std::min<uint32_t>(CLUSTER_GRID_Z,
+                       1 + static_cast<uint32_t>(
+                             jobSystem ? jobSystem->getThreadCount() : 0));
+
+  jobs.clear();
+  for (uint32_t share = 1; share < shares; share++) {
+    uint32_t first = CLUSTER_GRID_Z * share / shares;
+    uint32_t last = CLUSTER_GRID_Z * (share + 1) / shares;
+    jobs.push_back(
+      jobSystem->submit([=]() { assignSlices(first, last); }));
+  }
+  assignSlices(0, CLUSTER_GRID_Z / shares);
+  for (std::future<void>& job : jobs) {
+    job.get();
+  }
+}
+
+void
+ClusteredLights::bind(VkCommandBuffer commandBuffer,
+                      VkPipelineLayout layout,
+                      uint32_t set) const
+{
+  vkCmdBindDescriptorSets(commandBuffer,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          layout,
+                          set,
+                          1,
+                          &descriptorSets[currentFrame],
+                          0,
+                          nullptr);
+}
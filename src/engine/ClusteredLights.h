@@ -0,0 +1,128 @@
+#ifndef _CLUSTERED_LIGHTS_H_
+#define _CLUSTERED_LIGHTS_H_
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_core.h>
+
+#include <glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "engine/VulkanContext.h"
+
+// shades the forward pass with clustered lighting where the device allows it.
+// set from cmake, off unless asked for. CLUSTERED_COMPUTE picks where the
+// lights are assigned, see ClusteredLights
+#ifndef CLUSTERED_LIGHTING
+#define CLUSTERED_LIGHTING 0
+#endif
+#ifndef CLUSTERED_COMPUTE
+#define CLUSTERED_COMPUTE 1
+#endif
+
+// clusters along x and y on screen and along the depth, and how many lights
+// a cluster holds at most. CLUSTER_LIGHT_CUTOFF is the intensity a light
+// counts as out of range at, it sets how far every light reaches. set from
+// cmake, the fallbacks are here so the header works on its own
+#ifndef CLUSTER_GRID_X
+#define CLUSTER_GRID_X 16
+#endif
+#ifndef CLUSTER_GRID_Y
+#define CLUSTER_GRID_Y 9
+#endif
+#ifndef CLUSTER_GRID_Z
+#define CLUSTER_GRID_Z 24
+#endif
+#ifndef CLUSTER_MAX_LIGHTS
+#define CLUSTER_MAX_LIGHTS 128
+#endif
+#ifndef CLUSTER_LIGHT_CUTOFF
+#define CLUSTER_LIGHT_CUTOFF 0.004f
+#endif
+
+class Scene;
+
+// splits the view frustum of the camera into a grid of clusters, tiles on
+// screen times slices along the depth that get exponentially thicker, and
+// lists the point and spot lights that reach into each of them. the forward
+// fragment shader only loops over the lights of the cluster it falls in, so
+// the scene can have any number of lights and a fragment pays for the ones
+// close to it.
+//
+// the lights go into storage buffers in the staging ring every frame, sized
+// to however many there are. a light reaches as far as its intensity stays
+// over CLUSTER_LIGHT_CUTOFF, spot lights are tested with the bounding sphere
+// of their cone. the assignment runs in shaders/src/clustered/assign.comp
+// with CLUSTERED_COMPUTE, on the job system otherwise.
+//
+// the set replaces the lights of the scene in the forward pass, there's one
+// per frame in flight and record() points it at where the data of the frame
+// went:
+//   0: directional light   1: grid   2: point lights   3: spot lights
+//   4: the lights of every cluster, two counts per cluster (point, spot)
+//      followed by CLUSTER_MAX_LIGHTS indices per cluster
+class ClusteredLights
+{
+public:
+  ClusteredLights(VulkanContext* vkContext);
+  ~ClusteredLights();
+
+  ClusteredLights(const ClusteredLights&) = delete;
+  ClusteredLights& operator=(const ClusteredLights&) = delete;
+
+  // uploads the lights and assigns them to the clusters of the camera. after
+  // Scene::uploadFrameData() and outside of a render pass
+  void record(VkCommandBuffer commandBuffer,
+              uint32_t frameIndex,
+              const Scene& scene,
+              VkExtent2D extent);
+
+  VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout; }
+  void bind(VkCommandBuffer commandBuffer,
+            VkPipelineLayout layout,
+            uint32_t set) const;
+
+  static const uint32_t CLUSTER_COUNT =
+    CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+private:
+  VulkanContext* vkContext;
+
+  VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+  void createDescriptors();
+
+  // the compute path writes the clusters here, a region per frame in flight.
+  // the job system writes them into the staging ring instead
+  VkBuffer clusterBuffer = VK_NULL_HANDLE;
+  VmaAllocation clusterAllocation = VK_NULL_HANDLE;
+  VkDeviceSize clusterRegionSize = 0;
+
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  void createPipeline();
+
+  // -------------------- CURRENT FRAME --------------------
+  uint32_t currentFrame = 0;
+
+  // a light as the clusters see it, a sphere in view space
+  struct LightSphere
+  {
+    glm::vec3 center;
+    float radius;
+  };
+  void assignOnCpu(const glm::mat4& inverseProjection,
+                   float zNear,
+                   float zFar,
+                   const LightSphere* spheres,
+                   uint32_t pointCount,
+                   uint32_t spotCount,
+                   uint32_t* clusters);
+  std::vector<std::future<void>> jobs;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "engine/DrawList.h"
+#include "engine/FrameArena.h"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+DrawList::DrawList(VulkanContext* vkContext)
+  : vkContext(vkContext)
+{
+}
+
+void
+DrawList::reset(uint32_t newCapacity)
+{
+  FrameArena* arena = vkContext->frameArena;
+  count = 0;
+  if (packets && generation == arena->getGeneration() &&
+      newCapacity <= capacity) {
+    return;
+  }
+
+  packets = arena->allocate<DrawPacket>(newCapacity);
+  scratch = arena->allocate<DrawPacket>(newCapacity);
+  capacity = newCapacity;
+  generation = arena->getGeneration();
+}
+
+void
+DrawList::add(uint64_t key, uint32_t index)
+{
+  if (count == capacity) {
+    throw std::runtime_error("draw list is full!");
+  }
+  packets[count++] = { key, index };
+}
+
+void
+DrawList::sort()
+{
+  std::array<uint32_t, 256> histogram;
+
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    histogram.fill(0);
+    for (uint32_t i = 0; i < count; i++) {
+      histogram[(packets[i].key >> shift) & 0xff]++;
+    }
+
+    // every key has the same byte here, this pass wouldn't move anything.
+    // most of the key is like that within one pass
+    if (count == 0 ||
+        histogram[(packets[0].key >> shift) & 0xff] == count) {
+      continue;
+    }
+
+    uint32_t offset = 0;
+    for (uint32_t& bucket : histogram) {
+      uint32_t bucketCount = bucket;
+      bucket = offset;
+      offset += bucketCount;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+      scratch[histogram[(packets[i].key >> shift) & 0xff]++] = packets[i];
+    }
+    std::swap(packets, scratch);
+  }
+}
+
+uint64_t
+DrawList::makeKey(uint32_t pass,
+                  uint32_t pipeline,
+                  uint32_t material,
+                  uint32_t vertexBuffer,
+                  float depth)
+{
+  // positive floats compare like their bits do, anything behind the eye is
+  // as near as it gets. written so -0 and nan end up at +0 too, their bits
+  // would sort as the farthest depth there is
+  depth = depth > 0.0f ? depth : 0.0f;
+  uint32_t depthBits;
+  memcpy(&depthBits, &depth, sizeof(depthBits));
+
+  return (static_cast<uint64_t>(pass & 0xf) << 60) |
+         (static_cast<uint64_t>(pipeline & 0xff) << 52) |
+         (static_cast<uint64_t>(material & 0xffff) << 36) |
+         (static_cast<uint64_t>(vertexBuffer & 0xf) << 32) | depthBits;
+}
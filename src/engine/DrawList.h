@@ -0,0 +1,79 @@
+#ifndef _DRAW_LIST_H_
+#define _DRAW_LIST_H_
+
+#include <cstdint>
+
+#include "engine/VulkanContext.h"
+
+// what a pass put into its list, the index is into whatever the pass builds
+// its draws from (the batches of an InstanceBatcher so far)
+struct DrawPacket
+{
+  uint64_t key;
+  uint32_t index;
+};
+
+// the passes, in the order their draws would come out of a shared list
+enum DrawListPass : uint32_t
+{
+  DRAW_PASS_SHADOW = 0,
+  DRAW_PASS_GBUFFER = 1,
+  DRAW_PASS_FORWARD = 2,
+};
+
+// a flat array of draws a pass sorts before recording them, so draws that
+// share state end up next to each other and the pass only binds what changed
+// between two packets. the key is, from the most significant bit down:
+//
+//   | pass 4 | pipeline 8 | material 16 | vertex buffer 4 | depth 32 |
+//
+// material is whatever the pass binds per draw (the textures of a mesh), the
+// depth is the view distance of the nearest instance, so within the same state
+// opaque draws go front to back. fields that don't change within a pass cost
+// nothing, the sort skips the digits every key shares.
+//
+// the packets live in the FrameArena, reset() takes room for the largest
+// number of packets the pass can add and building the list allocates nothing
+// else. a list built several times in the same frame (once per light view)
+// keeps its room as long as it's big enough, so the arena pays for the
+// largest build and not for all of them.
+class DrawList
+{
+public:
+  DrawList(VulkanContext* vkContext);
+
+  // throws the packets of the previous build away, once per build before the
+  // first add()
+  void reset(uint32_t capacity);
+  void add(uint64_t key, uint32_t index);
+
+  // LSD radix sort on the keys, a byte per pass. stable, draws with the same
+  // key stay in the order they were added
+  void sort();
+
+  const DrawPacket* begin() const { return packets; }
+  const DrawPacket* end() const { return packets + count; }
+  uint32_t size() const { return count; }
+
+  static uint64_t makeKey(uint32_t pass,
+                          uint32_t pipeline,
+                          uint32_t material,
+                          uint32_t vertexBuffer,
+                          float depth);
+
+  static uint32_t getPipeline(uint64_t key) { return (key >> 52) & 0xff; }
+  static uint32_t getMaterial(uint64_t key) { return (key >> 36) & 0xffff; }
+
+private:
+  VulkanContext* vkContext;
+
+  DrawPacket* packets = nullptr;
+  // the other half of every radix pass, as big as packets
+  DrawPacket* scratch = nullptr;
+  uint32_t count = 0;
+  uint32_t capacity = 0;
+  // the arena generation packets and scratch were taken from
+  uint64_t generation = 0;
+};
+
+#endif
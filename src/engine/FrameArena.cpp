@@ -0,0 +1,32 @@
+#include "engine/FrameArena.h"
+
+#include <stdexcept>
+
+FrameArena::FrameArena(size_t size)
+  : size((size + 15) & ~static_cast<size_t>(15))
+  , memory(this->size * MAX_FRAMES_IN_FLIGHT)
+{
+  block = memory.data();
+}
+
+void
+FrameArena::reset(uint32_t frameIndex)
+{
+  block = memory.data() + size * frameIndex;
+  used = 0;
+  generation++;
+}
+
+void*
+FrameArena::allocate(size_t allocationSize, size_t alignment)
+{
+  // operator new aligns the memory to 16 bytes and every block starts at a
+  // multiple of 16 after it, enough for anything that isn't over-aligned
+  size_t offset = (used + alignment - 1) & ~(alignment - 1);
+  if (offset + allocationSize > size) {
+    throw std::runtime_error("frame arena is out of space!");
+  }
+
+  used = offset + allocationSize;
+  return block + offset;
+}
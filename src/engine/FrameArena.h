@@ -0,0 +1,58 @@
+#ifndef _FRAME_ARENA_H_
+#define _FRAME_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "engine/VulkanContext.h"
+
+// bytes every frame in flight gets. it's set from cmake, the fallback is here
+// so the header works on its own
+#ifndef FRAME_ARENA_SIZE
+#define FRAME_ARENA_SIZE (4 * 1024 * 1024)
+#endif
+
+// cpu memory for things that only live while a frame is built and recorded,
+// like the draw lists of the passes. every frame in flight has its own block
+// that's handed out linearly, reset() throws all of it away at once, so
+// nothing in here is ever freed or destructed on its own. only put trivially
+// destructible types in it.
+class FrameArena
+{
+public:
+  FrameArena(size_t size);
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  // makes the block of frameIndex the current one and empties it, once per
+  // frame before anything is allocated
+  void reset(uint32_t frameIndex);
+
+  // throws when the block of the frame is full
+  void* allocate(size_t size, size_t alignment);
+
+  template<typename T>
+  T* allocate(size_t count)
+  {
+    return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  size_t getUsed() const { return used; }
+  size_t getSize() const { return size; }
+
+  // goes up with every reset(), memory handed out under another generation
+  // is gone
+  uint64_t getGeneration() const { return generation; }
+
+private:
+  size_t size;
+  std::vector<uint8_t> memory;
+
+  uint8_t* block = nullptr;
+  size_t used = 0;
+  uint64_t generation = 0;
+};
+
+#endif
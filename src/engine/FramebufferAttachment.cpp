@@ -1,4 +1,5 @@
 #include "engine/FramebufferAttachment.h"
+#include "engine/SamplerCache.h"
 
 #include <stdexcept>
 #include <vulkan/vulkan_core.h>
@@ -61,7 +62,7 @@ FramebufferAttachment::create()
 
   view = vkContext->createImageView(image, format, layerCount, aspectMask);
 
-  // create sampler
+  // get sampler, attachments with the same address mode all share one
   if (sampler == VK_NULL_HANDLE) {
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -78,11 +79,7 @@ FramebufferAttachment::create()
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 
-    if (vkCreateSampler(
-          vkContext->logicalDevice, &samplerInfo, nullptr, &sampler) !=
-        VK_SUCCESS) {
-      throw std::runtime_error("failed to create texture sampler!");
-    }
+    sampler = vkContext->samplerCache->get(samplerInfo);
   }
 }
 
@@ -90,6 +87,5 @@ FramebufferAttachment::~FramebufferAttachment()
 {
   vmaDestroyImage(vkContext->allocator, image, allocation);
   vkDestroyImageView(vkContext->logicalDevice, view, nullptr);
-  vkDestroySampler(vkContext->logicalDevice, sampler, nullptr);
   vkContext = nullptr;
 }
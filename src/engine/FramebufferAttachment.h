@@ -22,7 +22,7 @@ public:
   VkFormat format;
   VkImage image = VK_NULL_HANDLE;
   VkImageView view = VK_NULL_HANDLE;
-  VkSampler sampler = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE; // owned by the SamplerCache
   VmaAllocation allocation;
   VkImageUsageFlags usage;
   VkSamplerAddressMode samplerAddressMode;
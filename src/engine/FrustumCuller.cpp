@@ -0,0 +1,175 @@
+#include "engine/FrustumCuller.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULL_BATCH 8
+#elif defined(__SSE__) || defined(_M_X64) ||                                  \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULL_BATCH 4
+#else
+#define CULL_BATCH 1
+#endif
+
+namespace {
+
+// a plane with the absolute values of its normal next to it, for the box
+// radius along the normal
+struct CullPlane
+{
+  float nx, ny, nz, d;
+  float ax, ay, az;
+};
+
+} // namespace
+
+void
+FrustumCuller::resize(size_t newCount)
+{
+  count = newCount;
+
+  // the padding is a box at the origin with no size, it's skipped by index
+  size_t padded = (count + 7) / 8 * 8;
+  centerX.resize(padded, 0.0f);
+  centerY.resize(padded, 0.0f);
+  centerZ.resize(padded, 0.0f);
+  extentX.resize(padded, 0.0f);
+  extentY.resize(padded, 0.0f);
+  extentZ.resize(padded, 0.0f);
+}
+
+void
+FrustumCuller::setBox(size_t index, const glm::vec3& min, const glm::vec3& max)
+{
+  glm::vec3 center = (min + max) * 0.5f;
+  glm::vec3 extent = (max - min) * 0.5f;
+  centerX[index] = center.x;
+  centerY[index] = center.y;
+  centerZ[index] = center.z;
+  extentX[index] = extent.x;
+  extentY[index] = extent.y;
+  extentZ[index] = extent.z;
+}
+
+std::array<glm::vec4, 6>
+FrustumCuller::extractPlanes(const glm::mat4& viewProjection)
+{
+  // glm is column major, the rows of the matrix are spread over the columns
+  auto row = [&viewProjection](int i) {
+    return glm::vec4(viewProjection[0][i],
+                     viewProjection[1][i],
+                     viewProjection[2][i],
+                     viewProjection[3][i]);
+  };
+  glm::vec4 r0 = row(0);
+  glm::vec4 r1 = row(1);
+  glm::vec4 r2 = row(2);
+  glm::vec4 r3 = row(3);
+
+  return { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r2, r3 - r2 };
+}
+
+void
+FrustumCuller::cull(const glm::mat4& viewProjection,
+                    std::vector<uint32_t>& visible) const
+{
+  visible.clear();
+
+  std::array<glm::vec4, 6> frustum = extractPlanes(viewProjection);
+  std::array<CullPlane, 6> planes;
+  for (size_t p = 0; p < planes.size(); p++) {
+    const glm::vec4& plane = frustum[p];
+    planes[p] = { plane.x,
+                  plane.y,
+                  plane.z,
+                  plane.w,
+                  std::fabs(plane.x),
+                  std::fabs(plane.y),
+                  std::fabs(plane.z) };
+  }
+
+  // distance of the center plus the radius of the box along the normal, the
+  // box is out as soon as that's negative for one plane
+#if CULL_BATCH == 8
+  const __m256 zero = _mm256_setzero_ps();
+  for (size_t i = 0; i < count; i += 8) {
+    __m256 cx = _mm256_loadu_ps(&centerX[i]);
+    __m256 cy = _mm256_loadu_ps(&centerY[i]);
+    __m256 cz = _mm256_loadu_ps(&centerZ[i]);
+    __m256 ex = _mm256_loadu_ps(&extentX[i]);
+    __m256 ey = _mm256_loadu_ps(&extentY[i]);
+    __m256 ez = _mm256_loadu_ps(&extentZ[i]);
+
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+    for (const CullPlane& plane : planes) {
+      __m256 distance = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.nx)),
+                      _mm256_mul_ps(cy, _mm256_set1_ps(plane.ny))),
+        _mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(plane.nz)),
+                      _mm256_set1_ps(plane.d)));
+      __m256 radius = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(plane.ax)),
+                      _mm256_mul_ps(ey, _mm256_set1_ps(plane.ay))),
+        _mm256_mul_ps(ez, _mm256_set1_ps(plane.az)));
+      inside = _mm256_and_ps(
+        inside,
+        _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(inside);
+    for (int lane = 0; mask != 0 && lane < 8; lane++, mask >>= 1) {
+      if ((mask & 1) && i + lane < count) {
+        visible.push_back(static_cast<uint32_t>(i + lane));
+      }
+    }
+  }
+#elif CULL_BATCH == 4
+  const __m128 zero = _mm_setzero_ps();
+  for (size_t i = 0; i < count; i += 4) {
+    __m128 cx = _mm_loadu_ps(&centerX[i]);
+    __m128 cy = _mm_loadu_ps(&centerY[i]);
+    __m128 cz = _mm_loadu_ps(&centerZ[i]);
+    __m128 ex = _mm_loadu_ps(&extentX[i]);
+    __m128 ey = _mm_loadu_ps(&extentY[i]);
+    __m128 ez = _mm_loadu_ps(&extentZ[i]);
+
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (const CullPlane& plane : planes) {
+      __m128 distance =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.nx)),
+                              _mm_mul_ps(cy, _mm_set1_ps(plane.ny))),
+                   _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.nz)),
+                              _mm_set1_ps(plane.d)));
+      __m128 radius =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(plane.ax)),
+                              _mm_mul_ps(ey, _mm_set1_ps(plane.ay))),
+                   _mm_mul_ps(ez, _mm_set1_ps(plane.az)));
+      inside =
+        _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    for (int lane = 0; mask != 0 && lane < 4; lane++, mask >>= 1) {
+      if ((mask & 1) && i + lane < count) {
+        visible.push_back(static_cast<uint32_t>(i + lane));
+      }
+    }
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    bool inside = true;
+    for (const CullPlane& plane : planes) {
+      float distance = centerX[i] * plane.nx + centerY[i] * plane.ny +
+                       centerZ[i] * plane.nz + plane.d;
+      float radius = extentX[i] * plane.ax + extentY[i] * plane.ay +
+                     extentZ[i] * plane.az;
+      inside = inside && distance + radius >= 0.0f;
+    }
+    if (inside) {
+      visible.push_back(static_cast<uint32_t>(i));
+    }
+  }
+#endif
+}
@@ -0,0 +1,50 @@
+#ifndef _FRUSTUM_CULLER_H_
+#define _FRUSTUM_CULLER_H_
+
+#include <glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// tests world space boxes against a view frustum. the boxes are kept as
+// center and half extent, one column per component, so the test runs on 8
+// boxes at a time with AVX, 4 with SSE and one by one everywhere else.
+//
+// a box is visible unless it's entirely behind one of the six planes. boxes
+// near a corner of the frustum can pass without being inside it, never the
+// other way around.
+class FrustumCuller
+{
+public:
+  // keeps the boxes that are already set, new ones are empty
+  void resize(size_t count);
+  void setBox(size_t index, const glm::vec3& min, const glm::vec3& max);
+
+  size_t size() const { return count; }
+
+  // clears visible and fills it with the index of every box that touches the
+  // frustum of viewProjection, in increasing order
+  void cull(const glm::mat4& viewProjection,
+            std::vector<uint32_t>& visible) const;
+
+  // a * x + b * y + c * z + d >= 0 inside, for clip space depth in [0, 1].
+  // the planes aren't normalized, the box test doesn't need them to be
+  static std::array<glm::vec4, 6> extractPlanes(
+    const glm::mat4& viewProjection);
+
+private:
+  size_t count = 0;
+
+  // padded to a multiple of the widest batch, the padding never shows up as
+  // visible
+  std::vector<float> centerX;
+  std::vector<float> centerY;
+  std::vector<float> centerZ;
+  std::vector<float> extentX;
+  std::vector<float> extentY;
+  std::vector<float> extentZ;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "engine/GeometryArena.h"
+#include "engine/UploadBatcher.h"
+
+#include <iterator>
+#include <stdexcept>
+
+GeometryArena::GeometryArena(VulkanContext* vkContext,
+                             uint32_t maxVertices,
+                             uint32_t maxIndices)
+  : vkContext(vkContext)
+  , vertexRanges(maxVertices)
+  , indexRanges(maxIndices)
+{
+  vkContext->createBuffer(sizeof(Vertex) * maxVertices,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                          BufferType::GPU_BUFFER,
+                          vertexBuffer,
+                          vertexAllocation);
+  vmaSetAllocationName(
+    vkContext->allocator, vertexAllocation, "geometryArenaVertices");
+
+  vkContext->createBuffer(sizeof(uint32_t) * maxIndices,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                          BufferType::GPU_BUFFER,
+                          indexBuffer,
+                          indexAllocation);
+  vmaSetAllocationName(
+    vkContext->allocator, indexAllocation, "geometryArenaIndices");
+}
+
+GeometryArena::~GeometryArena()
+{
+  vmaDestroyBuffer(vkContext->allocator, vertexBuffer, vertexAllocation);
+  vmaDestroyBuffer(vkContext->allocator, indexBuffer, indexAllocation);
+}
+
+GeometryAllocation
+GeometryArena::allocate(const Vertex* vertices,
+                        uint32_t vertexCount,
+                        const uint32_t* indices,
+                        uint32_t indexCount)
+{
+  GeometryAllocation result;
+  if (vertexCount == 0 || indexCount == 0) {
+    return result;
+  }
+
+  uint32_t vertexOffset = vertexRanges.allocate(vertexCount);
+  if (vertexOffset == UINT32_MAX) {
+    throw std::runtime_error("geometry arena is out of vertex space!");
+  }
+
+  uint32_t firstIndex = indexRanges.allocate(indexCount);
+  if (firstIndex == UINT32_MAX) {
+    vertexRanges.free(vertexOffset, vertexCount);
+    throw std::runtime_error("geometry arena is out of index space!");
+  }
+
+  vkContext->uploadBatcher->uploadBuffer(vertexBuffer,
+                                         vertices,
+                                         sizeof(Vertex) * vertexCount,
+                                         sizeof(Vertex) * vertexOffset);
+  vkContext->uploadBatcher->uploadBuffer(indexBuffer,
+                                         indices,
+                                         sizeof(uint32_t) * indexCount,
+                                         sizeof(uint32_t) * firstIndex);
+
+  result.vertexOffset = static_cast<int32_t>(vertexOffset);
+  result.vertexCount = vertexCount;
+  result.firstIndex = firstIndex;
+  result.indexCount = indexCount;
+  return result;
+}
+
+void
+GeometryArena::free(const GeometryAllocation& allocation)
+{
+  if (!allocation.valid()) {
+    return;
+  }
+
+  vertexRanges.free(static_cast<uint32_t>(allocation.vertexOffset),
+                    allocation.vertexCount);
+  indexRanges.free(allocation.firstIndex, allocation.indexCount);
+}
+
+void
+GeometryArena::bind(VkCommandBuffer commandBuffer) const
+{
+  VkBuffer vertexBuffers[] = { vertexBuffer };
+  VkDeviceSize offsets[] = { 0 };
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+// -------------------- FREE LIST --------------------
+GeometryArena::FreeList::FreeList(uint32_t capacity)
+{
+  ranges[0] = capacity;
+}
+
+uint32_t
+GeometryArena::FreeList::allocate(uint32_t count)
+{
+  for (auto it = ranges.begin(); it != ranges.end(); it++) {
+    if (it->second < count) {
+      continue;
+    }
+
+    uint32_t offset = it->first;
+    uint32_t remaining = it->second - count;
+    ranges.erase(it);
+    if (remaining > 0) {
+      ranges[offset + count] = remaining;
+    }
+    return offset;
+  }
+
+  return UINT32_MAX;
+}
+
+void
+GeometryArena::FreeList::free(uint32_t offset, uint32_t count)
+{
+  auto next = ranges.lower_bound(offset);
+
+  // merge with the range right after
+  if (next != ranges.end() && offset + count == next->first) {
+    count += next->second;
+    next = ranges.erase(next);
+  }
+
+  // and with the one right before
+  if (next != ranges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += count;
+      return;
+    }
+  }
+
+  ranges[offset] = count;
+}
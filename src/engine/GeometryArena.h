@@ -0,0 +1,92 @@
+#ifndef _GEOMETRY_ARENA_H_
+#define _GEOMETRY_ARENA_H_
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <map>
+
+#include "engine/Vertex.h"
+#include "engine/VulkanContext.h"
+
+// capacity of the arena, in vertices and in indices. they're set from cmake,
+// the fallbacks are here so the header works on its own
+#ifndef GEOMETRY_ARENA_VERTICES
+#define GEOMETRY_ARENA_VERTICES (2 * 1024 * 1024)
+#endif
+#ifndef GEOMETRY_ARENA_INDICES
+#define GEOMETRY_ARENA_INDICES (8 * 1024 * 1024)
+#endif
+
+// where a model's geometry lives inside the arena. indices are relative to
+// vertexOffset, so draws pass it as the vertexOffset (base vertex) of
+// vkCmdDrawIndexed and firstIndex + the mesh's own start index
+struct GeometryAllocation
+{
+  int32_t vertexOffset = 0;
+  uint32_t vertexCount = 0;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+
+  bool valid() const { return vertexCount != 0 && indexCount != 0; }
+};
+
+// one device local vertex buffer and one index buffer shared by every model,
+// each sub-allocated with a first fit free list. everything is bound once per
+// pass with bind() instead of once per model, which is also what multi-draw
+// and indirect rendering need.
+class GeometryArena
+{
+public:
+  GeometryArena(VulkanContext* vkContext,
+                uint32_t maxVertices,
+                uint32_t maxIndices);
+  ~GeometryArena();
+
+  GeometryArena(const GeometryArena&) = delete;
+  GeometryArena& operator=(const GeometryArena&) = delete;
+
+  // reserves space and queues the copies on the UploadBatcher, the data can be
+  // freed as soon as this returns
+  GeometryAllocation allocate(const Vertex* vertices,
+                              uint32_t vertexCount,
+                              const uint32_t* indices,
+                              uint32_t indexCount);
+
+  // the gpu must be done with the geometry, same as destroying a buffer
+  void free(const GeometryAllocation& allocation);
+
+  void bind(VkCommandBuffer commandBuffer) const;
+
+  VkBuffer getVertexBuffer() const { return vertexBuffer; }
+  VkBuffer getIndexBuffer() const { return indexBuffer; }
+
+private:
+  VulkanContext* vkContext;
+
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VmaAllocation vertexAllocation = VK_NULL_HANDLE;
+
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  VmaAllocation indexAllocation = VK_NULL_HANDLE;
+
+  // free ranges in elements, keyed by offset so neighbours can be merged
+  class FreeList
+  {
+  public:
+    explicit FreeList(uint32_t capacity);
+
+    // returns UINT32_MAX when there's no range big enough
+    uint32_t allocate(uint32_t count);
+    void free(uint32_t offset, uint32_t count);
+
+  private:
+    std::map<uint32_t, uint32_t> ranges;
+  };
+
+  FreeList vertexRanges;
+  FreeList indexRanges;
+};
+
+#endif
@@ -0,0 +1,527 @@
+#include "engine/GpuCuller.h"
+
+#include "engine/Lights.h"
+#include "engine/ModelLoading/Model.h"
+#include "engine/PipelineCache.h"
+#include "engine/Scene.h"
+#include "engine/ShaderLibrary.h"
+#include "engine/StagingRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// these mirror the std430 structs in shaders/src/gpu_driven/cull.comp
+
+struct GpuInstance
+{
+  glm::mat4 transformation;
+  glm::vec4 worldMin;
+  glm::vec4 worldMax;
+  // x: mesh, y: material. the material is the slot in BindlessTextures, or
+  // the mesh again when the textures are bound per mesh
+  uint32_t mesh;
+  uint32_t material;
+  uint32_t padding[2];
+};
+
+// its levels of detail are in a table of their own, MAX_MESH_LODS per mesh,
+// so the layout doesn't change with MAX_MESH_LODS. the shader gets the count
+// as a specialization constant
+struct GpuMesh
+{
+  glm::vec4 bounds;
+  int32_t vertexOffset;
+  uint32_t lodCount;
+  uint32_t firstDraw;
+  uint32_t padding;
+};
+static_assert(sizeof(GpuMesh) == 32, "GpuMesh must match Mesh in cull.comp");
+
+// start index, index count and the error as float bits
+using GpuLod = glm::uvec4;
+static_assert(sizeof(GpuLod) == 16, "GpuLod must match uvec4 in cull.comp");
+
+struct CullConstants
+{
+  glm::mat4 viewProjection;
+  // xyz: where levels of detail are picked from, w: projection scale
+  glm::vec4 eye;
+  uint32_t instanceCount;
+  uint32_t firstCommand;
+  uint32_t firstCount;
+  // 1 for the camera, each mesh counts its own draws from its firstDraw on
+  uint32_t grouped;
+  float maxPixelError;
+};
+
+const uint32_t CULL_GROUP_SIZE = 64;
+
+} // namespace
+
+GpuCuller::GpuCuller(VulkanContext* vkContext)
+  : vkContext(vkContext)
+{
+  createBuffers();
+  createDescriptors();
+  createPipeline();
+}
+
+GpuCuller::~GpuCuller()
+{
+  vkDestroyPipeline(vkContext->logicalDevice, pipeline, nullptr);
+  vkDestroyPipelineLayout(vkContext->logicalDevice, pipelineLayout, nullptr);
+
+  vkDestroyDescriptorPool(vkContext->logicalDevice, descriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(vkContext->logicalDevice, setLayout, nullptr);
+
+  for (FrameBuffers& frame : frames) {
+    vmaDestroyBuffer(
+      vkContext->allocator, frame.commands, frame.commandsAllocation);
+    vmaDestroyBuffer(
+      vkContext->allocator, frame.counts, frame.countsAllocation);
+  }
+}
+
+bool
+GpuCuller::isSupported(const VulkanContext* vkContext)
+{
+  return vkContext->cmdDrawIndexedIndirectCount != nullptr;
+}
+
+void
+GpuCuller::createBuffers()
+{
+  VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) *
+                              GPU_DRIVEN_MAX_INSTANCES * (1 + MAX_SHADOW_VIEWS);
+  VkDeviceSize countsSize =
+    sizeof(uint32_t) * (GPU_DRIVEN_MAX_MESHES + MAX_SHADOW_VIEWS);
+
+  for (FrameBuffers& frame : frames) {
+    vkContext->createBuffer(commandsSize,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                            BufferType::GPU_BUFFER,
+                            frame.commands,
+                            frame.commandsAllocation);
+    vmaSetAllocationName(
+      vkContext->allocator, frame.commandsAllocation, "gpuCullerCommands");
+
+    vkContext->createBuffer(countsSize,
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            BufferType::GPU_BUFFER,
+                            frame.counts,
+                            frame.countsAllocation);
+    vmaSetAllocationName(
+      vkContext->allocator, frame.countsAllocation, "gpuCullerCounts");
+  }
+}
+
+void
+GpuCuller::createDescriptors()
+{
+  // --------------------- Create Layout ---------------------
+  // instances, meshes and their levels of detail come from the staging ring
+  // every frame, sized to the scene, and record() points the set at them.
+  // commands and counts are one buffer per frame in flight, hence one set per
+  // frame
+  std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+  for (uint32_t i = 0; i < bindings.size(); i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorCount = 1;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    // the vertex shaders only read the instances
+    bindings[i].stageFlags =
+      i == 0 ? VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT
+             : VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  if (vkCreateDescriptorSetLayout(
+        vkContext->logicalDevice, &layoutInfo, nullptr, &setLayout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor set layout!");
+  }
+
+  // --------------------- Create Pool ---------------------
+  std::array<VkDescriptorPoolSize, 1> poolSizes;
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[0].descriptorCount =
+    static_cast<uint32_t>(bindings.size()) * MAX_FRAMES_IN_FLIGHT;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+  if (vkCreateDescriptorPool(
+        vkContext->logicalDevice, &poolInfo, nullptr, &descriptorPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor pool!");
+  }
+
+  // --------------------- Create Descriptorsets ---------------------
+  for (FrameBuffers& frame : frames) {
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &setLayout;
+
+    if (vkAllocateDescriptorSets(
+          vkContext->logicalDevice, &allocInfo, &frame.descriptorSet) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    std::array<VkDescriptorBufferInfo, 2> bufferInfos{};
+    bufferInfos[0] = { frame.commands, 0, VK_WHOLE_SIZE };
+    bufferInfos[1] = { frame.counts, 0, VK_WHOLE_SIZE };
+
+    std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+    for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+      descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      descriptorWrites[i].dstSet = frame.descriptorSet;
+      descriptorWrites[i].dstBinding = 3 + i;
+      descriptorWrites[i].dstArrayElement = 0;
+      descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      descriptorWrites[i].descriptorCount = 1;
+      descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(vkContext->logicalDevice,
+                           static_cast<uint32_t>(descriptorWrites.size()),
+                           descriptorWrites.data(),
+                           0,
+                           nullptr);
+  }
+}
+
+void
+GpuCuller::createPipeline()
+{
+  VkPushConstantRange constantsRange{};
+  constantsRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  constantsRange.offset = 0;
+  constantsRange.size = sizeof(CullConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &setLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &constantsRange;
+
+  if (vkCreatePipelineLayout(vkContext->logicalDevice,
+                             &pipelineLayoutInfo,
+                             nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+
+  // constant_id 0 is how many levels of detail every mesh has room for in
+  // the table
+  const uint32_t maxMeshLods = MAX_MESH_LODS;
+  VkSpecializationMapEntry specializationEntry{ 0, 0, sizeof(uint32_t) };
+
+  VkSpecializationInfo specializationInfo{};
+  specializationInfo.mapEntryCount = 1;
+  specializationInfo.pMapEntries = &specializationEntry;
+  specializationInfo.dataSize = sizeof(uint32_t);
+  specializationInfo.pData = &maxMeshLods;
+
+  // the registry only builds graphics pipelines, this is the one compute
+  // pipeline so it's created here directly
+  VkPipelineShaderStageCreateInfo stageInfo{};
+  stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  stageInfo.module = vkContext->shaderLibrary->get("gpu_driven/cull_comp.spv");
+  stageInfo.pName = "main";
+  stageInfo.pSpecializationInfo = &specializationInfo;
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = stageInfo;
+  pipelineInfo.layout = pipelineLayout;
+
+  if (vkCreateComputePipelines(vkContext->logicalDevice,
+                               vkContext->pipelineCache->get(),
+                               1,
+                               &pipelineInfo,
+                               nullptr,
+                               &pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline!");
+  }
+}
+
+void
+GpuCuller::record(VkCommandBuffer commandBuffer,
+                  uint32_t frameIndex,
+                  const Scene& scene)
+{
+  currentFrame = frameIndex;
+  const FrameBuffers& frame = frames[frameIndex];
+
+  // -------------------- GROUP BY MESH --------------------
+  meshes.clear();
+  meshIndices.clear();
+  instanceCount = 0;
+  for (const Model& model : scene.models) {
+    for (const auto& mesh : model.uniqueMeshes) {
+      meshIndices[mesh.get()] = static_cast<uint32_t>(meshes.size());
+      meshes.push_back(mesh.get());
+    }
+    instanceCount += static_cast<uint32_t>(model.meshInstances.size());
+  }
+
+  if (instanceCount > GPU_DRIVEN_MAX_INSTANCES ||
+      meshes.size() > GPU_DRIVEN_MAX_MESHES) {
+    throw std::runtime_error("too many instances for the gpu culler!");
+  }
+
+  // every mesh gets a contiguous run of commands, as many as it has instances
+  drawCounts.assign(meshes.size(), 0);
+  for (const Model& model : scene.models) {
+    for (const MeshInstance& instance : model.meshInstances) {
+      drawCounts[meshIndices[instance.mesh]]++;
+    }
+  }
+  firstDraws.resize(meshes.size());
+  uint32_t firstDraw = 0;
+  for (size_t i = 0; i < meshes.size(); i++) {
+    firstDraws[i] = firstDraw;
+    firstDraw += drawCounts[i];
+  }
+
+  // -------------------- UPLOAD --------------------
+  // the tables only take what the scene has, a binding can't be empty so
+  // there's room for one entry at least
+  StagingRing* ring = vkContext->stagingRing;
+  VkDeviceSize alignment =
+    vkContext->deviceProperties.limits.minStorageBufferOffsetAlignment;
+  VkDeviceSize meshCount = std::max<VkDeviceSize>(meshes.size(), 1);
+
+  StagingAllocation instanceTable = ring->allocateFrameData(
+    sizeof(GpuInstance) * std::max(instanceCount, 1u), alignment);
+  StagingAllocation meshTable =
+    ring->allocateFrameData(sizeof(GpuMesh) * meshCount, alignment);
+  StagingAllocation lodTable = ring->allocateFrameData(
+    sizeof(GpuLod) * MAX_MESH_LODS * meshCount, alignment);
+
+  GpuInstance* instances = static_cast<GpuInstance*>(instanceTable.mapped);
+  uint32_t instanceIndex = 0;
+  for (const Model& model : scene.models) {
+    for (const MeshInstance& instance : model.meshInstances) {
+      GpuInstance& gpuInstance = instances[instanceIndex++];
+      gpuInstance.transformation = instance.transformation;
+      gpuInstance.worldMin = glm::vec4(instance.worldMin, 0.0f);
+      gpuInstance.worldMax = glm::vec4(instance.worldMax, 0.0f);
+      gpuInstance.mesh = meshIndices[instance.mesh];
+      gpuInstance.material = vkContext->bindlessTextures
+                               ? instance.mesh->material
+                               : gpuInstance.mesh;
+    }
+  }
+
+  GpuMesh* gpuMeshes = static_cast<GpuMesh*>(meshTable.mapped);
+  GpuLod* gpuLods = static_cast<GpuLod*>(lodTable.mapped);
+  for (size_t i = 0; i < meshes.size(); i++) {
+    const Mesh* mesh = meshes[i];
+    GpuMesh& gpuMesh = gpuMeshes[i];
+    gpuMesh.bounds = mesh->bounds;
+    gpuMesh.vertexOffset = mesh->vertexOffset;
+    gpuMesh.lodCount = static_cast<uint32_t>(mesh->lods.size());
+    gpuMesh.firstDraw = firstDraws[i];
+    for (size_t lod = 0; lod < mesh->lods.size(); lod++) {
+      uint32_t error;
+      memcpy(&error, &mesh->lods[lod].error, sizeof(error));
+      gpuLods[i * MAX_MESH_LODS + lod] = GpuLod(
+        mesh->lods[lod].startIndex, mesh->lods[lod].indexCount, error, 0);
+    }
+  }
+
+  ring->flush(instanceTable);
+  ring->flush(meshTable);
+  ring->flush(lodTable);
+
+  // the fence of this frame has been waited on, its set is idle
+  std::array<VkDescriptorBufferInfo, 3> tableInfos{};
+  tableInfos[0] = { instanceTable.buffer,
+                    instanceTable.offset,
+                    instanceTable.size };
+  tableInfos[1] = { meshTable.buffer, meshTable.offset, meshTable.size };
+  tableInfos[2] = { lodTable.buffer, lodTable.offset, lodTable.size };
+
+  std::array<VkWriteDescriptorSet, 3> tableWrites{};
+  for (uint32_t i = 0; i < tableWrites.size(); i++) {
+    tableWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    tableWrites[i].dstSet = frame.descriptorSet;
+    tableWrites[i].dstBinding = i;
+    tableWrites[i].dstArrayElement = 0;
+    tableWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    tableWrites[i].descriptorCount = 1;
+    tableWrites[i].pBufferInfo = &tableInfos[i];
+  }
+  vkUpdateDescriptorSets(vkContext->logicalDevice,
+                         static_cast<uint32_t>(tableWrites.size()),
+                         tableWrites.data(),
+                         0,
+                         nullptr);
+
+  // -------------------- CULL --------------------
+  vkCmdFillBuffer(commandBuffer, frame.counts, 0, VK_WHOLE_SIZE, 0);
+
+  VkMemoryBarrier clearBarrier{};
+  clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  clearBarrier.dstAccessMask =
+    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0,
+                       1,
+                       &clearBarrier,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer,
+                          VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipelineLayout,
+                          0,
+                          1,
+                          &frame.descriptorSet,
+                          0,
+                          nullptr);
+
+  uint32_t groupCount = (instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+  auto cull = [&](const glm::mat4& viewProjection,
+                  uint32_t view,
+                  float maxPixelError) {
+    if (view > MAX_SHADOW_VIEWS) {
+      throw std::runtime_error("too many shadow views for the gpu culler!");
+    }
+
+    CullConstants constants{};
+    constants.viewProjection = viewProjection;
+    constants.eye =
+      glm::vec4(scene.lodSelector.eye, scene.lodSelector.projectionScale);
+    constants.instanceCount = instanceCount;
+    constants.firstCommand = view * GPU_DRIVEN_MAX_INSTANCES;
+    constants.firstCount = view == 0 ? 0 : GPU_DRIVEN_MAX_MESHES + view - 1;
+    constants.grouped = view == 0 ? 1 : 0;
+    constants.maxPixelError = maxPixelError;
+
+    vkCmdPushConstants(commandBuffer,
+                       pipelineLayout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(CullConstants),
+                       &constants);
+    vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+  };
+
+  if (groupCount > 0) {
+    // view 0 is the camera, the shadow views follow in ShadowMapPass order
+    cull(scene.getViewProjection(), 0, scene.lodSelector.maxPixelError);
+
+    float shadowError = scene.shadowLodSelector.maxPixelError;
+    uint32_t view = 1;
+    if (scene.directionalLight->castsShadow()) {
+      cull(scene.directionalLight->getTransform(), view++, shadowError);
+    }
+    for (const SpotLight& spotlight : scene.spotLights) {
+      if (spotlight.castsShadow()) {
+        cull(spotlight.getTransform(), view++, shadowError);
+      }
+    }
+    for (const PointLight& pointlight : scene.pointLights) {
+      if (!pointlight.castsShadow()) {
+        continue;
+      }
+      for (int i = 0; i <= PointLight::BACK; i++) {
+        PointLight::Side side = static_cast<PointLight::Side>(i);
+        cull(pointlight.getTransform(side), view++, shadowError);
+      }
+    }
+  }
+
+  VkMemoryBarrier cullBarrier{};
+  cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                       0,
+                       1,
+                       &cullBarrier,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr);
+}
+
+void
+GpuCuller::bind(VkCommandBuffer commandBuffer,
+                VkPipelineLayout layout,
+                uint32_t set) const
+{
+  vkCmdBindDescriptorSets(commandBuffer,
+                          VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          layout,
+                          set,
+                          1,
+                          &frames[currentFrame].descriptorSet,
+                          0,
+                          nullptr);
+}
+
+void
+GpuCuller::drawMesh(VkCommandBuffer commandBuffer, uint32_t mesh) const
+{
+  if (drawCounts[mesh] == 0) {
+    return;
+  }
+
+  const FrameBuffers& frame = frames[currentFrame];
+  vkContext->cmdDrawIndexedIndirectCount(
+    commandBuffer,
+    frame.commands,
+    sizeof(VkDrawIndexedIndirectCommand) * firstDraws[mesh],
+    frame.counts,
+    sizeof(uint32_t) * mesh,
+    drawCounts[mesh],
+    sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void
+GpuCuller::drawShadowView(VkCommandBuffer commandBuffer, uint32_t view) const
+{
+  if (instanceCount == 0) {
+    return;
+  }
+
+  const FrameBuffers& frame = frames[currentFrame];
+  vkContext->cmdDrawIndexedIndirectCount(
+    commandBuffer,
+    frame.commands,
+    sizeof(VkDrawIndexedIndirectCommand) * GPU_DRIVEN_MAX_INSTANCES *
+      (1 + view),
+    frame.counts,
+    sizeof(uint32_t) * (GPU_DRIVEN_MAX_MESHES + view),
+    instanceCount,
+    sizeof(VkDrawIndexedIndirectCommand));
+}
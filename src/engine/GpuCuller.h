@@ -0,0 +1,118 @@
+#ifndef _GPU_CULLER_H_
+#define _GPU_CULLER_H_
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_core.h>
+
+#include <glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "engine/LightManager.h"
+#include "engine/VulkanContext.h"
+
+// capacity of the gpu driven path, set from cmake. the fallbacks are here so
+// the header works on its own
+#ifndef GPU_DRIVEN_MAX_INSTANCES
+#define GPU_DRIVEN_MAX_INSTANCES 8192
+#endif
+#ifndef GPU_DRIVEN_MAX_MESHES
+#define GPU_DRIVEN_MAX_MESHES 1024
+#endif
+
+class Mesh;
+class Scene;
+
+// culls every mesh instance of the scene in a compute shader and writes the
+// survivors out as VkDrawIndexedIndirectCommand records, so a pass draws them
+// all with a handful of vkCmdDrawIndexedIndirectCount calls no matter how
+// many instances there are.
+//
+// one view is the camera, its draws are grouped by mesh so every mesh can
+// bind its own textures when there are no BindlessTextures. the others are
+// the shadow views in the order ShadowMapPass renders them (directional, then
+// every spot, then the six faces of every point light, skipping lights that
+// don't cast shadows), each with a single list.
+//
+// the vertex shaders of the gpu driven pipelines read their model matrix from
+// the instance buffer at gl_InstanceIndex, the draws put the instance there
+// through firstInstance.
+class GpuCuller
+{
+public:
+  GpuCuller(VulkanContext* vkContext);
+  ~GpuCuller();
+
+  GpuCuller(const GpuCuller&) = delete;
+  GpuCuller& operator=(const GpuCuller&) = delete;
+
+  // true when the device was created with everything this needs, see
+  // VulkanContext::cmdDrawIndexedIndirectCount
+  static bool isSupported(const VulkanContext* vkContext);
+
+  // uploads the instances and records the culling of every view. outside of
+  // a render pass, before any of the draws below
+  void record(VkCommandBuffer commandBuffer,
+              uint32_t frameIndex,
+              const Scene& scene);
+
+  // the instance buffer is binding 0 of this set, add it to the pipeline
+  // layout of the gpu driven pipelines
+  VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout; }
+  void bind(VkCommandBuffer commandBuffer,
+            VkPipelineLayout layout,
+            uint32_t set) const;
+
+  // the meshes the camera draws are grouped by, drawMesh(i) draws the visible
+  // instances of meshes[i]
+  const std::vector<const Mesh*>& getMeshes() const { return meshes; }
+  void drawMesh(VkCommandBuffer commandBuffer, uint32_t mesh) const;
+
+  // draws what's visible from a shadow view, numbered like described above
+  void drawShadowView(VkCommandBuffer commandBuffer, uint32_t view) const;
+
+  // the directional light and a view per tile of the shadow atlas, a spot
+  // light takes one of them and a point light six
+  static const uint32_t MAX_SHADOW_VIEWS = 1 + ATLAS_TILES * ATLAS_TILES;
+
+private:
+  VulkanContext* vkContext;
+
+  VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+  void createDescriptors();
+
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  void createPipeline();
+
+  // the commands and counts of one frame in flight, written by the compute
+  // shader and read by the draws of the same frame. the camera owns the first
+  // GPU_DRIVEN_MAX_INSTANCES commands and GPU_DRIVEN_MAX_MESHES counts, every
+  // shadow view gets the same number of commands and a single count after it
+  struct FrameBuffers
+  {
+    VkBuffer commands = VK_NULL_HANDLE;
+    VmaAllocation commandsAllocation = VK_NULL_HANDLE;
+    VkBuffer counts = VK_NULL_HANDLE;
+    VmaAllocation countsAllocation = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+  };
+  std::array<FrameBuffers, MAX_FRAMES_IN_FLIGHT> frames;
+  void createBuffers();
+
+  // -------------------- CURRENT FRAME --------------------
+  uint32_t currentFrame = 0;
+  uint32_t instanceCount = 0;
+
+  std::vector<const Mesh*> meshes;
+  std::unordered_map<const Mesh*, uint32_t> meshIndices;
+  // first command and number of instances of every mesh in the camera view
+  std::vector<uint32_t> firstDraws;
+  std::vector<uint32_t> drawCounts;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "engine/InstanceBatcher.h"
+#include "engine/ModelLoading/Mesh.h"
+#include "engine/StagingRing.h"
+
+#include <algorithm>
+
+InstanceBatcher::InstanceBatcher(VulkanContext* vkContext)
+  : vkContext(vkContext)
+{
+}
+
+void
+InstanceBatcher::clear()
+{
+  batches.clear();
+  batchIndices.clear();
+  entries.clear();
+  buffer = VK_NULL_HANDLE;
+}
+
+void
+InstanceBatcher::add(const Mesh* mesh,
+                     const MeshLod& lod,
+                     const glm::mat4& model,
+                     float depth,
+                     const glm::vec4& color)
+{
+  auto found = batchIndices.find(&lod);
+  uint32_t batch;
+  if (found == batchIndices.end()) {
+    batch = static_cast<uint32_t>(batches.size());
+    batchIndices.emplace(&lod, batch);
+    batches.push_back({ mesh, &lod, 0, 0, depth });
+  } else {
+    batch = found->second;
+  }
+
+  batches[batch].instanceCount++;
+  batches[batch].depth = std::min(batches[batch].depth, depth);
+  entries.push_back({ batch, { model, color, mesh->material } });
+}
+
+void
+InstanceBatcher::upload()
+{
+  if (entries.empty()) {
+    return;
+  }
+
+  StagingRing* ring = vkContext->stagingRing;
+  StagingAllocation allocation = ring->allocateFrameData(
+    entries.size() * sizeof(InstanceData), sizeof(glm::vec4));
+
+  // every batch gets a contiguous range, then the instances are scattered
+  // into it in the order they came in
+  cursors.resize(batches.size());
+  uint32_t first = 0;
+  for (size_t i = 0; i < batches.size(); i++) {
+    batches[i].firstInstance = first;
+    cursors[i] = first;
+    first += batches[i].instanceCount;
+  }
+
+  InstanceData* instances = static_cast<InstanceData*>(allocation.mapped);
+  for (const Entry& entry : entries) {
+    instances[cursors[entry.batch]++] = entry.data;
+  }
+  ring->flush(allocation);
+
+  buffer = allocation.buffer;
+  offset = allocation.offset;
+}
+
+void
+InstanceBatcher::bind(VkCommandBuffer commandBuffer) const
+{
+  if (buffer == VK_NULL_HANDLE) {
+    return;
+  }
+  vkCmdBindVertexBuffers(commandBuffer, 1, 1, &buffer, &offset);
+}
+
+void
+InstanceBatcher::draw(VkCommandBuffer commandBuffer,
+                      const InstanceBatch& batch) const
+{
+  vkCmdDrawIndexed(commandBuffer,
+                   batch.lod->indexCount,
+                   batch.instanceCount,
+                   batch.lod->startIndex,
+                   batch.mesh->vertexOffset,
+                   batch.firstInstance);
+}
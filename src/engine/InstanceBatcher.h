@@ -0,0 +1,83 @@
+#ifndef _INSTANCE_BATCHER_H_
+#define _INSTANCE_BATCHER_H_
+
+#include <vulkan/vulkan_core.h>
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "engine/Vertex.h"
+#include "engine/VulkanContext.h"
+
+class Mesh;
+struct MeshLod;
+
+// the instances of one mesh at one level of detail, drawn with a single
+// vkCmdDrawIndexed. firstInstance is where its InstanceData starts, depth is
+// the one of the nearest instance
+struct InstanceBatch
+{
+  const Mesh* mesh;
+  const MeshLod* lod;
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+  float depth;
+};
+
+// collects the instances a pass draws and groups the ones that share a mesh
+// and a level of detail, so every group is one instanced draw no matter how
+// many times the mesh shows up. the batches come out in the order their
+// first instance was added.
+//
+// upload() writes the InstanceData of every batch next to each other into
+// the staging ring, the pipelines read it at binding 1 (see
+// GraphicsPipelineDesc::instanceInput). the vectors keep their capacity, once
+// they've grown building the batches allocates nothing.
+class InstanceBatcher
+{
+public:
+  InstanceBatcher(VulkanContext* vkContext);
+
+  void clear();
+  // depth is how far the instance is from the view, for sorting the batches
+  // (see DrawList)
+  void add(const Mesh* mesh,
+           const MeshLod& lod,
+           const glm::mat4& model,
+           float depth,
+           const glm::vec4& color = glm::vec4(1.0f));
+
+  // once after the last add(), the data is good until the ring region of the
+  // frame is released
+  void upload();
+
+  // binding 1, the vertices at binding 0 stay as they are
+  void bind(VkCommandBuffer commandBuffer) const;
+  void draw(VkCommandBuffer commandBuffer, const InstanceBatch& batch) const;
+
+  const std::vector<InstanceBatch>& getBatches() const { return batches; }
+  size_t getInstanceCount() const { return entries.size(); }
+
+private:
+  VulkanContext* vkContext;
+
+  std::vector<InstanceBatch> batches;
+  // levels of detail live in their mesh, the pointer alone tells both apart
+  std::unordered_map<const MeshLod*, uint32_t> batchIndices;
+
+  struct Entry
+  {
+    uint32_t batch;
+    InstanceData data;
+  };
+  std::vector<Entry> entries;
+  std::vector<uint32_t> cursors;
+
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+};
+
+#endif
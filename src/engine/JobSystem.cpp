@@ -0,0 +1,63 @@
+#include "engine/JobSystem.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+  if (threadCount == 0) {
+    // hardware_concurrency can return 0 when it doesn't know
+    uint32_t cores = std::thread::hardware_concurrency();
+    threadCount = std::max(cores, 2u) - 1;
+  }
+
+  workers.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    workers.emplace_back(&JobSystem::workerLoop, this);
+  }
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+
+  // whatever is still queued gets run before the workers exit, nobody is left
+  // waiting on a future that never completes
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void
+JobSystem::push(std::function<void()> job)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  condition.notify_one();
+}
+
+void
+JobSystem::workerLoop()
+{
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+      if (jobs.empty()) {
+        return;
+      }
+
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+
+    job();
+  }
+}
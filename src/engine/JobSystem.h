@@ -0,0 +1,59 @@
+#ifndef _JOB_SYSTEM_H_
+#define _JOB_SYSTEM_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed pool of worker threads for cpu work like file reads, model imports
+// and image decoding. jobs never touch vulkan, whatever they produce is handed
+// back through the future and uploaded on the main thread. the one exception
+// is pipeline compilation, vkCreateGraphicsPipelines is free threaded.
+//
+// a job must not wait on the future of another job, with every worker waiting
+// nothing would be left to run them.
+class JobSystem
+{
+public:
+  // 0 uses one thread per core, minus the main thread
+  JobSystem(uint32_t threadCount = 0);
+  ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  // exceptions thrown by the job are rethrown by future.get()
+  template<typename Job>
+  auto submit(Job&& job) -> std::future<decltype(job())>
+  {
+    using Result = decltype(job());
+
+    // std::function needs something copyable
+    auto task =
+      std::make_shared<std::packaged_task<Result()>>(std::forward<Job>(job));
+    std::future<Result> future = task->get_future();
+    push([task]() { (*task)(); });
+    return future;
+  }
+
+  size_t getThreadCount() const { return workers.size(); }
+
+private:
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<std::function<void()>> jobs;
+  bool stopping = false;
+
+  void push(std::function<void()> job);
+  void workerLoop();
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "engine/KtxLoader.h"
+#include "engine/UploadBatcher.h"
+
+#include <ktx.h>
+// from deps/ktx/lib, maps the gl internal format stored in the file to vulkan
+#include <vk_format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+std::vector<std::string>
+getKtxCandidates(const std::string& filePath)
+{
+  size_t slash = filePath.find_last_of("/\\");
+  size_t dot = filePath.find_last_of('.');
+  bool hasExtension =
+    dot != std::string::npos && (slash == std::string::npos || dot > slash);
+
+  if (hasExtension && filePath.substr(dot) == ".ktx") {
+    return { filePath };
+  }
+
+  std::string stem = hasExtension ? filePath.substr(0, dot) : filePath;
+  return {
+    stem + ".bc7.ktx",
+    stem + ".astc.ktx",
+    stem + ".etc2.ktx",
+    stem + ".ktx",
+  };
+}
+
+bool
+hasKtxCandidate(const std::string& filePath)
+{
+  for (const std::string& candidate : getKtxCandidates(filePath)) {
+    std::error_code error;
+    if (std::filesystem::exists(candidate, error)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+loadKtxImage(VulkanContext* vkContext,
+             const std::string& filePath,
+             KtxImage& result)
+{
+  // only the header is read here, the image data is loaded below
+  ktxTexture* texture;
+  if (ktxTexture_CreateFromNamedFile(filePath.c_str(),
+                                     KTX_TEXTURE_CREATE_NO_FLAGS,
+                                     &texture) != KTX_SUCCESS) {
+    return false;
+  }
+
+  VkFormat format =
+    vkGetFormatFromOpenGLInternalFormat(texture->glInternalformat);
+
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(
+    vkContext->physicalDevice, format, &properties);
+
+  bool supported =
+    format != VK_FORMAT_UNDEFINED && texture->numDimensions == 2 &&
+    texture->numLayers == 1 &&
+    (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+  if (!supported) {
+    ktxTexture_Destroy(texture);
+    return false;
+  }
+
+  // read the image data before anything is created on the device, a file that
+  // turns out to be truncated must not leave an image and a staged copy into
+  // it behind
+  if (ktxTexture_LoadImageData(texture, nullptr, 0) != KTX_SUCCESS) {
+    ktxTexture_Destroy(texture);
+    throw std::runtime_error("failed to read ktx image data! " + filePath);
+  }
+
+  result.format = format;
+  result.width = texture->baseWidth;
+  result.height = texture->baseHeight;
+  result.layerCount = texture->numFaces;
+  result.mipLevels = texture->numLevels;
+
+  // -------------------- CREATE IMAGE --------------------
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.flags =
+    texture->isCubemap ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = result.width;
+  imageInfo.extent.height = result.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = result.mipLevels;
+  imageInfo.arrayLayers = result.layerCount;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage =
+    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VmaAllocationCreateInfo allocCreateInfo = {};
+  allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+  allocCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+  allocCreateInfo.priority = 1.0f;
+
+  if (vmaCreateImage(vkContext->allocator,
+                     &imageInfo,
+                     &allocCreateInfo,
+                     &result.image,
+                     &result.allocation,
+                     nullptr) != VK_SUCCESS) {
+    ktxTexture_Destroy(texture);
+    throw std::runtime_error("failed to create image!");
+  }
+  vmaSetAllocationName(vkContext->allocator, result.allocation, "ktxImage");
+
+  // -------------------- UPLOAD --------------------
+  // the faces of a level are stored one after the other, which is the layout
+  // stageImageLevels() expects
+  std::vector<ImageLevel> levels(result.mipLevels);
+  for (uint32_t i = 0; i < result.mipLevels; i++) {
+    ktx_size_t offset;
+    ktxTexture_GetImageOffset(texture, i, 0, 0, &offset);
+
+    levels[i].width = std::max(result.width >> i, 1u);
+    levels[i].height = std::max(result.height >> i, 1u);
+    levels[i].offset = offset;
+    levels[i].layerSize = ktxTexture_GetImageSize(texture, i);
+  }
+
+  ktx_size_t size = ktxTexture_GetSize(texture);
+  void* mapped = vkContext->uploadBatcher->stageImageLevels(
+    result.image, result.layerCount, levels, size);
+  memcpy(mapped, ktxTexture_GetData(texture), size);
+  ktxTexture_Destroy(texture);
+
+  return true;
+}
@@ -0,0 +1,40 @@
+#ifndef _KTX_LOADER_H_
+#define _KTX_LOADER_H_
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_core.h>
+
+#include <string>
+#include <vector>
+
+#include "engine/VulkanContext.h"
+
+// an image created from a .ktx file, the caller owns image and allocation
+struct KtxImage
+{
+  VkImage image = VK_NULL_HANDLE;
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t layerCount = 0; // 6 for cubemaps
+  uint32_t mipLevels = 0;
+};
+
+// the precompressed files to look for in place of an image, best format first.
+// "textures/wood.png" gives textures/wood.bc7.ktx, wood.astc.ktx, wood.etc2.ktx
+// and wood.ktx. a path that already ends in .ktx is returned as it is.
+std::vector<std::string> getKtxCandidates(const std::string& filePath);
+// thread safe, true if any of the candidates exists on disk
+bool hasKtxCandidate(const std::string& filePath);
+
+// reads a 2d or cubemap .ktx (block compressed or not) with all of its stored
+// mip levels and queues the upload. returns false when the file can't be
+// opened or the gpu can't sample its format, so the caller can try the next
+// candidate or fall back to the source image. throws when the image data is
+// truncated, before the image is created.
+bool loadKtxImage(VulkanContext* vkContext,
+                  const std::string& filePath,
+                  KtxImage& result);
+
+#endif
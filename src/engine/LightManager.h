@@ -6,9 +6,22 @@
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 
-// TODO: move these constants into CMAKE
-const uint32_t MAX_POINT_LIGHTS = 5;
-const uint32_t MAX_SPOT_LIGHTS = 2;
+// how many lights the uniform arrays of the forward shaders hold,
+// BlinnPhongPass hands them to shaders/src/texture.frag as the NR_POINT_LIGHTS
+// and NR_SPOT_LIGHTS specialization constants. lights past these are left out
+// there, the clustered shaders take any number (see ClusteredLights). set
+// from cmake, the fallbacks are here so the header works on its own
+#ifndef MAX_POINT_LIGHTS
+#define MAX_POINT_LIGHTS 5
+#endif
+#ifndef MAX_SPOT_LIGHTS
+#define MAX_SPOT_LIGHTS 2
+#endif
+
+// the point and spot shadow maps share an atlas of ATLAS_TILES x ATLAS_TILES
+#ifndef ATLAS_TILES
+#define ATLAS_TILES 4
+#endif
 
 class LightManager
 {
@@ -102,6 +102,7 @@ struct SpotLight
   const glm::vec4& getPosition() const { return position; }
   const glm::vec4& getDirection() const { return direction; }
   const glm::vec4& getColor() const { return color; }
+  const glm::vec4& getCutoff() const { return cutoff; }
   const glm::mat4& getTransform() const { return transform; }
   const glm::vec4& getAtlasCoordinatesPixel() const { return atlasCoordsPixel; }
   const glm::vec4& getAtlasCoordinatesNormalized() const
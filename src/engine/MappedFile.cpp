@@ -0,0 +1,121 @@
+#include "engine/MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+#ifdef _WIN32
+
+bool
+MappedFile::open(const std::string& filePath)
+{
+  close();
+
+  HANDLE file = CreateFileA(filePath.c_str(),
+                            GENERIC_READ,
+                            FILE_SHARE_READ,
+                            nullptr,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping =
+    CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return false;
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  fileHandle = file;
+  mappingHandle = mapping;
+  mapped = static_cast<const unsigned char*>(view);
+  mappedSize = static_cast<size_t>(fileSize.QuadPart);
+  return true;
+}
+
+void
+MappedFile::close()
+{
+  if (mapped != nullptr) {
+    UnmapViewOfFile(mapped);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+  }
+
+  mapped = nullptr;
+  mappedSize = 0;
+  fileHandle = nullptr;
+  mappingHandle = nullptr;
+}
+
+#else
+
+bool
+MappedFile::open(const std::string& filePath)
+{
+  close();
+
+  int fd = ::open(filePath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(info.st_size);
+  void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+  if (view == MAP_FAILED) {
+    return false;
+  }
+
+  mapped = static_cast<const unsigned char*>(view);
+  mappedSize = size;
+  return true;
+}
+
+void
+MappedFile::close()
+{
+  if (mapped != nullptr) {
+    munmap(const_cast<unsigned char*>(mapped), mappedSize);
+  }
+
+  mapped = nullptr;
+  mappedSize = 0;
+}
+
+#endif
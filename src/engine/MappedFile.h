@@ -0,0 +1,36 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+// read only memory mapping of a whole file. the pages are only read from disk
+// when they're touched, so copying straight out of data() costs one memcpy and
+// no intermediate buffers.
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // false if the file doesn't exist, is empty or can't be mapped
+  bool open(const std::string& filePath);
+  void close();
+
+  const unsigned char* data() const { return mapped; }
+  size_t size() const { return mappedSize; }
+
+private:
+  const unsigned char* mapped = nullptr;
+  size_t mappedSize = 0;
+
+#ifdef _WIN32
+  void* fileHandle = nullptr;
+  void* mappingHandle = nullptr;
+#endif
+};
+
+#endif
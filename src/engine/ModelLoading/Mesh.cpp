@@ -1,52 +1,148 @@
 #include "engine/ModelLoading/Mesh.h"
+#include "engine/BindlessTextures.h"
+#include "engine/TextureStreamer.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <stdexcept>
 
+// models are loaded on the job system, meshes are created on any thread
+static std::atomic<uint32_t> nextMeshId{ 0 };
+
 Mesh::Mesh(VulkanContext* vkContext,
-           size_t indexCount,
-           size_t startIndex,
-           Texture&& diffuseTexture,
-           Texture&& specularTexture)
-  : vkContext(vkContext)
-  , indexCount(indexCount)
-  , startIndex(startIndex)
-  , diffuseTexture(std::move(diffuseTexture))
+           std::vector<MeshLod> lods,
+           const glm::vec4& bounds,
+           const glm::vec3& aabbMin,
+           const glm::vec3& aabbMax,
+           std::shared_ptr<Texture> diffuseTexture,
+           std::shared_ptr<Texture> specularTexture)
+  : diffuseTexture(std::move(diffuseTexture))
   , specularTexture(std::move(specularTexture))
+  , id(nextMeshId++)
+  , lods(std::move(lods))
+  , bounds(bounds)
+  , aabbMin(aabbMin)
+  , aabbMax(aabbMax)
+  , vkContext(vkContext)
 {
+  if (this->lods.empty()) {
+    throw std::runtime_error("mesh needs at least one level of detail!");
+  }
 }
 
 Mesh::~Mesh() {}
 
+const MeshLod&
+Mesh::selectLod(const glm::mat4& transformation,
+                const LodSelector& selector) const
+{
+  if (lods.size() == 1) {
+    return lods[0];
+  }
+
+  // errors and the radius grow with the largest scale of the instance
+  float scale = std::max(glm::length(glm::vec3(transformation[0])),
+                         std::max(glm::length(glm::vec3(transformation[1])),
+                                  glm::length(glm::vec3(transformation[2]))));
+  glm::vec3 center =
+    glm::vec3(transformation * glm::vec4(glm::vec3(bounds), 1.0f));
+
+  // from the closest point of the bounding sphere, inside it there's no
+  // telling how close the surface is
+  float distance = glm::length(center - selector.eye) - bounds.w * scale;
+  if (distance <= 0.0f) {
+    return lods[0];
+  }
+
+  float pixelsPerUnit = selector.projectionScale * scale / distance;
+  for (size_t i = lods.size() - 1; i > 0; i--) {
+    if (lods[i].error * pixelsPerUnit <= selector.maxPixelError) {
+      return lods[i];
+    }
+  }
+  return lods[0];
+}
+
 void
 Mesh::createDescriptorSet(VkDescriptorPool descriptorPool,
                           VkDescriptorSetLayout descriptorLayout)
 {
+  std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts;
+  layouts.fill(descriptorLayout);
+
   VkDescriptorSetAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
   allocInfo.descriptorPool = descriptorPool;
-  allocInfo.descriptorSetCount = 1;
-  allocInfo.pSetLayouts = &descriptorLayout;
+  allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+  allocInfo.pSetLayouts = layouts.data();
 
-  if (vkAllocateDescriptorSets(
-        vkContext->logicalDevice, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+  if (vkAllocateDescriptorSets(vkContext->logicalDevice,
+                               &allocInfo,
+                               descriptorSets.data()) != VK_SUCCESS) {
     throw std::runtime_error("failed to allocate descriptor sets!");
   }
 
+  BindlessTextures* bindless = vkContext->bindlessTextures;
+  if (bindless) {
+    uint32_t diffuse = bindless->acquire(*diffuseTexture);
+    uint32_t specular = bindless->acquire(*specularTexture);
+    if (diffuse != BINDLESS_NO_SLOT && specular != BINDLESS_NO_SLOT) {
+      material = diffuse | specular << 16;
+    }
+  }
+
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    writeDescriptorSet(i);
+  }
+  descriptorSet = descriptorSets[0];
+}
+
+void
+Mesh::prepareFrame(uint32_t frameIndex)
+{
+  TextureStreamer* streamer = vkContext->textureStreamer;
+  if (diffuseTexture->getStream()) {
+    streamer->touch(diffuseTexture->getStream());
+  }
+  if (specularTexture->getStream()) {
+    streamer->touch(specularTexture->getStream());
+  }
+
+  const WrittenVersions& written = writtenVersions[frameIndex];
+  if (written.diffuse != diffuseTexture->getVersion() ||
+      written.specular != specularTexture->getVersion()) {
+    writeDescriptorSet(frameIndex);
+  }
+
+  // shared textures are written once, the others find them up to date
+  if (material != NO_MATERIAL) {
+    vkContext->bindlessTextures->write(frameIndex, *diffuseTexture);
+    vkContext->bindlessTextures->write(frameIndex, *specularTexture);
+  }
+
+  descriptorSet = descriptorSets[frameIndex];
+}
+
+void
+Mesh::writeDescriptorSet(uint32_t frameIndex)
+{
+  VkDescriptorSet set = descriptorSets[frameIndex];
+
   VkDescriptorImageInfo diffuseImageInfo{};
   diffuseImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  diffuseImageInfo.imageView = diffuseTexture.view;
-  diffuseImageInfo.sampler = diffuseTexture.sampler;
+  diffuseImageInfo.imageView = diffuseTexture->getView();
+  diffuseImageInfo.sampler = diffuseTexture->sampler;
 
   VkDescriptorImageInfo specularImageInfo{};
   specularImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  specularImageInfo.imageView = specularTexture.view;
-  specularImageInfo.sampler = specularTexture.sampler;
+  specularImageInfo.imageView = specularTexture->getView();
+  specularImageInfo.sampler = specularTexture->sampler;
 
   std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
 
   descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  descriptorWrites[0].dstSet = descriptorSet;
+  descriptorWrites[0].dstSet = set;
   descriptorWrites[0].dstBinding = 0;
   descriptorWrites[0].dstArrayElement = 0;
   descriptorWrites[0].descriptorType =
@@ -55,7 +151,7 @@ Mesh::createDescriptorSet(VkDescriptorPool descriptorPool,
   descriptorWrites[0].pImageInfo = &diffuseImageInfo;
 
   descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  descriptorWrites[1].dstSet = descriptorSet;
+  descriptorWrites[1].dstSet = set;
   descriptorWrites[1].dstBinding = 1;
   descriptorWrites[1].dstArrayElement = 0;
   descriptorWrites[1].descriptorType =
@@ -68,4 +164,7 @@ Mesh::createDescriptorSet(VkDescriptorPool descriptorPool,
                          descriptorWrites.data(),
                          0,
                          nullptr);
+
+  writtenVersions[frameIndex].diffuse = diffuseTexture->getVersion();
+  writtenVersions[frameIndex].specular = specularTexture->getVersion();
 }
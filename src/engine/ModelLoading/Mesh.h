@@ -4,16 +4,52 @@
 #include "engine/ModelLoading/Texture.h"
 #include "engine/VulkanContext.h"
 
+#include <glm.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+// pixels the simplification error of a level of detail may cover on screen
+#ifndef LOD_PIXEL_ERROR
+#define LOD_PIXEL_ERROR 1.0f
+#endif
+// shadow maps are low res and blurred, they get away with coarser levels
+#ifndef LOD_SHADOW_BIAS
+#define LOD_SHADOW_BIAS 4.0f
+#endif
+
 struct Vertex;
 
+struct MeshLod
+{
+  // absolute positions in the GeometryArena, like vertexOffset
+  uint32_t startIndex;
+  uint32_t indexCount;
+  // how far this level is off from the full mesh, in model units
+  float error;
+};
+
+// what a pass picks levels of detail with, the Scene fills one per pass kind
+// every frame
+struct LodSelector
+{
+  glm::vec3 eye;
+  // screen pixels one world unit covers at a distance of one
+  float projectionScale;
+  float maxPixelError;
+};
+
 class Mesh
 {
 public:
   Mesh(VulkanContext* vkContext,
-       size_t indexCount,
-       size_t startIndex,
-       Texture&& diffuseTexture,
-       Texture&& specularTexture);
+       std::vector<MeshLod> lods,
+       const glm::vec4& bounds,
+       const glm::vec3& aabbMin,
+       const glm::vec3& aabbMax,
+       std::shared_ptr<Texture> diffuseTexture,
+       std::shared_ptr<Texture> specularTexture);
 
   ~Mesh();
 
@@ -24,19 +60,63 @@ public:
   Mesh& operator=(Mesh&&) noexcept = default;
 
   // probably embed this into a Material object and add normal mapping and other
-  // fancy textures.
-  Texture diffuseTexture;
-  Texture specularTexture;
+  // fancy textures. shared through the TextureCache, never null
+  std::shared_ptr<Texture> diffuseTexture;
+  std::shared_ptr<Texture> specularTexture;
 
+  // one set per frame in flight, the pool needs room for all of them
   void createDescriptorSet(VkDescriptorPool descriptorPool,
                            VkDescriptorSetLayout descriptorLayout);
 
-  VkDescriptorSet descriptorSet;
-  size_t indexCount;
-  size_t startIndex;
+  // called once the fence of frameIndex has been waited on. marks streamed
+  // textures as used, points the set of that frame at whatever view they're
+  // bound as now and makes it the current descriptorSet
+  void prepareFrame(uint32_t frameIndex);
+
+  // the set of the frame being recorded
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+  // the bindless slots of the textures, diffuse in the low 16 bits and
+  // specular in the high ones. the instances of this mesh pass it to the
+  // shaders. NO_MATERIAL without BindlessTextures or when its array was full,
+  // the mesh is drawn with the sets above then. those are written either way
+  // for the passes that bind them
+  static const uint32_t NO_MATERIAL = UINT32_MAX;
+  uint32_t material = NO_MATERIAL;
+
+  // unique for every mesh, the draw lists sort on it when the textures are
+  // bound per mesh
+  uint32_t id;
+
+  // the coarsest level whose error stays under selector.maxPixelError on
+  // screen, for an instance drawn with transformation
+  const MeshLod& selectLod(const glm::mat4& transformation,
+                           const LodSelector& selector) const;
+
+  // never empty, lods[0] is the full mesh and every level after it is
+  // coarser. pass startIndex, indexCount and vertexOffset straight to
+  // vkCmdDrawIndexed
+  std::vector<MeshLod> lods;
+  int32_t vertexOffset = 0;
+  // bounding sphere in model space, center in xyz and radius in w
+  glm::vec4 bounds;
+  // bounding box in model space
+  glm::vec3 aabbMin;
+  glm::vec3 aabbMax;
 
 private:
   VulkanContext* vkContext;
+
+  std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+  // texture versions each set was last written with
+  struct WrittenVersions
+  {
+    uint32_t diffuse = 0;
+    uint32_t specular = 0;
+  };
+  std::array<WrittenVersions, MAX_FRAMES_IN_FLIGHT> writtenVersions{};
+
+  void writeDescriptorSet(uint32_t frameIndex);
 };
 
 #endif
@@ -0,0 +1,362 @@
+#include "engine/ModelLoading/MeshOptimizer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+// how much worse the acmr may get in exchange for less overdraw
+static const float OVERDRAW_THRESHOLD = 1.05f;
+
+// -------------------- STATS --------------------
+float
+VertexCacheStats::getAcmr() const
+{
+  return triangles == 0 ? 0.0f : float(transformed) / float(triangles);
+}
+
+float
+VertexCacheStats::getAtvr() const
+{
+  return vertices == 0 ? 0.0f : float(transformed) / float(vertices);
+}
+
+void
+VertexCacheStats::add(const VertexCacheStats& other)
+{
+  triangles += other.triangles;
+  vertices += other.vertices;
+  transformed += other.transformed;
+}
+
+void
+MeshOptimizationStats::add(const MeshOptimizationStats& other)
+{
+  before.add(other.before);
+  after.add(other.after);
+  weldedVertices += other.weldedVertices;
+  overdrawSkipped += other.overdrawSkipped;
+}
+
+VertexCacheStats
+analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+  VertexCacheStats stats;
+  stats.triangles = indices.size() / 3;
+
+  // a vertex is in the fifo if it went in less than VERTEX_CACHE_SIZE misses
+  // ago, hits don't move it
+  std::vector<uint64_t> insertedAt(vertexCount, 0);
+  std::vector<bool> referenced(vertexCount, false);
+  uint64_t misses = VERTEX_CACHE_SIZE;
+
+  for (uint32_t index : indices) {
+    if (!referenced[index]) {
+      referenced[index] = true;
+      stats.vertices++;
+    }
+
+    if (misses - insertedAt[index] >= VERTEX_CACHE_SIZE) {
+      insertedAt[index] = misses;
+      misses++;
+      stats.transformed++;
+    }
+  }
+  return stats;
+}
+
+// -------------------- WELDING --------------------
+namespace {
+
+struct VertexHash
+{
+  size_t operator()(const Vertex& vertex) const
+  {
+    // 64 bit FNV-1a over the raw bytes, Vertex has no padding
+    const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(&vertex);
+    uint64_t result = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(Vertex); i++) {
+      result ^= bytes[i];
+      result *= 1099511628211ull;
+    }
+    return static_cast<size_t>(result);
+  }
+};
+
+struct VertexEqual
+{
+  bool operator()(const Vertex& a, const Vertex& b) const
+  {
+    return memcmp(&a, &b, sizeof(Vertex)) == 0;
+  }
+};
+
+} // namespace
+
+size_t
+weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+  std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> unique;
+  unique.reserve(vertices.size());
+
+  std::vector<uint32_t> remap(vertices.size());
+  size_t welded = 0;
+  for (uint32_t i = 0; i < vertices.size(); i++) {
+    auto result = unique.emplace(vertices[i], i);
+    remap[i] = result.first->second;
+    if (!result.second) {
+      welded++;
+    }
+  }
+
+  for (uint32_t& index : indices) {
+    index = remap[index];
+  }
+  return welded;
+}
+
+// -------------------- VERTEX CACHE --------------------
+void
+optimizeVertexCache(std::vector<uint32_t>& indices,
+                    size_t vertexCount,
+                    std::vector<uint32_t>& clusterStarts)
+{
+  clusterStarts.clear();
+
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // triangles not emitted yet for every vertex, and the triangles around
+  // every vertex packed one after the other
+  std::vector<uint32_t> live(vertexCount, 0);
+  for (uint32_t index : indices) {
+    live[index]++;
+  }
+
+  std::vector<uint32_t> offsets(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++) {
+    offsets[v + 1] = offsets[v] + live[v];
+  }
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    for (int c = 0; c < 3; c++) {
+      adjacency[fill[indices[t * 3 + c]]++] = t;
+    }
+  }
+
+  const int64_t cacheSize = VERTEX_CACHE_SIZE;
+  std::vector<int64_t> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> deadEnd;
+  deadEnd.reserve(indices.size());
+  std::vector<uint32_t> candidates;
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+
+  int64_t time = cacheSize + 1;
+  size_t cursor = 0;
+  int64_t fanning = indices[0];
+  bool newCluster = true;
+
+  while (fanning >= 0) {
+    if (newCluster) {
+      clusterStarts.push_back(static_cast<uint32_t>(result.size() / 3));
+      newCluster = false;
+    }
+
+    // emit everything around the fanning vertex
+    candidates.clear();
+    for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; k++) {
+      uint32_t t = adjacency[k];
+      if (emitted[t]) {
+        continue;
+      }
+
+      for (int c = 0; c < 3; c++) {
+        uint32_t v = indices[t * 3 + c];
+        result.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - cacheTime[v] > cacheSize) {
+          cacheTime[v] = time;
+          time++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    // next is the candidate that has been in the cache the longest and will
+    // still be there once its own triangles are emitted
+    int64_t next = -1;
+    int64_t bestPriority = -1;
+    for (uint32_t v : candidates) {
+      if (live[v] == 0) {
+        continue;
+      }
+
+      int64_t priority = 0;
+      if (time - cacheTime[v] + 2 * int64_t(live[v]) <= cacheSize) {
+        priority = time - cacheTime[v];
+      }
+      if (priority > bestPriority) {
+        next = v;
+        bestPriority = priority;
+      }
+    }
+
+    // dead end, go back to a recently used vertex or failing that anything
+    // with triangles left. either way the cache is mostly cold from here on
+    if (next < 0) {
+      while (!deadEnd.empty() && next < 0) {
+        uint32_t v = deadEnd.back();
+        deadEnd.pop_back();
+        if (live[v] > 0) {
+          next = v;
+        }
+      }
+      while (cursor < vertexCount && next < 0) {
+        if (live[cursor] > 0) {
+          next = static_cast<int64_t>(cursor);
+        }
+        cursor++;
+      }
+      newCluster = true;
+    }
+
+    fanning = next;
+  }
+
+  indices.swap(result);
+}
+
+// -------------------- OVERDRAW --------------------
+bool
+optimizeOverdraw(std::vector<uint32_t>& indices,
+                 const std::vector<Vertex>& vertices,
+                 const std::vector<uint32_t>& clusterStarts,
+                 float threshold)
+{
+  uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+  if (clusterStarts.size() < 2) {
+    return true;
+  }
+
+  glm::vec3 meshCenter(0.0f);
+  for (uint32_t index : indices) {
+    meshCenter += vertices[index].position;
+  }
+  meshCenter /= float(indices.size());
+
+  struct Cluster
+  {
+    uint32_t begin;
+    uint32_t end;
+    float sortKey;
+  };
+  std::vector<Cluster> clusters(clusterStarts.size());
+
+  for (size_t c = 0; c < clusters.size(); c++) {
+    Cluster& cluster = clusters[c];
+    cluster.begin = clusterStarts[c];
+    cluster.end =
+      c + 1 < clusters.size() ? clusterStarts[c + 1] : triangleCount;
+
+    // area weighted center, the vertex normals give the facing since the
+    // winding was flipped along with y on import
+    glm::vec3 center(0.0f);
+    glm::vec3 normal(0.0f);
+    float area = 0.0f;
+    for (uint32_t t = cluster.begin; t < cluster.end; t++) {
+      const Vertex& v0 = vertices[indices[t * 3 + 0]];
+      const Vertex& v1 = vertices[indices[t * 3 + 1]];
+      const Vertex& v2 = vertices[indices[t * 3 + 2]];
+
+      float triangleArea = glm::length(glm::cross(
+        v1.position - v0.position, v2.position - v0.position));
+      center += (v0.position + v1.position + v2.position) / 3.0f * triangleArea;
+      normal += v0.normals + v1.normals + v2.normals;
+      area += triangleArea;
+    }
+
+    cluster.sortKey = 0.0f;
+    float normalLength = glm::length(normal);
+    if (area > 0.0f && normalLength > 0.0f) {
+      cluster.sortKey =
+        glm::dot(center / area - meshCenter, normal / normalLength);
+    }
+  }
+
+  // the clusters facing out of the mesh the most go first, they're the ones
+  // most likely to cover the others
+  std::stable_sort(clusters.begin(),
+                   clusters.end(),
+                   [](const Cluster& a, const Cluster& b) {
+                     return a.sortKey > b.sortKey;
+                   });
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (const Cluster& cluster : clusters) {
+    result.insert(result.end(),
+                  indices.begin() + cluster.begin * 3,
+                  indices.begin() + cluster.end * 3);
+  }
+
+  uint64_t original = analyzeVertexCache(indices, vertices.size()).transformed;
+  uint64_t sorted = analyzeVertexCache(result, vertices.size()).transformed;
+  if (float(sorted) > float(original) * threshold) {
+    return false;
+  }
+
+  indices.swap(result);
+  return true;
+}
+
+// -------------------- VERTEX FETCH --------------------
+void
+optimizeVertexFetch(std::vector<Vertex>& vertices,
+                    std::vector<uint32_t>& indices)
+{
+  const uint32_t unused = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> remap(vertices.size(), unused);
+
+  std::vector<Vertex> result;
+  result.reserve(vertices.size());
+  for (uint32_t& index : indices) {
+    if (remap[index] == unused) {
+      remap[index] = static_cast<uint32_t>(result.size());
+      result.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  vertices.swap(result);
+}
+
+MeshOptimizationStats
+optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+  MeshOptimizationStats stats;
+  stats.before = analyzeVertexCache(indices, vertices.size());
+
+  stats.weldedVertices = weldVertices(vertices, indices);
+
+  std::vector<uint32_t> clusterStarts;
+  optimizeVertexCache(indices, vertices.size(), clusterStarts);
+  if (!optimizeOverdraw(
+        indices, vertices, clusterStarts, OVERDRAW_THRESHOLD)) {
+    stats.overdrawSkipped++;
+  }
+
+  optimizeVertexFetch(vertices, indices);
+
+  stats.after = analyzeVertexCache(indices, vertices.size());
+  return stats;
+}
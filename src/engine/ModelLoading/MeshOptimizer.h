@@ -0,0 +1,82 @@
+#ifndef _MESH_OPTIMIZER_H_
+#define _MESH_OPTIMIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "engine/Vertex.h"
+
+// import time reordering of a mesh for the gpu, so every pass that draws it
+// (shadow atlas, main pass) runs the vertex shader fewer times. none of it
+// changes what gets drawn, only the order.
+
+// entries of the simulated post-transform cache. real hardware isn't a plain
+// fifo anymore, but the numbers still track what the gpu does well enough
+#define VERTEX_CACHE_SIZE 16
+
+// how well an index buffer uses the post-transform cache
+struct VertexCacheStats
+{
+  uint64_t triangles = 0;
+  // vertices referenced by at least one triangle
+  uint64_t vertices = 0;
+  // vertex shader invocations with a VERTEX_CACHE_SIZE fifo
+  uint64_t transformed = 0;
+
+  // average cache miss ratio, transformed vertices per triangle. 3 is the
+  // worst case, ~0.5-0.7 is what a well ordered grid gets
+  float getAcmr() const;
+  // average transform to vertex ratio, 1 is every vertex shaded only once
+  float getAtvr() const;
+
+  void add(const VertexCacheStats& other);
+};
+
+struct MeshOptimizationStats
+{
+  VertexCacheStats before;
+  VertexCacheStats after;
+  // duplicate vertices merged by weldVertices
+  uint64_t weldedVertices = 0;
+  // meshes whose overdraw ordering cost too much cache locality and kept the
+  // plain vertex cache order
+  uint64_t overdrawSkipped = 0;
+
+  void add(const MeshOptimizationStats& other);
+};
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices,
+                                    size_t vertexCount);
+
+// merges vertices that are bitwise identical, returns how many were removed.
+// the vertices left unreferenced are dropped by optimizeVertexFetch
+size_t weldVertices(std::vector<Vertex>& vertices,
+                    std::vector<uint32_t>& indices);
+
+// tipsify (Sander et al. 2007): walks the mesh fanning around the most
+// recently used vertex. fills clusterStarts with the first triangle of every
+// run that had to jump somewhere the cache knew nothing about
+void optimizeVertexCache(std::vector<uint32_t>& indices,
+                         size_t vertexCount,
+                         std::vector<uint32_t>& clusterStarts);
+
+// sorts the clusters so the ones facing away from the middle of the mesh are
+// drawn first and occlude the rest. keeps the order it was given when that
+// makes the acmr worse by more than threshold (1.05 allows 5%). returns false
+// in that case
+bool optimizeOverdraw(std::vector<uint32_t>& indices,
+                      const std::vector<Vertex>& vertices,
+                      const std::vector<uint32_t>& clusterStarts,
+                      float threshold);
+
+// renumbers the vertices in the order the index buffer first uses them, so
+// vertex fetch walks memory linearly. unreferenced vertices are dropped
+void optimizeVertexFetch(std::vector<Vertex>& vertices,
+                         std::vector<uint32_t>& indices);
+
+// all of the above, in order. indices are local to vertices
+MeshOptimizationStats optimizeMesh(std::vector<Vertex>& vertices,
+                                   std::vector<uint32_t>& indices);
+
+#endif
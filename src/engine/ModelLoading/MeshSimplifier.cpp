@@ -0,0 +1,290 @@
+#include "engine/ModelLoading/MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// sum of squared distances to a set of planes, weighted by triangle area
+struct Quadric
+{
+  double a2 = 0, b2 = 0, c2 = 0;
+  double ab = 0, ac = 0, bc = 0;
+  double ad = 0, bd = 0, cd = 0;
+  double d2 = 0;
+  double weight = 0;
+
+  void addPlane(const glm::dvec3& n, double d, double w)
+  {
+    a2 += w * n.x * n.x;
+    b2 += w * n.y * n.y;
+    c2 += w * n.z * n.z;
+    ab += w * n.x * n.y;
+    ac += w * n.x * n.z;
+    bc += w * n.y * n.z;
+    ad += w * n.x * d;
+    bd += w * n.y * d;
+    cd += w * n.z * d;
+    d2 += w * d * d;
+    weight += w;
+  }
+
+  void add(const Quadric& other)
+  {
+    a2 += other.a2;
+    b2 += other.b2;
+    c2 += other.c2;
+    ab += other.ab;
+    ac += other.ac;
+    bc += other.bc;
+    ad += other.ad;
+    bd += other.bd;
+    cd += other.cd;
+    d2 += other.d2;
+    weight += other.weight;
+  }
+
+  // mean squared distance of p to the planes
+  double evaluate(const glm::vec3& p) const
+  {
+    double x = p.x, y = p.y, z = p.z;
+    double result = a2 * x * x + b2 * y * y + c2 * z * z +
+                    2 * (ab * x * y + ac * x * z + bc * y * z) +
+                    2 * (ad * x + bd * y + cd * z) + d2;
+    return weight > 0 ? std::fabs(result) / weight : 0;
+  }
+};
+
+struct Collapse
+{
+  uint32_t from;
+  uint32_t to;
+  double cost;
+};
+
+struct PositionHash
+{
+  size_t operator()(const glm::vec3& p) const
+  {
+    uint32_t bits[3];
+    memcpy(bits, &p, sizeof(bits));
+    return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^
+           (bits[2] * 83492791u);
+  }
+};
+
+uint64_t
+edgeKey(uint32_t a, uint32_t b)
+{
+  if (a > b) {
+    std::swap(a, b);
+  }
+  return (uint64_t(a) << 32) | b;
+}
+
+} // namespace
+
+void
+simplifyMesh(const std::vector<Vertex>& vertices,
+             std::vector<uint32_t>& indices,
+             size_t targetIndexCount,
+             float maxError,
+             float& error)
+{
+  error = 0.0f;
+  size_t vertexCount = vertices.size();
+
+  // -------------------- LOCKED VERTICES --------------------
+  // vertices sharing a position are the two sides of a seam, and the edges
+  // are found by position so a seam doesn't look like a border
+  std::vector<bool> locked(vertexCount, false);
+  std::vector<uint32_t> positionIds(vertexCount);
+  {
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> positions;
+    positions.reserve(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      auto result = positions.emplace(vertices[v].position, v);
+      positionIds[v] = result.first->second;
+      if (!result.second) {
+        locked[v] = true;
+        locked[result.first->second] = true;
+      }
+    }
+  }
+
+  {
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    edgeUses.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (int c = 0; c < 3; c++) {
+        uint32_t a = positionIds[indices[i + c]];
+        uint32_t b = positionIds[indices[i + (c + 1) % 3]];
+        edgeUses[edgeKey(a, b)]++;
+      }
+    }
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (int c = 0; c < 3; c++) {
+        uint32_t a = indices[i + c];
+        uint32_t b = indices[i + (c + 1) % 3];
+        if (edgeUses[edgeKey(positionIds[a], positionIds[b])] == 1) {
+          locked[a] = true;
+          locked[b] = true;
+        }
+      }
+    }
+  }
+
+  // -------------------- QUADRICS --------------------
+  std::vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    glm::dvec3 p0 = vertices[indices[i + 0]].position;
+    glm::dvec3 p1 = vertices[indices[i + 1]].position;
+    glm::dvec3 p2 = vertices[indices[i + 2]].position;
+
+    glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+    double area = glm::length(normal);
+    if (area <= 0) {
+      continue;
+    }
+    normal /= area;
+
+    Quadric quadric;
+    quadric.addPlane(normal, -glm::dot(normal, p0), area);
+    for (int c = 0; c < 3; c++) {
+      quadrics[indices[i + c]].add(quadric);
+    }
+  }
+
+  // -------------------- COLLAPSES --------------------
+  // every pass collapses a batch of independent edges, no vertex is touched
+  // twice in one pass so the costs stay valid until the next one
+  double maxCost = double(maxError) * double(maxError);
+  std::vector<Collapse> collapses;
+  std::vector<bool> touched(vertexCount);
+  std::vector<uint32_t> collapseTo(vertexCount);
+  std::vector<uint32_t> offsets(vertexCount + 1);
+  std::vector<uint32_t> adjacency;
+
+  while (indices.size() > targetIndexCount) {
+    collapses.clear();
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (int c = 0; c < 3; c++) {
+        uint32_t a = indices[i + c];
+        uint32_t b = indices[i + (c + 1) % 3];
+        if (!locked[a]) {
+          Quadric quadric = quadrics[a];
+          quadric.add(quadrics[b]);
+          double cost = quadric.evaluate(vertices[b].position);
+          collapses.push_back({ a, b, cost });
+        }
+        if (!locked[b]) {
+          Quadric quadric = quadrics[b];
+          quadric.add(quadrics[a]);
+          double cost = quadric.evaluate(vertices[a].position);
+          collapses.push_back({ b, a, cost });
+        }
+      }
+    }
+    std::sort(collapses.begin(),
+              collapses.end(),
+              [](const Collapse& a, const Collapse& b) {
+                return a.cost < b.cost;
+              });
+
+    // triangles around every vertex, for the flip check
+    std::fill(offsets.begin(), offsets.end(), 0);
+    for (uint32_t index : indices) {
+      offsets[index + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+      offsets[v + 1] += offsets[v];
+    }
+    adjacency.resize(indices.size());
+    {
+      std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+      for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+      }
+    }
+
+    std::fill(touched.begin(), touched.end(), false);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      collapseTo[v] = v;
+    }
+
+    // each collapse takes out about two triangles
+    size_t remaining = indices.size();
+    size_t collapsed = 0;
+    for (const Collapse& collapse : collapses) {
+      if (collapse.cost > maxCost || remaining <= targetIndexCount) {
+        break;
+      }
+      if (touched[collapse.from] || touched[collapse.to]) {
+        continue;
+      }
+
+      // moving from onto to must not turn any of its other triangles around
+      bool flips = false;
+      const glm::vec3& target = vertices[collapse.to].position;
+      for (uint32_t k = offsets[collapse.from];
+           k < offsets[collapse.from + 1] && !flips;
+           k++) {
+        uint32_t t = adjacency[k];
+        uint32_t v[3];
+        for (int c = 0; c < 3; c++) {
+          v[c] = collapseTo[indices[t * 3 + c]];
+        }
+        // the ones on the collapsed edge go away
+        if (v[0] == collapse.to || v[1] == collapse.to ||
+            v[2] == collapse.to) {
+          continue;
+        }
+
+        glm::vec3 p[3];
+        glm::vec3 moved[3];
+        for (int c = 0; c < 3; c++) {
+          p[c] = vertices[v[c]].position;
+          moved[c] = v[c] == collapse.from ? target : p[c];
+        }
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 after =
+          glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+        flips = glm::dot(before, after) <= 0.0f;
+      }
+      if (flips) {
+        continue;
+      }
+
+      collapseTo[collapse.from] = collapse.to;
+      touched[collapse.from] = true;
+      touched[collapse.to] = true;
+      quadrics[collapse.to].add(quadrics[collapse.from]);
+      error = std::max(error, float(std::sqrt(collapse.cost)));
+
+      remaining = remaining > 6 ? remaining - 6 : 0;
+      collapsed++;
+    }
+
+    if (collapsed == 0) {
+      break;
+    }
+
+    // apply and drop the triangles that lost an edge
+    size_t write = 0;
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      uint32_t a = collapseTo[indices[i + 0]];
+      uint32_t b = collapseTo[indices[i + 1]];
+      uint32_t c = collapseTo[indices[i + 2]];
+      if (a == b || b == c || a == c) {
+        continue;
+      }
+      indices[write++] = a;
+      indices[write++] = b;
+      indices[write++] = c;
+    }
+    indices.resize(write);
+  }
+}
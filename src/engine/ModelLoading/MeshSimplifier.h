@@ -0,0 +1,27 @@
+#ifndef _MESH_SIMPLIFIER_H_
+#define _MESH_SIMPLIFIER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "engine/Vertex.h"
+
+// quadric error edge collapse (Garland & Heckbert) that only ever moves a
+// vertex onto one of its neighbours, so every level of detail indexes into
+// the same vertex buffer as the full mesh.
+//
+// vertices on an open border or on an attribute seam (same position, different
+// normal or uv) never move, that keeps the silhouette and the uv layout from
+// tearing. a mesh that's all seams, like a flat shaded cube, doesn't simplify.
+
+// collapses edges, cheapest first, until the index count is at most
+// targetIndexCount or the next collapse would move the surface by more than
+// maxError (in model units). error gets the largest deviation it did cause
+void simplifyMesh(const std::vector<Vertex>& vertices,
+                  std::vector<uint32_t>& indices,
+                  size_t targetIndexCount,
+                  float maxError,
+                  float& error);
+
+#endif
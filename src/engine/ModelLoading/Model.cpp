@@ -1,9 +1,10 @@
 #include "engine/ModelLoading/Model.h"
+#include "engine/KtxLoader.h"
 #include "engine/ModelLoading/Mesh.h"
+#include "engine/ModelLoading/TextureCache.h"
 #include "engine/Vertex.h"
 
-#include <assimp/postprocess.h>
-#include <iostream>
+#include <stdexcept>
 
 VkDescriptorSetLayout Model::textureLayout = VK_NULL_HANDLE;
 
@@ -13,6 +14,21 @@ Model::Model(const std::string& filePath,
              glm::vec3 rotationAxis,
              float rotationAngle,
              glm::vec3 scale)
+  : Model(*loadSource(filePath),
+          vkContext,
+          pos,
+          rotationAxis,
+          rotationAngle,
+          scale)
+{
+}
+
+Model::Model(const ModelSource& source,
+             VulkanContext* vkContext,
+             glm::vec3 pos,
+             glm::vec3 rotationAxis,
+             float rotationAngle,
+             glm::vec3 scale)
   : vkContext(vkContext)
 {
   modelMatrix = glm::translate(modelMatrix, pos);
@@ -22,22 +38,9 @@ Model::Model(const std::string& filePath,
   }
   modelMatrix = glm::scale(modelMatrix, scale);
 
-  loadModel(filePath);
-
-  createVertexBuffer(sizeof(vertices[0]) * vertices.size());
-  createIndexBuffer(sizeof(indices[0]) * indices.size());
+  createFromSource(source);
 
   setupDescriptors();
-
-  // clean the vectors by destroying their contents and releasing the memory of
-  // the vector itself
-  vertices.clear();
-  std::vector<Vertex> tmpVertices = std::vector<Vertex>();
-  vertices.swap(tmpVertices);
-
-  indices.clear();
-  std::vector<uint32_t> tmpIndices = std::vector<uint32_t>();
-  indices.swap(tmpIndices);
 }
 
 Model::~Model()
@@ -50,27 +53,12 @@ Model::Model(Model&& other) noexcept
   modelMatrix = other.modelMatrix;
   meshInstances = std::move(other.meshInstances);
   uniqueMeshes = std::move(other.uniqueMeshes);
-
-  vertices = std::move(other.vertices);
-  vertexBuffer = other.vertexBuffer;
-  vertexBufferAllocation = other.vertexBufferAllocation;
-  vertexBufferMemory = other.vertexBufferMemory;
-
-  indices = std::move(other.indices);
-  indexBuffer = other.indexBuffer;
-  indexBufferAllocation = other.indexBufferAllocation;
-  indexBufferMemory = other.indexBufferMemory;
+  geometry = other.geometry;
 
   vkContext = other.vkContext;
   descriptorPool = other.descriptorPool;
 
-  other.vertexBuffer = VK_NULL_HANDLE;
-  other.vertexBufferAllocation = VK_NULL_HANDLE;
-  other.vertexBufferMemory = VK_NULL_HANDLE;
-
-  other.indexBuffer = VK_NULL_HANDLE;
-  other.indexBufferAllocation = VK_NULL_HANDLE;
-  other.indexBufferMemory = VK_NULL_HANDLE;
+  other.geometry = GeometryAllocation();
 
   other.vkContext = nullptr;
 }
@@ -84,18 +72,12 @@ Model::operator=(Model&& other) noexcept
     modelMatrix = other.modelMatrix;
     meshInstances = std::move(other.meshInstances);
     uniqueMeshes = std::move(other.uniqueMeshes);
-
-    vertices = std::move(other.vertices);
-    vertexBuffer = other.vertexBuffer;
-    vertexBufferAllocation = other.vertexBufferAllocation;
-    vertexBufferMemory = other.vertexBufferMemory;
-
-    indices = std::move(other.indices);
-    indexBuffer = other.indexBuffer;
-    indexBufferAllocation = other.indexBufferAllocation;
-    indexBufferMemory = other.indexBufferMemory;
+    geometry = other.geometry;
 
     vkContext = other.vkContext;
+    descriptorPool = other.descriptorPool;
+
+    other.geometry = GeometryAllocation();
   }
   return *this;
 }
@@ -105,9 +87,27 @@ Model::applyTransform(const glm::mat4& transform)
 {
   for (auto& instance : meshInstances) {
     instance.transformation = instance.transformation * transform;
+    instance.updateBounds();
   }
 }
 
+void
+MeshInstance::updateBounds()
+{
+  // the box of the transformed box: the center moves with the matrix, every
+  // world axis gets the absolute contribution of each local extent
+  glm::vec3 center = (mesh->aabbMin + mesh->aabbMax) * 0.5f;
+  glm::vec3 extent = (mesh->aabbMax - mesh->aabbMin) * 0.5f;
+
+  glm::vec3 worldCenter = glm::vec3(transformation * glm::vec4(center, 1.0f));
+  glm::vec3 worldExtent = glm::abs(glm::vec3(transformation[0])) * extent.x +
+                          glm::abs(glm::vec3(transformation[1])) * extent.y +
+                          glm::abs(glm::vec3(transformation[2])) * extent.z;
+
+  worldMin = worldCenter - worldExtent;
+  worldMax = worldCenter + worldExtent;
+}
+
 void
 Model::rotate(float angle, glm::vec3 rotationAxis)
 {
@@ -117,200 +117,131 @@ Model::rotate(float angle, glm::vec3 rotationAxis)
 }
 
 void
-Model::loadModel(const std::string& filePath)
+Model::prepareFrame(uint32_t frameIndex)
 {
-  Assimp::Importer importer;
-  unsigned int processFlags =
-    aiProcess_FlipUVs |
-    aiProcess_Triangulate | // Ensure all verticies are triangulated (each 3
-                            // vertices are triangle)
-    aiProcess_GenUVCoords;  // convert spherical, cylindrical, box and planar
-                            // mapping to proper UVs
-
-  const aiScene* scene = importer.ReadFile(filePath, processFlags);
-
-  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-      !scene->mRootNode) {
-    std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-    return;
+  for (const auto& uniqueMesh : uniqueMeshes) {
+    uniqueMesh->prepareFrame(frameIndex);
   }
+}
 
-  // preallocate vertices and indices vectors
-  unsigned int totalNumVertices = 0;
-  unsigned int totalNumIndices = 0;
-  for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-    totalNumVertices += scene->mMeshes[i]->mNumVertices;
-    totalNumIndices += scene->mMeshes[i]->mNumFaces *
-                       3; // <== i assume every face has three vertices because
-                          // of the TRIANGULATE option
+std::shared_ptr<ModelSource>
+Model::loadSource(const std::string& filePath, bool decodeTextures)
+{
+  auto source = std::make_shared<ModelSource>();
+
+  // the bake is used straight from the mapping, the geometry is copied into
+  // staging memory without going through assimp or any intermediate vector
+  if (source->baked.open(getBakedModelPath(filePath), filePath)) {
+    source->view = source->baked.view();
+  } else {
+    if (!importModel(filePath, source->data)) {
+      throw std::runtime_error("failed to load model! " + filePath);
+    }
+    source->view = source->data.view();
   }
 
-  meshInstances.reserve(scene->mNumMeshes);
-  indices.reserve(totalNumIndices);
-  vertices.reserve(totalNumVertices);
-
-  size_t startIndex = 0;
-  size_t startVertex = 0;
+  const ModelView& model = source->view;
+  source->images.resize(model.textureCount);
+  if (!decodeTextures) {
+    return source;
+  }
 
-  processNode(scene->mRootNode, scene, startIndex, startVertex);
-}
+  for (uint32_t i = 0; i < model.textureCount; i++) {
+    const BakedTexture& bakedTexture = model.textures[i];
+    const unsigned char* bytes = model.data + bakedTexture.offset;
 
-void
-Model::processNode(aiNode* node,
-                   const aiScene* scene,
-                   size_t& startIndex,
-                   size_t& startVertex)
-{
-  glm::mat4 nodeTransform =
-    modelMatrix * AssimpToGlmMatrix(node->mTransformation);
-
-  for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-    aiMesh* assimpMesh = scene->mMeshes[node->mMeshes[i]];
-    Mesh* mesh;
-
-    auto it = uniqueMeshes.find(assimpMesh);
-    if (it == uniqueMeshes.end()) {
-      auto newMesh = processMesh(assimpMesh, scene, startIndex, startVertex);
-      mesh = newMesh.get();
-      uniqueMeshes[assimpMesh] = std::move(newMesh);
-
-      startIndex += scene->mMeshes[node->mMeshes[i]]->mNumFaces * 3;
-      startVertex += assimpMesh->mNumVertices;
-    } else {
-      mesh = it->second.get();
+    if (bakedTexture.embedded) {
+      Texture::decode(bytes, bakedTexture.size, source->images[i]);
+      continue;
     }
 
-    meshInstances.push_back({ nodeTransform, mesh });
+    // a precompressed copy is read straight into staging memory later, no
+    // point in decoding the original
+    std::string path(reinterpret_cast<const char*>(bytes), bakedTexture.size);
+    if (!hasKtxCandidate(path)) {
+      Texture::decode(path, source->images[i]);
+    }
   }
 
-  for (unsigned int i = 0; i < node->mNumChildren; i++) {
-    processNode(node->mChildren[i], scene, startIndex, startVertex);
-  }
+  return source;
 }
 
-glm::mat4
-Model::AssimpToGlmMatrix(const aiMatrix4x4& from)
+void
+Model::createFromSource(const ModelSource& source)
 {
-  glm::mat4 to;
-  to[0][0] = from.a1;
-  to[1][0] = from.a2;
-  to[2][0] = from.a3;
-  to[3][0] = from.a4;
-  to[0][1] = from.b1;
-  to[1][1] = from.b2;
-  to[2][1] = from.b3;
-  to[3][1] = from.b4;
-  to[0][2] = from.c1;
-  to[1][2] = from.c2;
-  to[2][2] = from.c3;
-  to[3][2] = from.c4;
-  to[0][3] = from.d1;
-  to[1][3] = from.d2;
-  to[2][3] = from.d3;
-  to[3][3] = from.d4;
-  return to;
-}
+  const ModelView& model = source.view;
 
-std::unique_ptr<Mesh>
-Model::processMesh(aiMesh* mesh,
-                   const aiScene* scene,
-                   size_t& startIndex,
-                   size_t& startVertex)
-{
-  for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-    Vertex vertex;
-
-    // Position
-    glm::vec4 position = glm::vec4(
-      mesh->mVertices[i].x, -mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f);
-    vertex.position = glm::vec3(position);
-
-    // Normal
-    if (mesh->HasNormals()) {
-      glm::vec4 normal = glm::vec4(
-        mesh->mNormals[i].x, -mesh->mNormals[i].y, mesh->mNormals[i].z, 0.0f);
-      vertex.normals = glm::normalize(glm::vec3(normal));
+  uploadGeometry(model);
+
+  std::string path = TEXTURE_PATH;
+  uniqueMeshes.reserve(model.meshCount);
+  for (uint32_t i = 0; i < model.meshCount; i++) {
+    const BakedMesh& mesh = model.meshes[i];
+
+    if (mesh.lodCount == 0 || mesh.lodCount > MAX_MESH_LODS) {
+      throw std::runtime_error("model mesh has a bad level of detail count!");
     }
 
-    // Texture coordinates
-    if (mesh->HasTextureCoords(0)) {
-      vertex.texCoords.x = mesh->mTextureCoords[0][i].x;
-      vertex.texCoords.y = mesh->mTextureCoords[0][i].y;
-    } else {
-      vertex.texCoords = glm::vec2(0.0f, 0.0f);
+    // firstIndex is relative to the model, the arena decides where it starts
+    std::vector<MeshLod> lods;
+    for (uint32_t lod = 0; lod < mesh.lodCount; lod++) {
+      lods.push_back({ geometry.firstIndex + mesh.lods[lod].firstIndex,
+                       mesh.lods[lod].indexCount,
+                       mesh.lods[lod].error });
     }
 
-    vertices.push_back(vertex);
+    uniqueMeshes.push_back(std::make_unique<Mesh>(
+      vkContext,
+      std::move(lods),
+      mesh.bounds,
+      glm::vec3(mesh.aabbMin),
+      glm::vec3(mesh.aabbMax),
+      loadTexture(source, mesh.diffuseTexture, path + "empty_diffuse.png"),
+      loadTexture(source, mesh.specularTexture, path + "empty_specular.png")));
+    uniqueMeshes.back()->vertexOffset = geometry.vertexOffset;
   }
 
-  // If we do have textures
-  Texture diffuseTexture;
-  Texture specularTexture;
-  if (mesh->mMaterialIndex >= 0) {
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+  meshInstances.reserve(model.instanceCount);
+  for (uint32_t i = 0; i < model.instanceCount; i++) {
+    const BakedInstance& instance = model.instances[i];
+    if (instance.mesh >= uniqueMeshes.size()) {
+      throw std::runtime_error("model instance references a missing mesh!");
+    }
 
-    loadTexture(material, diffuseTexture, scene, aiTextureType_DIFFUSE);
-    loadTexture(material, specularTexture, scene, aiTextureType_SPECULAR);
-  }
-
-  std::string path = TEXTURE_PATH;
-  if (diffuseTexture.view == VK_NULL_HANDLE) {
-    diffuseTexture = Texture(vkContext, path + "empty_diffuse.png");
-  }
-  if (specularTexture.view == VK_NULL_HANDLE) {
-    specularTexture = Texture(vkContext, path + "empty_specular.png");
+    MeshInstance meshInstance;
+    meshInstance.transformation = modelMatrix * instance.transformation;
+    meshInstance.mesh = uniqueMeshes[instance.mesh].get();
+    meshInstance.updateBounds();
+    meshInstances.push_back(meshInstance);
   }
+}
 
-  auto newMesh = std::make_unique<Mesh>(vkContext,
-                                        mesh->mNumFaces * 3,
-                                        startIndex,
-                                        std::move(diffuseTexture),
-                                        std::move(specularTexture));
-
-  for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-    const aiFace& face = mesh->mFaces[i];
-    indices.push_back(face.mIndices[0] + startVertex);
-    indices.push_back(face.mIndices[1] + startVertex);
-    indices.push_back(face.mIndices[2] + startVertex);
+std::shared_ptr<Texture>
+Model::loadTexture(const ModelSource& source,
+                   int32_t texture,
+                   const std::string& fallback)
+{
+  const ModelView& model = source.view;
+  if (texture < 0 || static_cast<uint32_t>(texture) >= model.textureCount) {
+    return vkContext->textureCache->get(fallback);
   }
 
-  return newMesh;
-}
+  const BakedTexture& bakedTexture = model.textures[texture];
+  const unsigned char* bytes = model.data + bakedTexture.offset;
+  const ImageData* decoded =
+    texture >= 0 && static_cast<size_t>(texture) < source.images.size()
+      ? &source.images[texture]
+      : nullptr;
 
-void
-Model::loadTexture(aiMaterial* material,
-                   Texture& texture,
-                   const aiScene* scene,
-                   aiTextureType type)
-{
-  if (material->GetTextureCount(type) > 0) {
-    aiString str;
-    material->GetTexture(type, 0, &str);
-
-    if (str.C_Str()[0] == '*') {
-      // embedded texture
-      int texIndex = atoi(&str.C_Str()[1]);
-
-      aiTexture* aiTexture = scene->mTextures[texIndex];
-
-      // mHeight == 0 means the texture is compressed
-      if (aiTexture->mHeight == 0) {
-        // Compressed texture data
-        texture = Texture(vkContext,
-                          reinterpret_cast<unsigned char*>(aiTexture->pcData),
-                          aiTexture->mWidth);
-      } else {
-        // Uncompressed texture data
-        // size_t size = aiTexture->mWidth * aiTexture->mHeight * 4; // Assuming
-        // RGBA texture = Texture(vulkanDevice, reinterpret_cast<unsigned
-        // char*>(aiTexture->pcData), size, aiTexture->mWidth,
-        // aiTexture->mHeight);
-      }
-    } else {
-      // Load texture from file path
-      texture = Texture(vkContext, str.C_Str());
-    }
+  if (bakedTexture.embedded) {
+    // compressed image data
+    return vkContext->textureCache->get(bytes, bakedTexture.size, decoded);
   }
+
+  // Load texture from file path
+  return vkContext->textureCache->get(
+    std::string(reinterpret_cast<const char*>(bytes), bakedTexture.size),
+    decoded);
 }
 
 void
@@ -320,13 +251,14 @@ Model::setupDescriptors()
   VkDescriptorPoolSize poolSize;
 
   poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSize.descriptorCount = 2 * meshInstances.size();
+  // every mesh has a set per frame in flight, see Mesh::prepareFrame
+  poolSize.descriptorCount = 2 * uniqueMeshes.size() * MAX_FRAMES_IN_FLIGHT;
 
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
   poolInfo.poolSizeCount = 1;
   poolInfo.pPoolSizes = &poolSize;
-  poolInfo.maxSets = meshInstances.size();
+  poolInfo.maxSets = uniqueMeshes.size() * MAX_FRAMES_IN_FLIGHT;
 
   if (vkCreateDescriptorPool(
         vkContext->logicalDevice, &poolInfo, nullptr, &descriptorPool) !=
@@ -372,73 +304,24 @@ Model::setupDescriptors()
 
   // -------------------- DESCRIPTOR ALLOCATION --------------------
   for (const auto& uniqueMesh : uniqueMeshes) {
-    uniqueMesh.second->createDescriptorSet(descriptorPool,
-                                           Model::textureLayout);
+    uniqueMesh->createDescriptorSet(descriptorPool, Model::textureLayout);
   }
 }
 
 void
-Model::createVertexBuffer(VkDeviceSize bufferSize)
-{
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  VmaAllocation stagingBufferAllocation;
-  void* data = vkContext->createBuffer(bufferSize,
-                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                       BufferType::STAGING_BUFFER,
-                                       stagingBuffer,
-                                       stagingBufferAllocation);
-
-  memcpy(data, vertices.data(), (size_t)bufferSize);
-
-  vkContext->createBuffer(bufferSize,
-                          VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                          BufferType::GPU_BUFFER,
-                          vertexBuffer,
-                          vertexBufferAllocation);
-
-  vkContext->copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-  vmaDestroyBuffer(
-    vkContext->allocator, stagingBuffer, stagingBufferAllocation);
-}
-
-void
-Model::createIndexBuffer(VkDeviceSize bufferSize)
+Model::uploadGeometry(const ModelView& model)
 {
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  VmaAllocation stagingBufferAllocation;
-  void* data = vkContext->createBuffer(bufferSize,
-                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                       BufferType::STAGING_BUFFER,
-                                       stagingBuffer,
-                                       stagingBufferAllocation);
-
-  memcpy(data, indices.data(), (size_t)bufferSize);
-
-  vkContext->createBuffer(bufferSize,
-                          VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                          BufferType::GPU_BUFFER,
-                          indexBuffer,
-                          indexBufferAllocation);
-
-  vkContext->copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-  vmaDestroyBuffer(
-    vkContext->allocator, stagingBuffer, stagingBufferAllocation);
+  // indices stay relative to the model's first vertex, the arena's base vertex
+  // is applied at draw time
+  geometry = vkContext->geometryArena->allocate(
+    model.vertices, model.vertexCount, model.indices, model.indexCount);
 }
 
 void
 Model::cleanup()
 {
-  if (vertexBuffer != VK_NULL_HANDLE && indexBuffer != VK_NULL_HANDLE &&
-      descriptorPool != VK_NULL_HANDLE) {
-    vmaDestroyBuffer(
-      vkContext->allocator, vertexBuffer, vertexBufferAllocation);
-    vmaDestroyBuffer(vkContext->allocator, indexBuffer, indexBufferAllocation);
+  if (geometry.valid() && descriptorPool != VK_NULL_HANDLE) {
+    vkContext->geometryArena->free(geometry);
 
     vkDestroyDescriptorPool(vkContext->logicalDevice, descriptorPool, nullptr);
   }
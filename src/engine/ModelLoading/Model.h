@@ -1,25 +1,44 @@
 #ifndef _MODEL_H_
 #define _MODEL_H_
 
+#include "engine/GeometryArena.h"
 #include "engine/ModelLoading/Mesh.h"
+#include "engine/ModelLoading/ModelData.h"
 #include "engine/VulkanContext.h"
 
-#include <assimp/Importer.hpp>
-#include <assimp/material.h>
-#include <assimp/postprocess.h>
-#include <assimp/scene.h>
-
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 
 #include <memory>
-#include <unordered_map>
 #include <vector>
 
 struct MeshInstance
 {
   glm::mat4 transformation;
   Mesh* mesh;
+
+  // the box of mesh moved by transformation, the model keeps it up to date
+  // whenever it changes transformation
+  glm::vec3 worldMin;
+  glm::vec3 worldMax;
+
+  void updateBounds();
+};
+
+// everything a model reads from disk, with its textures already decoded.
+// filled by Model::loadSource() without touching vulkan, so it can be loaded
+// on a worker thread. any number of models can be created from one source.
+struct ModelSource
+{
+  BakedModel baked;
+  ModelData data;
+  // points into baked when the model has an up to date bake, into data
+  // otherwise
+  ModelView view;
+  // one per entry of view.textures, left empty for textures that have a .ktx,
+  // failed to decode or weren't asked for, those are loaded (or streamed)
+  // when the model is created
+  std::vector<ImageData> images;
 };
 
 class Model
@@ -31,6 +50,19 @@ public:
         glm::vec3 rotationAxis = glm::vec3(0),
         float rotationAngle = 0.0f,
         glm::vec3 scale = glm::vec3(1));
+  // only records the gpu uploads, must be called on the main thread
+  Model(const ModelSource& source,
+        VulkanContext* vulkanContext,
+        glm::vec3 pos = glm::vec3(0),
+        glm::vec3 rotationAxis = glm::vec3(0),
+        float rotationAngle = 0.0f,
+        glm::vec3 scale = glm::vec3(1));
+
+  // thread safe. prefers the .baked file next to filePath, imports with
+  // assimp otherwise, throws when neither can read it. without decodeTextures
+  // the images are left empty, for when the textures get streamed in anyway
+  static std::shared_ptr<ModelSource> loadSource(const std::string& filePath,
+                                                 bool decodeTextures = true);
 
   // find a way to copy this efficiently
   Model(const Model&) = delete;
@@ -47,14 +79,14 @@ public:
   void translate(glm::vec3 position);
   void scale(glm::vec3 scale);
 
-  std::unordered_map<aiMesh*, std::unique_ptr<Mesh>> uniqueMeshes;
-  std::vector<MeshInstance> meshInstances;
+  // see Mesh::prepareFrame
+  void prepareFrame(uint32_t frameIndex);
 
-  std::vector<Vertex> vertices;
-  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  std::vector<std::unique_ptr<Mesh>> uniqueMeshes;
+  std::vector<MeshInstance> meshInstances;
 
-  std::vector<uint32_t> indices;
-  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  // location of vertices and indices in vkContext->geometryArena
+  GeometryAllocation geometry;
 
   static VkDescriptorSetLayout textureLayout;
 
@@ -67,30 +99,12 @@ private:
   VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
   void setupDescriptors();
 
-  void loadModel(const std::string& filePath);
-  void processNode(aiNode* node,
-                   const aiScene* scene,
-                   size_t& startIndex,
-                   size_t& startVertex);
-  glm::mat4 AssimpToGlmMatrix(const aiMatrix4x4& from);
-  std::unique_ptr<Mesh> processMesh(aiMesh* mesh,
-                                    const aiScene* scene,
-                                    size_t& startIndex,
-                                    size_t& startVertex);
-  void loadTexture(aiMaterial* material,
-                   Texture& texture,
-                   const aiScene* scene,
-                   aiTextureType type);
-
-  unsigned int vertexCount;
-
-  VkDeviceMemory vertexBufferMemory;
-  VmaAllocation vertexBufferAllocation;
-  void createVertexBuffer(VkDeviceSize bufferSize);
-
-  VkDeviceMemory indexBufferMemory;
-  VmaAllocation indexBufferAllocation;
-  void createIndexBuffer(VkDeviceSize bufferSize);
+  void createFromSource(const ModelSource& source);
+  std::shared_ptr<Texture> loadTexture(const ModelSource& source,
+                                       int32_t texture,
+                                       const std::string& fallback);
+
+  void uploadGeometry(const ModelView& model);
 
   void cleanup();
 };
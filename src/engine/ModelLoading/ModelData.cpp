@@ -0,0 +1,536 @@
+#include "engine/ModelLoading/ModelData.h"
+#include "engine/ModelLoading/MeshSimplifier.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/material.h>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+// "VGDM" in little endian
+static const uint32_t BAKED_MODEL_MAGIC = 0x4D444756;
+
+// every level of detail aims for this fraction of the previous one's indices
+static const float LOD_REDUCTION = 0.5f;
+// a level that couldn't get below this fraction isn't worth keeping, the
+// chain stops there
+static const float LOD_MIN_REDUCTION = 0.85f;
+// how far a level may be off from the full mesh, relative to its radius
+static const float LOD_MAX_ERROR = 0.1f;
+
+// -------------------- IMPORT --------------------
+namespace {
+
+struct SceneConverter
+{
+  const aiScene* scene;
+  ModelData& data;
+
+  std::unordered_map<const aiMesh*, uint32_t> meshIndices;
+  std::unordered_map<std::string, int32_t> textureIndices;
+
+  MeshOptimizationStats stats;
+
+  void processNode(const aiNode* node);
+  uint32_t processMesh(const aiMesh* mesh);
+  void generateLods(const std::vector<Vertex>& vertices,
+                    std::vector<uint32_t>& indices,
+                    BakedMesh& bakedMesh);
+  int32_t processTexture(const aiMaterial* material, aiTextureType type);
+};
+
+glm::mat4
+AssimpToGlmMatrix(const aiMatrix4x4& from)
+{
+  glm::mat4 to;
+  to[0][0] = from.a1;
+  to[1][0] = from.a2;
+  to[2][0] = from.a3;
+  to[3][0] = from.a4;
+  to[0][1] = from.b1;
+  to[1][1] = from.b2;
+  to[2][1] = from.b3;
+  to[3][1] = from.b4;
+  to[0][2] = from.c1;
+  to[1][2] = from.c2;
+  to[2][2] = from.c3;
+  to[3][2] = from.c4;
+  to[0][3] = from.d1;
+  to[1][3] = from.d2;
+  to[2][3] = from.d3;
+  to[3][3] = from.d4;
+  return to;
+}
+
+void
+SceneConverter::processNode(const aiNode* node)
+{
+  glm::mat4 nodeTransform = AssimpToGlmMatrix(node->mTransformation);
+
+  for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+    const aiMesh* assimpMesh = scene->mMeshes[node->mMeshes[i]];
+
+    uint32_t mesh;
+    auto it = meshIndices.find(assimpMesh);
+    if (it == meshIndices.end()) {
+      mesh = processMesh(assimpMesh);
+      meshIndices[assimpMesh] = mesh;
+    } else {
+      mesh = it->second;
+    }
+
+    data.instances.push_back({ nodeTransform, mesh });
+  }
+
+  for (unsigned int i = 0; i < node->mNumChildren; i++) {
+    processNode(node->mChildren[i]);
+  }
+}
+
+uint32_t
+SceneConverter::processMesh(const aiMesh* mesh)
+{
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  vertices.reserve(mesh->mNumVertices);
+  indices.reserve(mesh->mNumFaces * 3);
+
+  for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+    // zeroed, welding compares every byte
+    Vertex vertex{};
+
+    // Position
+    glm::vec4 position = glm::vec4(
+      mesh->mVertices[i].x, -mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f);
+    vertex.position = glm::vec3(position);
+
+    // Normal
+    if (mesh->HasNormals()) {
+      glm::vec4 normal = glm::vec4(
+        mesh->mNormals[i].x, -mesh->mNormals[i].y, mesh->mNormals[i].z, 0.0f);
+      vertex.normals = glm::normalize(glm::vec3(normal));
+    }
+
+    // Texture coordinates
+    if (mesh->HasTextureCoords(0)) {
+      vertex.texCoords.x = mesh->mTextureCoords[0][i].x;
+      vertex.texCoords.y = mesh->mTextureCoords[0][i].y;
+    } else {
+      vertex.texCoords = glm::vec2(0.0f, 0.0f);
+    }
+
+    vertices.push_back(vertex);
+  }
+
+  for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+    const aiFace& face = mesh->mFaces[i];
+    indices.push_back(face.mIndices[0]);
+    indices.push_back(face.mIndices[1]);
+    indices.push_back(face.mIndices[2]);
+  }
+
+  // assimp's order is whatever the exporter wrote, usually close to random
+  // for the post-transform cache
+  stats.add(optimizeMesh(vertices, indices));
+
+  BakedMesh bakedMesh{};
+  generateLods(vertices, indices, bakedMesh);
+  bakedMesh.diffuseTexture = -1;
+  bakedMesh.specularTexture = -1;
+
+  // If we do have textures
+  if (mesh->mMaterialIndex >= 0) {
+    const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+
+    bakedMesh.diffuseTexture = processTexture(material, aiTextureType_DIFFUSE);
+    bakedMesh.specularTexture =
+      processTexture(material, aiTextureType_SPECULAR);
+  }
+
+  uint32_t startVertex = static_cast<uint32_t>(data.vertices.size());
+  uint32_t firstIndex = static_cast<uint32_t>(data.indices.size());
+  for (uint32_t index : indices) {
+    data.indices.push_back(index + startVertex);
+  }
+  data.vertices.insert(data.vertices.end(), vertices.begin(), vertices.end());
+
+  for (uint32_t i = 0; i < bakedMesh.lodCount; i++) {
+    bakedMesh.lods[i].firstIndex += firstIndex;
+  }
+
+  data.meshes.push_back(bakedMesh);
+  return static_cast<uint32_t>(data.meshes.size() - 1);
+}
+
+// appends the simplified levels to indices, each one after the other, and
+// fills in the lods and the bounds of bakedMesh. firstIndex is relative to
+// the start of indices
+void
+SceneConverter::generateLods(const std::vector<Vertex>& vertices,
+                             std::vector<uint32_t>& indices,
+                             BakedMesh& bakedMesh)
+{
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(std::numeric_limits<float>::lowest());
+  for (const Vertex& vertex : vertices) {
+    min = glm::min(min, vertex.position);
+    max = glm::max(max, vertex.position);
+  }
+  if (vertices.empty()) {
+    min = max = glm::vec3(0.0f);
+  }
+  bakedMesh.aabbMin = glm::vec4(min, 0.0f);
+  bakedMesh.aabbMax = glm::vec4(max, 0.0f);
+
+  glm::vec3 center = (min + max) * 0.5f;
+  float radius = 0.0f;
+  for (const Vertex& vertex : vertices) {
+    radius = std::max(radius, glm::length(vertex.position - center));
+  }
+  bakedMesh.bounds = glm::vec4(center, radius);
+
+  uint32_t fullCount = static_cast<uint32_t>(indices.size());
+  bakedMesh.lods[0] = { 0, fullCount, 0.0f, 0 };
+  bakedMesh.lodCount = 1;
+
+  // every level is simplified from the one before, so its error is on top of
+  // the previous one's
+  std::vector<uint32_t> lod(indices);
+  std::vector<uint32_t> clusterStarts;
+  float totalError = 0.0f;
+  while (bakedMesh.lodCount < MAX_MESH_LODS) {
+    size_t previousCount = lod.size();
+    size_t targetCount = size_t(previousCount * LOD_REDUCTION) / 3 * 3;
+
+    float error;
+    simplifyMesh(
+      vertices, lod, targetCount, LOD_MAX_ERROR * radius - totalError, error);
+    if (lod.empty() || lod.size() > previousCount * LOD_MIN_REDUCTION) {
+      break;
+    }
+
+    // the vertices keep the order of the full mesh, only the triangles get
+    // sorted again
+    std::vector<uint32_t> ordered(lod);
+    optimizeVertexCache(ordered, vertices.size(), clusterStarts);
+
+    BakedLod& bakedLod = bakedMesh.lods[bakedMesh.lodCount++];
+    bakedLod.firstIndex = static_cast<uint32_t>(indices.size());
+    bakedLod.indexCount = static_cast<uint32_t>(ordered.size());
+    totalError += error;
+    bakedLod.error = totalError;
+    indices.insert(indices.end(), ordered.begin(), ordered.end());
+  }
+}
+
+int32_t
+SceneConverter::processTexture(const aiMaterial* material,
+                               aiTextureType type)
+{
+  if (material->GetTextureCount(type) == 0) {
+    return -1;
+  }
+
+  aiString str;
+  material->GetTexture(type, 0, &str);
+
+  auto it = textureIndices.find(str.C_Str());
+  if (it != textureIndices.end()) {
+    return it->second;
+  }
+
+  BakedTexture texture{};
+  if (str.C_Str()[0] == '*') {
+    // embedded texture
+    int texIndex = atoi(&str.C_Str()[1]);
+
+    const aiTexture* aiTexture = scene->mTextures[texIndex];
+
+    // mHeight == 0 means the texture is compressed, raw texel data isn't
+    // supported and gets the empty texture
+    if (aiTexture->mHeight != 0) {
+      textureIndices[str.C_Str()] = -1;
+      return -1;
+    }
+
+    texture.embedded = 1;
+    texture.offset = data.data.size();
+    texture.size = aiTexture->mWidth;
+
+    const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(aiTexture->pcData);
+    data.data.insert(data.data.end(), bytes, bytes + aiTexture->mWidth);
+  } else {
+    // texture from file path
+    texture.embedded = 0;
+    texture.offset = data.data.size();
+    texture.size = str.length;
+
+    data.data.insert(data.data.end(), str.C_Str(), str.C_Str() + str.length);
+  }
+
+  data.textures.push_back(texture);
+  int32_t index = static_cast<int32_t>(data.textures.size() - 1);
+  textureIndices[str.C_Str()] = index;
+  return index;
+}
+
+} // namespace
+
+ModelView
+ModelData::view() const
+{
+  ModelView result;
+  result.vertices = vertices.data();
+  result.vertexCount = static_cast<uint32_t>(vertices.size());
+  result.indices = indices.data();
+  result.indexCount = static_cast<uint32_t>(indices.size());
+  result.meshes = meshes.data();
+  result.meshCount = static_cast<uint32_t>(meshes.size());
+  result.instances = instances.data();
+  result.instanceCount = static_cast<uint32_t>(instances.size());
+  result.textures = textures.data();
+  result.textureCount = static_cast<uint32_t>(textures.size());
+  result.data = data.data();
+  return result;
+}
+
+bool
+importModel(const std::string& filePath,
+            ModelData& data,
+            MeshOptimizationStats* stats)
+{
+  Assimp::Importer importer;
+  unsigned int processFlags =
+    aiProcess_FlipUVs |
+    aiProcess_Triangulate | // Ensure all verticies are triangulated (each 3
+                            // vertices are triangle)
+    aiProcess_GenUVCoords;  // convert spherical, cylindrical, box and planar
+                            // mapping to proper UVs
+
+  const aiScene* scene = importer.ReadFile(filePath, processFlags);
+
+  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+      !scene->mRootNode) {
+    std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+    return false;
+  }
+
+  // preallocate vertices and indices vectors
+  unsigned int totalNumVertices = 0;
+  unsigned int totalNumIndices = 0;
+  for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+    totalNumVertices += scene->mMeshes[i]->mNumVertices;
+    totalNumIndices += scene->mMeshes[i]->mNumFaces *
+                       3; // <== i assume every face has three vertices because
+                          // of the TRIANGULATE option
+  }
+
+  data.meshes.reserve(scene->mNumMeshes);
+  data.instances.reserve(scene->mNumMeshes);
+  data.indices.reserve(totalNumIndices);
+  data.vertices.reserve(totalNumVertices);
+
+  SceneConverter converter{ scene, data };
+  converter.processNode(scene->mRootNode);
+
+  if (stats) {
+    *stats = converter.stats;
+  }
+  return true;
+}
+
+// -------------------- BAKED FILES --------------------
+std::string
+getBakedModelPath(const std::string& filePath)
+{
+  return filePath + ".baked";
+}
+
+static uint64_t
+alignOffset(uint64_t offset)
+{
+  return (offset + 15) & ~static_cast<uint64_t>(15);
+}
+
+void
+writeBakedModel(const std::string& filePath, const ModelData& data)
+{
+  BakedHeader header{};
+  header.magic = BAKED_MODEL_MAGIC;
+  header.version = BAKED_MODEL_VERSION;
+  header.vertexSize = sizeof(Vertex);
+
+  header.vertexCount = static_cast<uint32_t>(data.vertices.size());
+  header.indexCount = static_cast<uint32_t>(data.indices.size());
+  header.meshCount = static_cast<uint32_t>(data.meshes.size());
+  header.instanceCount = static_cast<uint32_t>(data.instances.size());
+  header.textureCount = static_cast<uint32_t>(data.textures.size());
+
+  header.vertexOffset = alignOffset(sizeof(BakedHeader));
+  header.indexOffset =
+    alignOffset(header.vertexOffset + sizeof(Vertex) * header.vertexCount);
+  header.meshOffset =
+    alignOffset(header.indexOffset + sizeof(uint32_t) * header.indexCount);
+  header.instanceOffset =
+    alignOffset(header.meshOffset + sizeof(BakedMesh) * header.meshCount);
+  header.textureOffset = alignOffset(
+    header.instanceOffset + sizeof(BakedInstance) * header.instanceCount);
+  header.dataOffset = alignOffset(header.textureOffset +
+                                  sizeof(BakedTexture) * header.textureCount);
+  header.dataSize = data.data.size();
+
+  std::vector<unsigned char> file(header.dataOffset + header.dataSize, 0);
+  auto copy = [&file](uint64_t offset, const void* src, size_t size) {
+    if (size > 0) {
+      memcpy(file.data() + offset, src, size);
+    }
+  };
+
+  copy(0, &header, sizeof(header));
+  copy(header.vertexOffset,
+       data.vertices.data(),
+       sizeof(Vertex) * data.vertices.size());
+  copy(header.indexOffset,
+       data.indices.data(),
+       sizeof(uint32_t) * data.indices.size());
+  copy(header.meshOffset,
+       data.meshes.data(),
+       sizeof(BakedMesh) * data.meshes.size());
+  copy(header.instanceOffset,
+       data.instances.data(),
+       sizeof(BakedInstance) * data.instances.size());
+  copy(header.textureOffset,
+       data.textures.data(),
+       sizeof(BakedTexture) * data.textures.size());
+  copy(header.dataOffset, data.data.data(), data.data.size());
+
+  std::ofstream out(filePath, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(file.data()), file.size());
+  if (!out) {
+    throw std::runtime_error("failed to write baked model! " + filePath);
+  }
+}
+
+bool
+BakedModel::open(const std::string& filePath, const std::string& sourcePath)
+{
+  modelView = ModelView();
+
+  // a bake older than its source is stale, better to import it again than to
+  // show an old version
+  if (!sourcePath.empty()) {
+    std::error_code error;
+    auto bakeTime = std::filesystem::last_write_time(filePath, error);
+    if (error) {
+      return false;
+    }
+    auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+    if (!error && sourceTime > bakeTime) {
+      std::cout << "baked model is older than its source, ignoring "
+                << filePath << std::endl;
+      return false;
+    }
+  }
+
+  if (!file.open(filePath) || file.size() < sizeof(BakedHeader)) {
+    return false;
+  }
+
+  BakedHeader header;
+  memcpy(&header, file.data(), sizeof(header));
+
+  if (header.magic != BAKED_MODEL_MAGIC ||
+      header.version != BAKED_MODEL_VERSION ||
+      header.vertexSize != sizeof(Vertex)) {
+    std::cout << "baked model is from another version, ignoring " << filePath
+              << std::endl;
+    file.close();
+    return false;
+  }
+
+  auto inside = [this](uint64_t offset, uint64_t size) {
+    return offset <= file.size() && size <= file.size() - offset;
+  };
+  if (!inside(header.vertexOffset, sizeof(Vertex) * header.vertexCount) ||
+      !inside(header.indexOffset, sizeof(uint32_t) * header.indexCount) ||
+      !inside(header.meshOffset, sizeof(BakedMesh) * header.meshCount) ||
+      !inside(header.instanceOffset,
+              sizeof(BakedInstance) * header.instanceCount) ||
+      !inside(header.textureOffset,
+              sizeof(BakedTexture) * header.textureCount) ||
+      !inside(header.dataOffset, header.dataSize)) {
+    std::cout << "baked model is truncated, ignoring " << filePath
+              << std::endl;
+    file.close();
+    return false;
+  }
+
+  // the sections are in the file, now what's in them has to point inside of
+  // them too. a corrupt bake would read past the mapping or hand the gpu
+  // indices past the end of the vertices otherwise
+  const unsigned char* base = file.data();
+  const BakedTexture* textures =
+    reinterpret_cast<const BakedTexture*>(base + header.textureOffset);
+  for (uint32_t i = 0; i < header.textureCount; i++) {
+    if (textures[i].offset > header.dataSize ||
+        textures[i].size > header.dataSize - textures[i].offset) {
+      std::cout << "baked model has a texture past its data, ignoring "
+                << filePath << std::endl;
+      file.close();
+      return false;
+    }
+  }
+
+  const BakedMesh* meshes =
+    reinterpret_cast<const BakedMesh*>(base + header.meshOffset);
+  for (uint32_t i = 0; i < header.meshCount; i++) {
+    bool valid = meshes[i].lodCount <= MAX_MESH_LODS;
+    for (uint32_t lod = 0; valid && lod < meshes[i].lodCount; lod++) {
+      const BakedLod& bakedLod = meshes[i].lods[lod];
+      valid = static_cast<uint64_t>(bakedLod.firstIndex) +
+                bakedLod.indexCount <=
+              header.indexCount;
+    }
+    if (!valid) {
+      std::cout << "baked model has a mesh past its indices, ignoring "
+                << filePath << std::endl;
+      file.close();
+      return false;
+    }
+  }
+
+  const uint32_t* indices =
+    reinterpret_cast<const uint32_t*>(base + header.indexOffset);
+  for (uint32_t i = 0; i < header.indexCount; i++) {
+    if (indices[i] >= header.vertexCount) {
+      std::cout << "baked model has an index past its vertices, ignoring "
+                << filePath << std::endl;
+      file.close();
+      return false;
+    }
+  }
+
+  modelView.vertices =
+    reinterpret_cast<const Vertex*>(base + header.vertexOffset);
+  modelView.vertexCount = header.vertexCount;
+  modelView.indices = indices;
+  modelView.indexCount = header.indexCount;
+  modelView.meshes = meshes;
+  modelView.meshCount = header.meshCount;
+  modelView.instances =
+    reinterpret_cast<const BakedInstance*>(base + header.instanceOffset);
+  modelView.instanceCount = header.instanceCount;
+  modelView.textures = textures;
+  modelView.textureCount = header.textureCount;
+  modelView.data = base + header.dataOffset;
+  return true;
+}
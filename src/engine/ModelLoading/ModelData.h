@@ -0,0 +1,150 @@
+#ifndef _MODEL_DATA_H_
+#define _MODEL_DATA_H_
+
+#include <glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "engine/MappedFile.h"
+#include "engine/ModelLoading/MeshOptimizer.h"
+#include "engine/Vertex.h"
+
+// cpu side contents of a model file, in the exact layout the engine uploads.
+// produced by importModel() (assimp) or read back from a baked .baked file
+// that the Vulkan_Bake tool writes from the same data.
+
+// bump whenever the layout below, Vertex or what importModel() produces
+// changes, old bakes are then ignored
+#define BAKED_MODEL_VERSION 4
+
+// levels of detail a mesh can have, the first one is the mesh itself
+#define MAX_MESH_LODS 4
+
+struct BakedLod
+{
+  // relative to the model's first index, indices are relative to its first
+  // vertex. every level indexes into the same vertices
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // how far the simplified surface is from the full one at most, in model
+  // units. 0 for the first level
+  float error;
+  uint32_t padding;
+};
+
+struct BakedMesh
+{
+  BakedLod lods[MAX_MESH_LODS];
+  uint32_t lodCount;
+  // into the texture table, -1 uses the engine's empty texture
+  int32_t diffuseTexture;
+  int32_t specularTexture;
+  uint32_t padding;
+  // bounding sphere in model space, center in xyz and radius in w
+  glm::vec4 bounds;
+  // bounding box in model space, w is unused
+  glm::vec4 aabbMin;
+  glm::vec4 aabbMax;
+};
+
+struct BakedInstance
+{
+  // the node's own transform, the model matrix is applied on load
+  glm::mat4 transformation;
+  uint32_t mesh;
+};
+
+struct BakedTexture
+{
+  // 1 for compressed image data embedded in the model, 0 for a file path
+  uint32_t embedded;
+  uint32_t padding;
+  // range in the data blob holding the image data or the path characters
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct BakedHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vertexSize;
+
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t meshCount;
+  uint32_t instanceCount;
+  uint32_t textureCount;
+
+  // from the start of the file, each one 16 byte aligned
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  uint64_t meshOffset;
+  uint64_t instanceOffset;
+  uint64_t textureOffset;
+  uint64_t dataOffset;
+  uint64_t dataSize;
+};
+
+// non owning view of a model's data, either into a ModelData or straight into
+// a mapped .baked file
+struct ModelView
+{
+  const Vertex* vertices = nullptr;
+  uint32_t vertexCount = 0;
+  const uint32_t* indices = nullptr;
+  uint32_t indexCount = 0;
+  const BakedMesh* meshes = nullptr;
+  uint32_t meshCount = 0;
+  const BakedInstance* instances = nullptr;
+  uint32_t instanceCount = 0;
+  const BakedTexture* textures = nullptr;
+  uint32_t textureCount = 0;
+  const unsigned char* data = nullptr;
+};
+
+struct ModelData
+{
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<BakedMesh> meshes;
+  std::vector<BakedInstance> instances;
+  std::vector<BakedTexture> textures;
+  std::vector<unsigned char> data;
+
+  ModelView view() const;
+};
+
+// runs the assimp importer, converts the result, runs every mesh through
+// optimizeMesh() and generates its levels of detail. returns false (with data
+// left empty) if the file couldn't be read. stats gets the vertex cache
+// numbers of the whole model
+bool importModel(const std::string& filePath,
+                 ModelData& data,
+                 MeshOptimizationStats* stats = nullptr);
+
+// the baked file that goes with a model, "models/voyager.gltf" gives
+// models/voyager.gltf.baked
+std::string getBakedModelPath(const std::string& filePath);
+
+void writeBakedModel(const std::string& filePath, const ModelData& data);
+
+// a .baked file mapped into memory, view() points straight into the mapping
+// and stays valid until the BakedModel is destroyed
+class BakedModel
+{
+public:
+  // false if the file is missing, from another version or older than
+  // sourcePath (when given), the caller should import the source instead
+  bool open(const std::string& filePath, const std::string& sourcePath = "");
+
+  const ModelView& view() const { return modelView; }
+
+private:
+  MappedFile file;
+  ModelView modelView;
+};
+
+#endif
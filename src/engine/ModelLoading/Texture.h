@@ -3,16 +3,39 @@
 
 #include <stb_image.h>
 
+#include <memory>
 #include <string>
 
+#include "engine/BindlessTextures.h"
 #include "engine/VulkanContext.h"
 
+struct TextureStream;
+
+// rgba8 pixels decoded by stb, doesn't need vulkan so it can be filled on a
+// worker thread and turned into a Texture later
+struct ImageData
+{
+  int width = 0;
+  int height = 0;
+  std::unique_ptr<stbi_uc, void (*)(void*)> pixels{ nullptr, stbi_image_free };
+
+  bool valid() const { return pixels != nullptr; }
+};
+
 class Texture
 {
 public:
   Texture();
-  Texture(VulkanContext* vkContext, unsigned char* data, size_t size);
+  Texture(VulkanContext* vkContext, const unsigned char* data, size_t size);
   Texture(VulkanContext* vkContext, std::string filePath);
+  Texture(VulkanContext* vkContext, const ImageData& image);
+  // takes over a stream from the TextureStreamer, the texture is bound as a
+  // placeholder until its pixels have been streamed in
+  Texture(VulkanContext* vkContext, TextureStream* stream);
+
+  // thread safe, false if the image couldn't be decoded
+  static bool decode(const std::string& filePath, ImageData& image);
+  static bool decode(const unsigned char* data, size_t size, ImageData& image);
 
   // try to delete copy constructor
   Texture(Texture& texture) = delete;
@@ -25,12 +48,17 @@ public:
     sampler = other.sampler;
     image = other.image;
     allocation = other.allocation;
+    mipLevels = other.mipLevels;
+    stream = other.stream;
+    bindlessSlot = other.bindlessSlot;
     vkContext = other.vkContext;
 
     other.view = VK_NULL_HANDLE;
     other.sampler = VK_NULL_HANDLE;
     other.image = VK_NULL_HANDLE;
     other.allocation = VK_NULL_HANDLE;
+    other.stream = nullptr;
+    other.bindlessSlot = BINDLESS_NO_SLOT;
     other.vkContext = nullptr;
   }
 
@@ -44,12 +72,17 @@ public:
       sampler = other.sampler;
       image = other.image;
       allocation = other.allocation;
+      mipLevels = other.mipLevels;
+      stream = other.stream;
+      bindlessSlot = other.bindlessSlot;
       vkContext = other.vkContext;
 
       other.view = VK_NULL_HANDLE;
       other.sampler = VK_NULL_HANDLE;
       other.image = VK_NULL_HANDLE;
       other.allocation = VK_NULL_HANDLE;
+      other.stream = nullptr;
+      other.bindlessSlot = BINDLESS_NO_SLOT;
       other.vkContext = nullptr;
     }
     return *this;
@@ -58,11 +91,25 @@ public:
   ~Texture();
 
   VkImageView view = VK_NULL_HANDLE;
-  VkSampler sampler = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE; // owned by the SamplerCache
+  // where the texture sits in BindlessTextures, handed out by acquire and
+  // given back when the texture is destroyed
+  uint32_t bindlessSlot = BINDLESS_NO_SLOT;
+
+  // what to bind right now, streamed textures change it over time. the
+  // version goes up with every change, descriptors written with an older one
+  // are stale
+  VkImageView getView() const;
+  uint32_t getVersion() const;
+  TextureStream* getStream() const { return stream; }
 
 private:
   VkImage image = VK_NULL_HANDLE;
   VmaAllocation allocation = VK_NULL_HANDLE;
+  uint32_t mipLevels = 1;
+
+  // only for streamed textures, owned by the TextureStreamer
+  TextureStream* stream = nullptr;
 
   VulkanContext* vkContext;
 
@@ -72,21 +119,11 @@ private:
   void createTextureImageFromPixels(stbi_uc* pixels,
                                     int texWidth,
                                     int texHeight);
+  // false when there is no usable .ktx for filePath
+  bool createTextureImageFromKtx(const std::string& filePath);
 
   void createTextureImageView();
 
-  void transitionImageLayout(VkImage image,
-                             VkFormat format,
-                             VkImageLayout oldLayout,
-                             VkImageLayout newLayout);
-
-  void copyBufferToImage(VkBuffer buffer,
-                         VkImage image,
-                         uint32_t width,
-                         uint32_t height);
-
-  VkCommandBuffer beginSingleTimeCommands();
-  void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void createTextureSampler();
 };
 
@@ -0,0 +1,98 @@
+#include "engine/ModelLoading/TextureCache.h"
+#include "engine/KtxLoader.h"
+#include "engine/TextureStreamer.h"
+
+TextureCache::TextureCache(VulkanContext* vkContext)
+  : vkContext(vkContext)
+{
+}
+
+std::shared_ptr<Texture>
+TextureCache::get(const std::string& filePath, const ImageData* decoded)
+{
+  std::string key = "file:" + filePath;
+
+  std::shared_ptr<Texture> texture = find(key);
+  if (texture) {
+    return texture;
+  }
+
+  // a ktx file is already compressed with its mips, it's loaded as is
+  TextureStreamer* streamer = vkContext->textureStreamer;
+  if (decoded && decoded->valid()) {
+    texture = std::make_shared<Texture>(vkContext, *decoded);
+  } else if (streamer->isEnabled() && !hasKtxCandidate(filePath)) {
+    texture = std::make_shared<Texture>(vkContext, streamer->add(filePath));
+  } else {
+    texture = std::make_shared<Texture>(vkContext, filePath);
+  }
+  textures[key] = texture;
+  loadCount++;
+  return texture;
+}
+
+std::shared_ptr<Texture>
+TextureCache::get(const unsigned char* data,
+                  size_t size,
+                  const ImageData* decoded)
+{
+  // the size goes into the key too, two blobs need to collide on both
+  std::string key =
+    "embedded:" + std::to_string(hash(data, size)) + ":" + std::to_string(size);
+
+  std::shared_ptr<Texture> texture = find(key);
+  if (texture) {
+    return texture;
+  }
+
+  TextureStreamer* streamer = vkContext->textureStreamer;
+  if (decoded && decoded->valid()) {
+    texture = std::make_shared<Texture>(vkContext, *decoded);
+  } else if (streamer->isEnabled()) {
+    texture = std::make_shared<Texture>(vkContext, streamer->add(data, size));
+  } else {
+    texture = std::make_shared<Texture>(vkContext, data, size);
+  }
+  textures[key] = texture;
+  loadCount++;
+  return texture;
+}
+
+void
+TextureCache::purge()
+{
+  for (auto it = textures.begin(); it != textures.end();) {
+    if (it->second.expired()) {
+      it = textures.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+std::shared_ptr<Texture>
+TextureCache::find(const std::string& key)
+{
+  auto it = textures.find(key);
+  if (it == textures.end()) {
+    return nullptr;
+  }
+
+  std::shared_ptr<Texture> texture = it->second.lock();
+  if (texture) {
+    hitCount++;
+  }
+  return texture;
+}
+
+uint64_t
+TextureCache::hash(const unsigned char* data, size_t size)
+{
+  // 64 bit FNV-1a, plenty for telling images apart
+  uint64_t result = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    result ^= data[i];
+    result *= 1099511628211ull;
+  }
+  return result;
+}
@@ -0,0 +1,51 @@
+#ifndef _TEXTURE_CACHE_H_
+#define _TEXTURE_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "engine/ModelLoading/Texture.h"
+#include "engine/VulkanContext.h"
+
+// hands out shared textures so every mesh that references the same file (or
+// the same embedded image) ends up with the same VkImage. the cache only keeps
+// weak references, a texture is destroyed as soon as the last mesh using it
+// goes away and gets loaded again the next time it's asked for.
+class TextureCache
+{
+public:
+  TextureCache(VulkanContext* vkContext);
+
+  TextureCache(const TextureCache&) = delete;
+  TextureCache& operator=(const TextureCache&) = delete;
+
+  // decoded, when given, is the image already decoded off the main thread and
+  // is only used if the texture isn't cached yet
+  std::shared_ptr<Texture> get(const std::string& filePath,
+                               const ImageData* decoded = nullptr);
+  // embedded (compressed) image data, keyed by a hash of its contents
+  std::shared_ptr<Texture> get(const unsigned char* data,
+                               size_t size,
+                               const ImageData* decoded = nullptr);
+
+  // drops the entries whose texture has already been destroyed
+  void purge();
+
+  size_t getLoadCount() const { return loadCount; }
+  size_t getHitCount() const { return hitCount; }
+
+private:
+  VulkanContext* vkContext;
+
+  std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+
+  size_t loadCount = 0;
+  size_t hitCount = 0;
+
+  std::shared_ptr<Texture> find(const std::string& key);
+  static uint64_t hash(const unsigned char* data, size_t size);
+};
+
+#endif
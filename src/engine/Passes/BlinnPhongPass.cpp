@@ -1,5 +1,9 @@
 #include "engine/Passes/BlinnPhongPass.h"
+#include "engine/BindlessTextures.h"
+#include "engine/ClusteredLights.h"
+#include "engine/GpuCuller.h"
 #include "engine/ModelLoading/Model.h"
+#include "engine/Profiler.h"
 #include "engine/Vertex.h"
 
 BlinnPhongPass::BlinnPhongPass(
@@ -7,8 +11,13 @@ BlinnPhongPass::BlinnPhongPass(
   const std::array<AttachmentData, 16>& attachmentData,
   const Scene& scene,
   const uint32_t attachmentWidth,
-  const uint32_t attachmentHeight)
+  const uint32_t attachmentHeight,
+  const GpuCuller* gpuCuller,
+  const ClusteredLights* clusteredLights)
   : IPassHelper(vkContext, scene)
+  , gpuCuller(gpuCuller)
+  , clusteredLights(clusteredLights)
+  , drawList(vkContext)
 {
   createAttachments(attachmentWidth, attachmentHeight);
 
@@ -16,7 +25,13 @@ BlinnPhongPass::BlinnPhongPass(
 
   createFrameBuffer(attachmentData);
 
-  createMainPipeline(scene);
+  createMainPipeline(scene,
+                     vkContext->bindlessTextures != nullptr,
+                     blinnPhongPipeline,
+                     blinnPhongPipelineLayout);
+  if (vkContext->bindlessTextures) {
+    createMainPipeline(scene, false, perMeshPipeline, perMeshPipelineLayout);
+  }
   createSkyboxPipeline(scene);
   createLightCubesPipeline(scene);
 }
@@ -25,15 +40,15 @@ BlinnPhongPass::~BlinnPhongPass()
 {
   vkDestroyRenderPass(vkContext->logicalDevice, renderPass, nullptr);
 
-  vkDestroyPipeline(vkContext->logicalDevice, blinnPhongPipeline, nullptr);
   vkDestroyPipelineLayout(
     vkContext->logicalDevice, blinnPhongPipelineLayout, nullptr);
 
-  vkDestroyPipeline(vkContext->logicalDevice, skyboxPipeline, nullptr);
+  vkDestroyPipelineLayout(
+    vkContext->logicalDevice, perMeshPipelineLayout, nullptr);
+
   vkDestroyPipelineLayout(
     vkContext->logicalDevice, skyboxPipelineLayout, nullptr);
 
-  vkDestroyPipeline(vkContext->logicalDevice, lightCubesPipeline, nullptr);
   vkDestroyPipelineLayout(
     vkContext->logicalDevice, lightCubesPipelineLayout, nullptr);
 
@@ -44,6 +59,9 @@ BlinnPhongPass::~BlinnPhongPass()
 void
 BlinnPhongPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
 {
+  // every model lives in the geometry arena, bind it once for the whole pass
+  vkContext->geometryArena->bind(vkSwapchain->commandBuffer);
+
   VkRenderPassBeginInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   renderPassInfo.renderPass = renderPass;
@@ -62,9 +80,22 @@ BlinnPhongPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
     vkSwapchain->commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
   // -------------------- bind main pipeline --------------------
+  // with bindless textures every material is bound once below and the
+  // instances pick theirs, nothing is bound per mesh. a mesh that didn't get
+  // slots sends the whole frame down the per mesh path instead
+  const BindlessTextures* bindless =
+    vkContext->bindlessTextures && hasMaterials(scene)
+      ? vkContext->bindlessTextures
+      : nullptr;
+  bool perMesh = vkContext->bindlessTextures && !bindless;
+  VkPipelineLayout layout =
+    perMesh ? perMeshPipelineLayout : blinnPhongPipelineLayout;
+
+  vkContext->profiler->beginGpuScope(vkSwapchain->commandBuffer, "meshes");
   vkCmdBindPipeline(vkSwapchain->commandBuffer,
                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    blinnPhongPipeline);
+                    perMesh ? perMeshPipeline.get()
+                            : blinnPhongPipeline.get());
 
   VkViewport viewport{};
   viewport.x = 0.0f;
@@ -82,78 +113,110 @@ BlinnPhongPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
 
   vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
                           VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          blinnPhongPipelineLayout,
+                          layout,
                           0,
                           1,
                           &scene.cameraUBODescriptorset,
-                          0,
-                          nullptr);
-
-  vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
-                          VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          blinnPhongPipelineLayout,
                           1,
-                          1,
-                          &scene.lightsUBODescriptorset,
-                          0,
-                          nullptr);
+                          &scene.cameraUBOOffset);
+
+  if (clusteredLights) {
+    clusteredLights->bind(vkSwapchain->commandBuffer, layout, 1);
+  } else {
+    vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            layout,
+                            1,
+                            1,
+                            &scene.lightsUBODescriptorset,
+                            3,
+                            scene.lightsUBOOffsets.data());
+  }
 
   vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
                           VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          blinnPhongPipelineLayout,
+                          layout,
                           3,
                           1,
                           &scene.shadowMapDescriptorSet,
                           0,
                           nullptr);
 
-  struct PushConstant
-  {
-    glm::mat4 model;
-  };
+  if (bindless) {
+    VkDescriptorSet textures =
+      bindless->getDescriptorSet(vkSwapchain->currentFrame);
+    vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            layout,
+                            2,
+                            1,
+                            &textures,
+                            0,
+                            nullptr);
+  }
 
-  for (auto& model : scene.models) {
-
-    VkBuffer vertexBuffers[] = { model.vertexBuffer };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(
-      vkSwapchain->commandBuffer, 0, 1, vertexBuffers, offsets);
-
-    vkCmdBindIndexBuffer(
-      vkSwapchain->commandBuffer, model.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-    for (const auto& instance : model.meshInstances) {
-      PushConstant pc;
-      pc.model = instance.transformation;
-      vkCmdPushConstants(vkSwapchain->commandBuffer,
-                         blinnPhongPipelineLayout,
-                         VK_SHADER_STAGE_VERTEX_BIT,
-                         0,
-                         64,
-                         &pc);
-
-      vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
-                              VK_PIPELINE_BIND_POINT_GRAPHICS,
-                              blinnPhongPipelineLayout,
-                              2,
-                              1,
-                              &instance.mesh->descriptorSet,
-                              0,
-                              nullptr);
-
-      vkCmdDrawIndexed(vkSwapchain->commandBuffer,
-                       instance.mesh->indexCount,
-                       1,
-                       instance.mesh->startIndex,
-                       0,
-                       0);
+  if (gpuCuller) {
+    // a single indirect draw per mesh
+    gpuCuller->bind(vkSwapchain->commandBuffer, layout, 4);
+
+    const std::vector<const Mesh*>& meshes = gpuCuller->getMeshes();
+    for (uint32_t i = 0; i < meshes.size(); i++) {
+      if (!bindless) {
+        vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                layout,
+                                2,
+                                1,
+                                &meshes[i]->descriptorSet,
+                                0,
+                                nullptr);
+      }
+      gpuCuller->drawMesh(vkSwapchain->commandBuffer, i);
+    }
+  } else {
+    // one instanced draw per mesh and level of detail. there's a single
+    // pipeline and every mesh is in the geometry arena, so the textures are
+    // all the state that changes: the draws of a mesh go together, nearest
+    // first. with bindless textures there's nothing to group by
+    const std::vector<InstanceBatch>& batches =
+      scene.cameraInstances.getBatches();
+    drawList.reset(static_cast<uint32_t>(batches.size()));
+    for (uint32_t i = 0; i < batches.size(); i++) {
+      uint32_t material = bindless ? 0 : batches[i].mesh->id;
+      drawList.add(DrawList::makeKey(
+                     DRAW_PASS_FORWARD, 0, material, 0, batches[i].depth),
+                   i);
+    }
+    drawList.sort();
+
+    scene.cameraInstances.bind(vkSwapchain->commandBuffer);
+
+    VkDescriptorSet boundSet = VK_NULL_HANDLE;
+    for (const DrawPacket& packet : drawList) {
+      const InstanceBatch& batch = batches[packet.index];
+      if (!bindless && batch.mesh->descriptorSet != boundSet) {
+        boundSet = batch.mesh->descriptorSet;
+        vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                layout,
+                                2,
+                                1,
+                                &boundSet,
+                                0,
+                                nullptr);
+      }
+      scene.cameraInstances.draw(vkSwapchain->commandBuffer, batch);
     }
   }
 
+  vkContext->profiler->endGpuScope(vkSwapchain->commandBuffer);
+
   // -------------------- bind lightCubes pipeline --------------------
+  vkContext->profiler->beginGpuScope(vkSwapchain->commandBuffer,
+                                     "light cubes");
   vkCmdBindPipeline(vkSwapchain->commandBuffer,
                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    lightCubesPipeline);
+                    lightCubesPipeline.get());
 
   vkCmdSetViewport(vkSwapchain->commandBuffer, 0, 1, &viewport);
   vkCmdSetScissor(vkSwapchain->commandBuffer, 0, 1, &scissor);
@@ -164,58 +227,23 @@ BlinnPhongPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
                           0,
                           1,
                           &scene.cameraUBODescriptorset,
-                          0,
-                          nullptr);
-
-  struct LightColor
-  {
-    glm::vec4 lightColor;
-  };
+                          1,
+                          &scene.cameraUBOOffset);
 
-  for (int i = 0; i < scene.lightCubes.size(); i++) {
-    VkBuffer vertexBuffers[] = { scene.lightCubes[i].vertexBuffer };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(
-      vkSwapchain->commandBuffer, 0, 1, vertexBuffers, offsets);
-
-    vkCmdBindIndexBuffer(vkSwapchain->commandBuffer,
-                         scene.lightCubes[i].indexBuffer,
-                         0,
-                         VK_INDEX_TYPE_UINT32);
-
-    for (const auto& instance : scene.lightCubes[i].meshInstances) {
-      PushConstant pc;
-      pc.model = instance.transformation;
-      vkCmdPushConstants(vkSwapchain->commandBuffer,
-                         blinnPhongPipelineLayout,
-                         VK_SHADER_STAGE_VERTEX_BIT,
-                         0,
-                         64,
-                         &pc);
-
-      LightColor lightColor;
-      glm::vec3 color = scene.pointLights[i].getColor();
-      lightColor.lightColor = glm::vec4(color, 1.0);
-      vkCmdPushConstants(vkSwapchain->commandBuffer,
-                         lightCubesPipelineLayout,
-                         VK_SHADER_STAGE_FRAGMENT_BIT,
-                         64,
-                         16,
-                         &lightColor);
-
-      vkCmdDrawIndexed(vkSwapchain->commandBuffer,
-                       instance.mesh->indexCount,
-                       1,
-                       instance.mesh->startIndex,
-                       0,
-                       0);
-    }
+  // all the cubes are the same mesh, their placement and color come with
+  // the instances
+  scene.lightCubeInstances.bind(vkSwapchain->commandBuffer);
+  for (const InstanceBatch& batch : scene.lightCubeInstances.getBatches()) {
+    scene.lightCubeInstances.draw(vkSwapchain->commandBuffer, batch);
   }
 
+  vkContext->profiler->endGpuScope(vkSwapchain->commandBuffer);
+
   // -------------------- bind skybox pipeline --------------------
+  vkContext->profiler->beginGpuScope(vkSwapchain->commandBuffer, "skybox");
   vkCmdBindPipeline(vkSwapchain->commandBuffer,
                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    skyboxPipeline);
+                    skyboxPipeline.get());
 
   vkCmdSetViewport(vkSwapchain->commandBuffer, 0, 1, &viewport);
   vkCmdSetScissor(vkSwapchain->commandBuffer, 0, 1, &scissor);
@@ -226,8 +254,8 @@ BlinnPhongPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
                           0,
                           1,
                           &scene.cameraUBODescriptorset,
-                          0,
-                          nullptr);
+                          1,
+                          &scene.cameraUBOOffset);
 
   vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
                           VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -238,15 +266,10 @@ BlinnPhongPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
                           0,
                           nullptr);
 
-  VkBuffer vertexBuffers[] = { scene.skybox->cube->vertexBuffer };
-  VkDeviceSize offsets[] = { 0 };
-  vkCmdBindVertexBuffers(
-    vkSwapchain->commandBuffer, 0, 1, vertexBuffers, offsets);
-
-  vkCmdBindIndexBuffer(vkSwapchain->commandBuffer,
-                       scene.skybox->cube->indexBuffer,
-                       0,
-                       VK_INDEX_TYPE_UINT32);
+  struct PushConstant
+  {
+    glm::mat4 model;
+  };
 
   for (const auto& instance : scene.skybox->cube->meshInstances) {
     PushConstant pc;
@@ -259,13 +282,15 @@ BlinnPhongPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
                        &pc);
 
     vkCmdDrawIndexed(vkSwapchain->commandBuffer,
-                     instance.mesh->indexCount,
+                     instance.mesh->lods[0].indexCount,
                      1,
-                     instance.mesh->startIndex,
-                     0,
+                     instance.mesh->lods[0].startIndex,
+                     instance.mesh->vertexOffset,
                      0);
   }
 
+  vkContext->profiler->endGpuScope(vkSwapchain->commandBuffer);
+
   vkCmdEndRenderPass(vkSwapchain->commandBuffer);
 }
 
@@ -441,283 +466,91 @@ BlinnPhongPass::createRenderPass(std::array<AttachmentData, 16> attachmentData)
   }
 }
 
-void
-BlinnPhongPass::createMainPipeline(const Scene& scene)
+bool
+BlinnPhongPass::hasMaterials(const Scene& scene) const
 {
-  std::string shaderPath = SHADER_PATH;
-  auto vertShaderCode = readFile(shaderPath + "texture_vert.spv");
-  auto fragShaderCode = readFile(shaderPath + "texture_frag.spv");
-
-  VkShaderModule vertShaderModule =
-    vkContext->createShaderModule(vertShaderCode);
-  VkShaderModule fragShaderModule =
-    vkContext->createShaderModule(fragShaderCode);
-
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-  vertShaderStageInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-  fragShaderStageInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo,
-                                                     fragShaderStageInfo };
-
-  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-  vertexInputInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-  auto bindingDescription = Vertex::getBindingDescription();
-  auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.vertexAttributeDescriptionCount =
-    static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-  inputAssembly.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
+  if (gpuCuller) {
+    for (const Mesh* mesh : gpuCuller->getMeshes()) {
+      if (mesh->material == Mesh::NO_MATERIAL) {
+        return false;
+      }
+    }
+    return true;
+  }
 
-  VkPushConstantRange modelPCRange{};
-  modelPCRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  modelPCRange.offset = 0;
-  modelPCRange.size = 64;
+  for (const InstanceBatch& batch : scene.cameraInstances.getBatches()) {
+    if (batch.mesh->material == Mesh::NO_MATERIAL) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  VkPipelineViewportStateCreateInfo viewportState{};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.scissorCount = 1;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer{};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth = 1.0f;
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  rasterizer.depthBiasEnable = VK_FALSE;
-
-  VkPipelineMultisampleStateCreateInfo multisampling{};
-  multisampling.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-  VkPipelineDepthStencilStateCreateInfo depthStencil{};
-  depthStencil.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depthStencil.depthTestEnable = VK_TRUE;
-  depthStencil.depthWriteEnable = VK_TRUE;
-  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-  depthStencil.depthBoundsTestEnable = VK_FALSE;
-  depthStencil.minDepthBounds = 0.0f; // Optional
-  depthStencil.maxDepthBounds = 1.0f; // Optional
-  depthStencil.stencilTestEnable = VK_FALSE;
-  depthStencil.front = {}; // Optional
-  depthStencil.back = {};  // Optional
-
-  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-  colorBlendAttachment.colorWriteMask =
-    VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-    VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE;
-
-  VkPipelineColorBlendStateCreateInfo colorBlending{};
-  colorBlending.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.logicOp = VK_LOGIC_OP_COPY;
-  colorBlending.attachmentCount = 1;
-  colorBlending.pAttachments = &colorBlendAttachment;
-  colorBlending.blendConstants[0] = 0.0f;
-  colorBlending.blendConstants[1] = 0.0f;
-  colorBlending.blendConstants[2] = 0.0f;
-  colorBlending.blendConstants[3] = 0.0f;
-
-  std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT,
-                                                VK_DYNAMIC_STATE_SCISSOR };
-
-  VkPipelineDynamicStateCreateInfo dynamicState{};
-  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-  dynamicState.pDynamicStates = dynamicStates.data();
-
-  std::array<VkDescriptorSetLayout, 4> descriptorSetLayouts;
-  descriptorSetLayouts[0] = scene.cameraUBOLayout;
-  descriptorSetLayouts[1] = scene.lightsUBOLayout;
-  descriptorSetLayouts[2] = Model::textureLayout;
-  descriptorSetLayouts[3] = scene.directionalShadowMapLayout;
+void
+BlinnPhongPass::createMainPipeline(const Scene& scene,
+                                   bool bindless,
+                                   PipelineHandle& pipeline,
+                                   VkPipelineLayout& pipelineLayout)
+{
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {
+    scene.cameraUBOLayout,
+    clusteredLights ? clusteredLights->getDescriptorSetLayout()
+                    : scene.lightsUBOLayout,
+    bindless ? vkContext->bindlessTextures->getDescriptorSetLayout()
+             : Model::textureLayout,
+    scene.directionalShadowMapLayout
+  };
+  // the instances the indirect draws index into
+  if (gpuCuller) {
+    descriptorSetLayouts.push_back(gpuCuller->getDescriptorSetLayout());
+  }
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount =
     static_cast<uint32_t>(descriptorSetLayouts.size());
   pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &modelPCRange;
 
   if (vkCreatePipelineLayout(vkContext->logicalDevice,
                              &pipelineLayoutInfo,
                              nullptr,
-                             &blinnPhongPipelineLayout) != VK_SUCCESS) {
+                             &pipelineLayout) != VK_SUCCESS) {
     throw std::runtime_error("failed to create pipeline layout!");
   }
 
-  VkGraphicsPipelineCreateInfo pipelineInfo{};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = shaderStages;
-  pipelineInfo.pVertexInputState = &vertexInputInfo;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterizer;
-  pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = &dynamicState;
-  pipelineInfo.layout = blinnPhongPipelineLayout;
-  pipelineInfo.renderPass = renderPass;
-  pipelineInfo.subpass = 0;
-  pipelineInfo.pDepthStencilState = &depthStencil;
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-  if (vkCreateGraphicsPipelines(vkContext->logicalDevice,
-                                VK_NULL_HANDLE,
-                                1,
-                                &pipelineInfo,
-                                nullptr,
-                                &blinnPhongPipeline) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create graphics pipeline!");
+  GraphicsPipelineDesc desc;
+  if (gpuCuller) {
+    desc.vertexShader = "gpu_driven/texture_vert.spv";
+  } else if (bindless) {
+    desc.vertexShader = "bindless/texture_vert.spv";
+  } else {
+    desc.vertexShader = "texture_vert.spv";
   }
+  if (clusteredLights) {
+    desc.fragmentShader = bindless ? "clustered/bindless_texture_frag.spv"
+                                   : "clustered/texture_frag.spv";
+  } else {
+    desc.fragmentShader =
+      bindless ? "bindless/texture_frag.spv" : "texture_frag.spv";
+    // the sizes of the light arrays, NR_POINT_LIGHTS and NR_SPOT_LIGHTS
+    desc.fragmentConstants = { MAX_POINT_LIGHTS, MAX_SPOT_LIGHTS };
+  }
+  // the gpu driven shader reads its instances from the culler's buffer
+  desc.instanceInput = !gpuCuller;
+  desc.layout = pipelineLayout;
+  desc.renderPass = renderPass;
 
-  vkDestroyShaderModule(vkContext->logicalDevice, fragShaderModule, nullptr);
-  vkDestroyShaderModule(vkContext->logicalDevice, vertShaderModule, nullptr);
+  pipeline = vkContext->pipelineRegistry->request(desc);
 }
 
 void
 BlinnPhongPass::createSkyboxPipeline(const Scene& scene)
 {
-  std::string shaderPath = SHADER_PATH;
-  auto vertShaderCode = readFile(shaderPath + "skybox_vert.spv");
-  auto fragShaderCode = readFile(shaderPath + "skybox_frag.spv");
-
-  VkShaderModule vertShaderModule =
-    vkContext->createShaderModule(vertShaderCode);
-  VkShaderModule fragShaderModule =
-    vkContext->createShaderModule(fragShaderCode);
-
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-  vertShaderStageInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-  fragShaderStageInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo,
-                                                     fragShaderStageInfo };
-
-  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-  vertexInputInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-  auto bindingDescription = Vertex::getBindingDescription();
-  auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.vertexAttributeDescriptionCount =
-    static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-  inputAssembly.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
-
   VkPushConstantRange modelPCRange{};
   modelPCRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   modelPCRange.offset = 0;
   modelPCRange.size = 64;
 
-  VkPipelineViewportStateCreateInfo viewportState{};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.scissorCount = 1;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer{};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth = 1.0f;
-  rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  rasterizer.depthBiasEnable = VK_FALSE;
-
-  VkPipelineMultisampleStateCreateInfo multisampling{};
-  multisampling.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-  VkPipelineDepthStencilStateCreateInfo depthStencil{};
-  depthStencil.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depthStencil.depthTestEnable = VK_TRUE;
-  depthStencil.depthWriteEnable = VK_TRUE;
-  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-  depthStencil.depthBoundsTestEnable = VK_FALSE;
-  depthStencil.minDepthBounds = 0.0f; // Optional
-  depthStencil.maxDepthBounds = 1.0f; // Optional
-  depthStencil.stencilTestEnable = VK_FALSE;
-  depthStencil.front = {}; // Optional
-  depthStencil.back = {};  // Optional
-
-  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-  colorBlendAttachment.colorWriteMask =
-    VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-    VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE;
-
-  VkPipelineColorBlendStateCreateInfo colorBlending{};
-  colorBlending.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.logicOp = VK_LOGIC_OP_COPY;
-  colorBlending.attachmentCount = 1;
-  colorBlending.pAttachments = &colorBlendAttachment;
-  colorBlending.blendConstants[0] = 0.0f;
-  colorBlending.blendConstants[1] = 0.0f;
-  colorBlending.blendConstants[2] = 0.0f;
-  colorBlending.blendConstants[3] = 0.0f;
-
-  std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT,
-                                                VK_DYNAMIC_STATE_SCISSOR };
-
-  VkPipelineDynamicStateCreateInfo dynamicState{};
-  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-  dynamicState.pDynamicStates = dynamicStates.data();
-
   std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts;
   descriptorSetLayouts[0] = scene.cameraUBOLayout;
   descriptorSetLayouts[1] = scene.skybox->skyboxLayout;
@@ -737,153 +570,19 @@ BlinnPhongPass::createSkyboxPipeline(const Scene& scene)
     throw std::runtime_error("failed to create pipeline layout!");
   }
 
-  VkGraphicsPipelineCreateInfo pipelineInfo{};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = shaderStages;
-  pipelineInfo.pVertexInputState = &vertexInputInfo;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterizer;
-  pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = &dynamicState;
-  pipelineInfo.layout = skyboxPipelineLayout;
-  pipelineInfo.renderPass = renderPass;
-  pipelineInfo.subpass = 0;
-  pipelineInfo.pDepthStencilState = &depthStencil;
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-  if (vkCreateGraphicsPipelines(vkContext->logicalDevice,
-                                VK_NULL_HANDLE,
-                                1,
-                                &pipelineInfo,
-                                nullptr,
-                                &skyboxPipeline) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create graphics pipeline!");
-  }
+  GraphicsPipelineDesc desc;
+  desc.vertexShader = "skybox_vert.spv";
+  desc.fragmentShader = "skybox_frag.spv";
+  desc.cullMode = VK_CULL_MODE_FRONT_BIT;
+  desc.layout = skyboxPipelineLayout;
+  desc.renderPass = renderPass;
 
-  vkDestroyShaderModule(vkContext->logicalDevice, fragShaderModule, nullptr);
-  vkDestroyShaderModule(vkContext->logicalDevice, vertShaderModule, nullptr);
+  skyboxPipeline = vkContext->pipelineRegistry->request(desc);
 }
 
 void
 BlinnPhongPass::createLightCubesPipeline(const Scene& scene)
 {
-  std::string shaderPath = SHADER_PATH;
-  auto vertShaderCode = readFile(shaderPath + "light_cube_vert.spv");
-  auto fragShaderCode = readFile(shaderPath + "light_cube_frag.spv");
-
-  VkShaderModule vertShaderModule =
-    vkContext->createShaderModule(vertShaderCode);
-  VkShaderModule fragShaderModule =
-    vkContext->createShaderModule(fragShaderCode);
-
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-  vertShaderStageInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-  fragShaderStageInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo,
-                                                     fragShaderStageInfo };
-
-  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-  vertexInputInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-  auto bindingDescription = Vertex::getBindingDescription();
-  auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.vertexAttributeDescriptionCount =
-    static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-  inputAssembly.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-  std::array<VkPushConstantRange, 2> pcRanges;
-  pcRanges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  pcRanges[0].offset = 0;
-  pcRanges[0].size = 64;
-
-  pcRanges[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-  pcRanges[1].offset = 64;
-  pcRanges[1].size = 16;
-
-  VkPipelineViewportStateCreateInfo viewportState{};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.scissorCount = 1;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer{};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth = 1.0f;
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  rasterizer.depthBiasEnable = VK_FALSE;
-
-  VkPipelineMultisampleStateCreateInfo multisampling{};
-  multisampling.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-  VkPipelineDepthStencilStateCreateInfo depthStencil{};
-  depthStencil.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depthStencil.depthTestEnable = VK_TRUE;
-  depthStencil.depthWriteEnable = VK_TRUE;
-  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-  depthStencil.depthBoundsTestEnable = VK_FALSE;
-  depthStencil.minDepthBounds = 0.0f; // Optional
-  depthStencil.maxDepthBounds = 1.0f; // Optional
-  depthStencil.stencilTestEnable = VK_FALSE;
-  depthStencil.front = {}; // Optional
-  depthStencil.back = {};  // Optional
-
-  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-  colorBlendAttachment.colorWriteMask =
-    VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-    VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE;
-
-  VkPipelineColorBlendStateCreateInfo colorBlending{};
-  colorBlending.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.logicOp = VK_LOGIC_OP_COPY;
-  colorBlending.attachmentCount = 1;
-  colorBlending.pAttachments = &colorBlendAttachment;
-  colorBlending.blendConstants[0] = 0.0f;
-  colorBlending.blendConstants[1] = 0.0f;
-  colorBlending.blendConstants[2] = 0.0f;
-  colorBlending.blendConstants[3] = 0.0f;
-
-  std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT,
-                                                VK_DYNAMIC_STATE_SCISSOR };
-
-  VkPipelineDynamicStateCreateInfo dynamicState{};
-  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-  dynamicState.pDynamicStates = dynamicStates.data();
-
   std::array<VkDescriptorSetLayout, 1> descriptorSetLayouts;
   descriptorSetLayouts[0] = scene.cameraUBOLayout;
 
@@ -892,9 +591,6 @@ BlinnPhongPass::createLightCubesPipeline(const Scene& scene)
   pipelineLayoutInfo.setLayoutCount =
     static_cast<uint32_t>(descriptorSetLayouts.size());
   pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-  pipelineLayoutInfo.pushConstantRangeCount =
-    static_cast<uint32_t>(pcRanges.size());
-  pipelineLayoutInfo.pPushConstantRanges = pcRanges.data();
 
   if (vkCreatePipelineLayout(vkContext->logicalDevice,
                              &pipelineLayoutInfo,
@@ -903,32 +599,12 @@ BlinnPhongPass::createLightCubesPipeline(const Scene& scene)
     throw std::runtime_error("failed to create pipeline layout!");
   }
 
-  VkGraphicsPipelineCreateInfo pipelineInfo{};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = shaderStages;
-  pipelineInfo.pVertexInputState = &vertexInputInfo;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterizer;
-  pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = &dynamicState;
-  pipelineInfo.layout = lightCubesPipelineLayout;
-  pipelineInfo.renderPass = renderPass;
-  pipelineInfo.subpass = 0;
-  pipelineInfo.pDepthStencilState = &depthStencil;
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-  if (vkCreateGraphicsPipelines(vkContext->logicalDevice,
-                                VK_NULL_HANDLE,
-                                1,
-                                &pipelineInfo,
-                                nullptr,
-                                &lightCubesPipeline) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create graphics pipeline!");
-  }
+  GraphicsPipelineDesc desc;
+  desc.vertexShader = "light_cube_vert.spv";
+  desc.fragmentShader = "light_cube_frag.spv";
+  desc.instanceInput = true;
+  desc.layout = lightCubesPipelineLayout;
+  desc.renderPass = renderPass;
 
-  vkDestroyShaderModule(vkContext->logicalDevice, fragShaderModule, nullptr);
-  vkDestroyShaderModule(vkContext->logicalDevice, vertShaderModule, nullptr);
+  lightCubesPipeline = vkContext->pipelineRegistry->request(desc);
 }
@@ -1,8 +1,12 @@
 #ifndef _BLINN_PHONG_PASS_H_
 #define _BLINN_PHONG_PASS_H_
 
+#include "engine/DrawList.h"
 #include "engine/Passes/IPassHelper.h"
 
+class ClusteredLights;
+class GpuCuller;
+
 class BlinnPhongPass : public IPassHelper
 {
 public:
@@ -10,7 +14,9 @@ public:
                  const std::array<AttachmentData, 16>& attachmentData,
                  const Scene& scene,
                  const uint32_t attachmentWidth,
-                 const uint32_t attachmentHeight);
+                 const uint32_t attachmentHeight,
+                 const GpuCuller* gpuCuller = nullptr,
+                 const ClusteredLights* clusteredLights = nullptr);
   ~BlinnPhongPass();
 
   void draw(VulkanSwapchain* vkSwapchain, const Scene& scene) override;
@@ -31,15 +37,35 @@ private:
   void createAttachments(uint32_t width, uint32_t height);
   void createRenderPass(std::array<AttachmentData, 16> attachmentData);
 
-  VkPipeline blinnPhongPipeline;
+  // meshes are drawn from its indirect commands when set, one by one
+  // otherwise
+  const GpuCuller* gpuCuller;
+
+  // the lights come from its clusters when set, from the fixed arrays of the
+  // scene otherwise
+  const ClusteredLights* clusteredLights;
+
+  // the batches of the scene's cameraInstances in the order they're drawn
+  DrawList drawList;
+
+  PipelineHandle blinnPhongPipeline;
   VkPipelineLayout blinnPhongPipelineLayout;
-  void createMainPipeline(const Scene& scene);
+  // with bindless textures, for the frames that draw a mesh whose textures
+  // didn't fit into the array. binds the sets of the meshes like without
+  PipelineHandle perMeshPipeline;
+  VkPipelineLayout perMeshPipelineLayout = VK_NULL_HANDLE;
+  void createMainPipeline(const Scene& scene,
+                          bool bindless,
+                          PipelineHandle& pipeline,
+                          VkPipelineLayout& pipelineLayout);
+  // whether every mesh drawn this frame has a bindless material
+  bool hasMaterials(const Scene& scene) const;
 
-  VkPipeline skyboxPipeline;
+  PipelineHandle skyboxPipeline;
   VkPipelineLayout skyboxPipelineLayout;
   void createSkyboxPipeline(const Scene& scene);
 
-  VkPipeline lightCubesPipeline;
+  PipelineHandle lightCubesPipeline;
   VkPipelineLayout lightCubesPipelineLayout;
   void createLightCubesPipeline(const Scene& scene);
 };
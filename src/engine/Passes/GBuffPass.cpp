@@ -1,11 +1,15 @@
 #include "engine/Passes/GBuffPass.h"
+#include "engine/GpuCuller.h"
 
 GBuffPass::GBuffPass(VulkanContext* vkContext,
                      const std::array<AttachmentData, 16>& attachmentData,
                      const Scene& scene,
                      const uint32_t attachmentWidth,
-                     const uint32_t attachmentHeight)
+                     const uint32_t attachmentHeight,
+                     const GpuCuller* gpuCuller)
   : IPassHelper(vkContext, scene)
+  , gpuCuller(gpuCuller)
+  , drawList(vkContext)
 {
   createAttachments(attachmentWidth, attachmentHeight);
 
@@ -20,7 +24,6 @@ GBuffPass::~GBuffPass()
 {
   vkDestroyRenderPass(vkContext->logicalDevice, renderPass, nullptr);
 
-  vkDestroyPipeline(vkContext->logicalDevice, gbufferPipeline, nullptr);
   vkDestroyPipelineLayout(
     vkContext->logicalDevice, gbufferPipelineLayout, nullptr);
 
@@ -35,13 +38,8 @@ GBuffPass::~GBuffPass()
 void
 GBuffPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
 {
-  /*TODO: implement Sascha Willem's optimization: we can draw similar meshes
-   with the vkCmdDrawIndexed() and just do all of them at once ^^. BUT: we would
-   have to modify the shaders slightly:
-             - vec4 tmpPos = inPos + ubo.instancePos[gl_InstanceIndex];
-
-   we would employ the index for accessing the vertices. maybe try that someday
-   */
+  // every model lives in the geometry arena, bind it once for the whole pass
+  vkContext->geometryArena->bind(vkSwapchain->commandBuffer);
 
   VkRenderPassBeginInfo renderPassInfo{};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -65,7 +63,7 @@ GBuffPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
   // -------------------- bind main pipeline --------------------
   vkCmdBindPipeline(vkSwapchain->commandBuffer,
                     VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    gbufferPipeline);
+                    gbufferPipeline.get());
 
   VkViewport viewport{};
   viewport.x = 0.0f;
@@ -87,49 +85,57 @@ GBuffPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
                           0,
                           1,
                           &scene.cameraUBODescriptorset,
-                          0,
-                          nullptr);
-
-  struct PushConstant
-  {
-    glm::mat4 model;
-  };
-
-  for (auto& model : scene.models) {
-
-    VkBuffer vertexBuffers[] = { model.vertexBuffer };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(
-      vkSwapchain->commandBuffer, 0, 1, vertexBuffers, offsets);
-
-    vkCmdBindIndexBuffer(
-      vkSwapchain->commandBuffer, model.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+                          1,
+                          &scene.cameraUBOOffset);
 
-    for (const auto& instance : model.meshInstances) {
-      PushConstant pc;
-      pc.model = instance.transformation;
-      vkCmdPushConstants(vkSwapchain->commandBuffer,
-                         gbufferPipelineLayout,
-                         VK_SHADER_STAGE_VERTEX_BIT,
-                         0,
-                         64,
-                         &pc);
+  if (gpuCuller) {
+    // a single indirect draw per mesh, it still binds its own textures
+    gpuCuller->bind(vkSwapchain->commandBuffer, gbufferPipelineLayout, 2);
 
+    const std::vector<const Mesh*>& meshes = gpuCuller->getMeshes();
+    for (uint32_t i = 0; i < meshes.size(); i++) {
       vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
                               VK_PIPELINE_BIND_POINT_GRAPHICS,
                               gbufferPipelineLayout,
                               1,
                               1,
-                              &instance.mesh->descriptorSet,
+                              &meshes[i]->descriptorSet,
                               0,
                               nullptr);
-
-      vkCmdDrawIndexed(vkSwapchain->commandBuffer,
-                       instance.mesh->indexCount,
-                       1,
-                       instance.mesh->startIndex,
-                       0,
-                       0);
+      gpuCuller->drawMesh(vkSwapchain->commandBuffer, i);
+    }
+  } else {
+    // every mesh and level of detail is one instanced draw, the model
+    // matrices come from the instance buffer the scene filled. sorted by
+    // mesh so its textures are bound once, nearest first
+    const std::vector<InstanceBatch>& batches =
+      scene.cameraInstances.getBatches();
+    drawList.reset(static_cast<uint32_t>(batches.size()));
+    for (uint32_t i = 0; i < batches.size(); i++) {
+      drawList.add(
+        DrawList::makeKey(
+          DRAW_PASS_GBUFFER, 0, batches[i].mesh->id, 0, batches[i].depth),
+        i);
+    }
+    drawList.sort();
+
+    scene.cameraInstances.bind(vkSwapchain->commandBuffer);
+
+    VkDescriptorSet boundSet = VK_NULL_HANDLE;
+    for (const DrawPacket& packet : drawList) {
+      const InstanceBatch& batch = batches[packet.index];
+      if (batch.mesh->descriptorSet != boundSet) {
+        boundSet = batch.mesh->descriptorSet;
+        vkCmdBindDescriptorSets(vkSwapchain->commandBuffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                gbufferPipelineLayout,
+                                1,
+                                1,
+                                &boundSet,
+                                0,
+                                nullptr);
+      }
+      scene.cameraInstances.draw(vkSwapchain->commandBuffer, batch);
     }
   }
 
@@ -348,132 +354,19 @@ GBuffPass::createRenderPass(std::array<AttachmentData, 16> attachmentData)
 void
 GBuffPass::createGBufferPipeline(const Scene& scene)
 {
-  std::string shaderPath = SHADER_PATH;
-  auto vertShaderCode = readFile(shaderPath + "gbuffer_vert.spv");
-  auto fragShaderCode = readFile(shaderPath + "gbuffer_frag.spv");
-
-  VkShaderModule vertShaderModule =
-    vkContext->createShaderModule(vertShaderCode);
-  VkShaderModule fragShaderModule =
-    vkContext->createShaderModule(fragShaderCode);
-
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-  vertShaderStageInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-  fragShaderStageInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo,
-                                                     fragShaderStageInfo };
-
-  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-  vertexInputInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-  auto bindingDescription = Vertex::getBindingDescription();
-  auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.vertexAttributeDescriptionCount =
-    static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-  inputAssembly.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-  VkPushConstantRange modelPCRange{};
-  modelPCRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  modelPCRange.offset = 0;
-  modelPCRange.size = 64;
-
-  VkPipelineViewportStateCreateInfo viewportState{};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.scissorCount = 1;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer{};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth = 1.0f;
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  rasterizer.depthBiasEnable = VK_FALSE;
-
-  VkPipelineMultisampleStateCreateInfo multisampling{};
-  multisampling.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-  VkPipelineDepthStencilStateCreateInfo depthStencil{};
-  depthStencil.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depthStencil.depthTestEnable = VK_TRUE;
-  depthStencil.depthWriteEnable = VK_TRUE;
-  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-  depthStencil.depthBoundsTestEnable = VK_FALSE;
-  depthStencil.minDepthBounds = 0.0f; // Optional
-  depthStencil.maxDepthBounds = 1.0f; // Optional
-  depthStencil.stencilTestEnable = VK_FALSE;
-  depthStencil.front = {}; // Optional
-  depthStencil.back = {};  // Optional
-
-  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-  colorBlendAttachment.colorWriteMask =
-    VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-    VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE;
-
-  std::array<VkPipelineColorBlendAttachmentState, 3> blendAttachmentStates = {
-    colorBlendAttachment, colorBlendAttachment, colorBlendAttachment
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts = {
+    scene.cameraUBOLayout, Model::textureLayout
   };
-
-  VkPipelineColorBlendStateCreateInfo colorBlending{};
-  colorBlending.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.logicOp = VK_LOGIC_OP_COPY;
-  colorBlending.attachmentCount =
-    static_cast<uint32_t>(blendAttachmentStates.size());
-  colorBlending.pAttachments = blendAttachmentStates.data();
-  colorBlending.blendConstants[0] = 0.0f;
-  colorBlending.blendConstants[1] = 0.0f;
-  colorBlending.blendConstants[2] = 0.0f;
-  colorBlending.blendConstants[3] = 0.0f;
-
-  std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT,
-                                                VK_DYNAMIC_STATE_SCISSOR };
-
-  VkPipelineDynamicStateCreateInfo dynamicState{};
-  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-  dynamicState.pDynamicStates = dynamicStates.data();
-
-  std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts;
-  descriptorSetLayouts[0] = scene.cameraUBOLayout;
-  descriptorSetLayouts[1] = Model::textureLayout;
+  // the instances the indirect draws index into
+  if (gpuCuller) {
+    descriptorSetLayouts.push_back(gpuCuller->getDescriptorSetLayout());
+  }
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount =
     static_cast<uint32_t>(descriptorSetLayouts.size());
   pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &modelPCRange;
 
   if (vkCreatePipelineLayout(vkContext->logicalDevice,
                              &pipelineLayoutInfo,
@@ -482,32 +375,15 @@ GBuffPass::createGBufferPipeline(const Scene& scene)
     throw std::runtime_error("failed to create pipeline layout!");
   }
 
-  VkGraphicsPipelineCreateInfo pipelineInfo{};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = shaderStages;
-  pipelineInfo.pVertexInputState = &vertexInputInfo;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterizer;
-  pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = &dynamicState;
-  pipelineInfo.layout = gbufferPipelineLayout;
-  pipelineInfo.renderPass = renderPass;
-  pipelineInfo.subpass = 0;
-  pipelineInfo.pDepthStencilState = &depthStencil;
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-  if (vkCreateGraphicsPipelines(vkContext->logicalDevice,
-                                VK_NULL_HANDLE,
-                                1,
-                                &pipelineInfo,
-                                nullptr,
-                                &gbufferPipeline) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create graphics pipeline!");
-  }
-
-  vkDestroyShaderModule(vkContext->logicalDevice, fragShaderModule, nullptr);
-  vkDestroyShaderModule(vkContext->logicalDevice, vertShaderModule, nullptr);
+  GraphicsPipelineDesc desc;
+  desc.vertexShader =
+    gpuCuller ? "gpu_driven/gbuffer_vert.spv" : "gbuffer_vert.spv";
+  desc.fragmentShader = "gbuffer_frag.spv";
+  desc.colorAttachmentCount = 3;
+  // the gpu driven shader reads its instances from the culler's buffer
+  desc.instanceInput = !gpuCuller;
+  desc.layout = gbufferPipelineLayout;
+  desc.renderPass = renderPass;
+
+  gbufferPipeline = vkContext->pipelineRegistry->request(desc);
 }
@@ -2,10 +2,13 @@
 #define _GBUFF_PASS_H_
 
 #include "engine/FramebufferAttachment.h"
+#include "engine/DrawList.h"
 #include "engine/Passes/IPassHelper.h"
 
 #include "engine/Vertex.h"
 
+class GpuCuller;
+
 class GBuffPass : public IPassHelper
 {
 public:
@@ -13,7 +16,8 @@ public:
             const std::array<AttachmentData, 16>& attachmentData,
             const Scene& scene,
             const uint32_t attachmentWidth,
-            const uint32_t attachmentHeight);
+            const uint32_t attachmentHeight,
+            const GpuCuller* gpuCuller = nullptr);
   ~GBuffPass();
 
   void draw(VulkanSwapchain* vkSwapchain, const Scene& scene) override;
@@ -37,7 +41,14 @@ private:
   void createAttachments(uint32_t width, uint32_t height);
   void createRenderPass(std::array<AttachmentData, 16> attachmentData);
 
-  VkPipeline gbufferPipeline;
+  // meshes are drawn from its indirect commands when set, one by one
+  // otherwise
+  const GpuCuller* gpuCuller;
+
+  // the batches of the scene's cameraInstances in the order they're drawn
+  DrawList drawList;
+
+  PipelineHandle gbufferPipeline;
   VkPipelineLayout gbufferPipelineLayout;
   void createGBufferPipeline(const Scene& scene);
 };
@@ -42,19 +42,19 @@ private:
   VkDescriptorSet verticalBloomDescriptorSet;
   void createDescriptors();
 
-  VkPipeline brightPointExtractionPipeline;
+  PipelineHandle brightPointExtractionPipeline;
   VkPipelineLayout brightPointExtractionPipelineLayout;
   void createBrightPointExtractionPipeline();
 
-  VkPipeline horizontalBloomPipeline;
+  PipelineHandle horizontalBloomPipeline;
   VkPipelineLayout horizontalBloomPipelineLayout;
   void createHorizontalBloomPipeline();
 
-  VkPipeline verticalBloomPipeline;
+  PipelineHandle verticalBloomPipeline;
   VkPipelineLayout verticalBloomPipelineLayout;
   void createVerticalBloomPipeline();
 
-  VkPipeline compositionPipeline;
+  PipelineHandle compositionPipeline;
   VkPipelineLayout compositionPipelineLayout;
   void createCompositionPipeline();
 };
@@ -37,15 +37,15 @@ private:
   VkDescriptorSet gbufferDescriptorSet;
   void createDescriptors();
 
-  VkPipeline blinnPhongPipeline;
+  PipelineHandle blinnPhongPipeline;
   VkPipelineLayout blinnPhongPipelineLayout;
   void createMainPipeline(const Scene& scene);
 
-  VkPipeline skyboxPipeline;
+  PipelineHandle skyboxPipeline;
   VkPipelineLayout skyboxPipelineLayout;
   void createSkyboxPipeline(const Scene& scene);
 
-  VkPipeline lightCubesPipeline;
+  PipelineHandle lightCubesPipeline;
   VkPipelineLayout lightCubesPipelineLayout;
   void createLightCubesPipeline(const Scene& scene);
 };
@@ -1,6 +1,9 @@
 #include "engine/Passes/ShadowMapPass.h"
 
+#include "engine/GpuCuller.h"
+
 #include "engine/Lights.h"
+#include "engine/Profiler.h"
 #include "engine/Scene.h"
 #include "engine/Vertex.h"
 
@@ -9,8 +12,12 @@ ShadowMapPass::ShadowMapPass(
   const std::array<AttachmentData, 16>& attachmentData,
   const Scene& scene,
   const uint32_t shadowMapWidth,
-  const uint32_t shadowMapHeight)
+  const uint32_t shadowMapHeight,
+  const GpuCuller* gpuCuller)
   : IPassHelper(vkContext, scene)
+  , casters(vkContext)
+  , casterDraws(vkContext)
+  , gpuCuller(gpuCuller)
   , shadowMapWidth(shadowMapWidth)
   , shadowMapHeight(shadowMapHeight)
 {
@@ -32,7 +39,6 @@ ShadowMapPass::~ShadowMapPass()
 
   vkDestroyRenderPass(vkContext->logicalDevice, shadowMapRenderPass, nullptr);
 
-  vkDestroyPipeline(vkContext->logicalDevice, shadowMapPipeline, nullptr);
   vkDestroyPipelineLayout(
     vkContext->logicalDevice, shadowMapPipelineLayout, nullptr);
 
@@ -78,7 +84,18 @@ ShadowMapPass::createShadowMaps(uint32_t width, uint32_t height)
 void
 ShadowMapPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
 {
+  // every model lives in the geometry arena, bind it once for the whole pass
+  vkContext->geometryArena->bind(vkSwapchain->commandBuffer);
+
+  // the instances stay bound across both render passes
+  shadowView = 0;
+  if (gpuCuller) {
+    gpuCuller->bind(vkSwapchain->commandBuffer, shadowMapPipelineLayout, 0);
+  }
+
   // directional shadow
+  vkContext->profiler->beginGpuScope(vkSwapchain->commandBuffer,
+                                     "directional shadow");
   if (scene.directionalLight->castsShadow()) {
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -99,7 +116,7 @@ ShadowMapPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
     // -------------------- bind main pipeline --------------------
     vkCmdBindPipeline(vkSwapchain->commandBuffer,
                       VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      shadowMapPipeline);
+                      shadowMapPipeline.get());
 
     VkViewport viewport{};
     viewport.x = 0.0f;
@@ -121,41 +138,14 @@ ShadowMapPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
     // vkCmdSetDepthBias(vkSwapchain->commandBuffer, 1.5f, 0.0f, 2.0f);
     // vkCmdSetDepthBias(vkSwapchain->commandBuffer, 1.25f, 0.0f, 1.75f);
 
-    struct PushConstant
-    {
-      glm::mat4 lightSpaceMatrix;
-    };
-
-    for (auto& model : scene.models) {
-
-      VkBuffer vertexBuffers[] = { model.vertexBuffer };
-      VkDeviceSize offsets[] = { 0 };
-      vkCmdBindVertexBuffers(
-        vkSwapchain->commandBuffer, 0, 1, vertexBuffers, offsets);
-
-      vkCmdBindIndexBuffer(
-        vkSwapchain->commandBuffer, model.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-      for (const auto& instance : model.meshInstances) {
-        PushConstant pc;
-        pc.lightSpaceMatrix =
-          scene.directionalLight->getTransform() * instance.transformation;
-
-        vkCmdPushConstants(vkSwapchain->commandBuffer,
-                           shadowMapPipelineLayout,
-                           VK_SHADER_STAGE_VERTEX_BIT,
-                           0,
-                           64,
-                           &pc);
-
-        vkCmdDrawIndexed(vkSwapchain->commandBuffer,
-                         instance.mesh->indexCount,
-                         1,
-                         instance.mesh->startIndex,
-                         0,
-                         0);
-      }
+    uint32_t draws = drawCasters(vkSwapchain->commandBuffer,
+                                 scene,
+                                 scene.directionalLight->getTransform());
+    // the gpu culler's draw counts never come back to the cpu
+    if (!gpuCuller) {
+      vkContext->profiler->addCounter("shadow draws/directional", draws);
     }
+
     vkCmdEndRenderPass(vkSwapchain->commandBuffer);
   } else {
     // this is imprtant! we still have to transition the image layout even tho
@@ -177,6 +167,7 @@ ShadowMapPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
       vkSwapchain->commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
     vkCmdEndRenderPass(vkSwapchain->commandBuffer);
   }
+  vkContext->profiler->endGpuScope(vkSwapchain->commandBuffer);
 
   // spotlight and pointlight shadows
   {
@@ -199,14 +190,19 @@ ShadowMapPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
     // -------------------- bind main pipeline --------------------
     vkCmdBindPipeline(vkSwapchain->commandBuffer,
                       VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      shadowMapPipeline);
+                      shadowMapPipeline.get());
 
-    for (const auto& spotlight : scene.spotLights) {
+    for (size_t spotIndex = 0; spotIndex < scene.spotLights.size();
+         spotIndex++) {
+      const SpotLight& spotlight = scene.spotLights[spotIndex];
 
       if (!spotlight.castsShadow()) {
         continue;
       }
 
+      GpuProfileScope tileScope(
+        vkContext->profiler, vkSwapchain->commandBuffer, "spot atlas tile");
+
       VkViewport viewport{};
       viewport.x = spotlight.getAtlasCoordinatesPixel().x;
       viewport.y = spotlight.getAtlasCoordinatesPixel().y;
@@ -227,52 +223,30 @@ ShadowMapPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
       // vkCmdSetDepthBias(vkSwapchain->commandBuffer, 1.5f, 0.0f, 2.0f);
       // vkCmdSetDepthBias(vkSwapchain->commandBuffer, 1.25f, 0.0f, 1.75f);
 
-      struct PushConstant
-      {
-        glm::mat4 lightSpaceMatrix;
-      };
-
-      for (auto& model : scene.models) {
-
-        VkBuffer vertexBuffers[] = { model.vertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(
-          vkSwapchain->commandBuffer, 0, 1, vertexBuffers, offsets);
-
-        vkCmdBindIndexBuffer(vkSwapchain->commandBuffer,
-                             model.indexBuffer,
-                             0,
-                             VK_INDEX_TYPE_UINT32);
-
-        for (const auto& instance : model.meshInstances) {
-          PushConstant pc;
-          pc.lightSpaceMatrix =
-            spotlight.getTransform() * instance.transformation;
-
-          vkCmdPushConstants(vkSwapchain->commandBuffer,
-                             shadowMapPipelineLayout,
-                             VK_SHADER_STAGE_VERTEX_BIT,
-                             0,
-                             64,
-                             &pc);
-
-          vkCmdDrawIndexed(vkSwapchain->commandBuffer,
-                           instance.mesh->indexCount,
-                           1,
-                           instance.mesh->startIndex,
-                           0,
-                           0);
-        }
+      uint32_t draws = drawCasters(
+        vkSwapchain->commandBuffer, scene, spotlight.getTransform());
+      if (!gpuCuller) {
+        vkContext->profiler->addCounter(
+          "shadow draws/spot " + std::to_string(spotIndex), draws);
       }
     }
-    for (const auto& pointlight : scene.pointLights) {
+    for (size_t pointIndex = 0; pointIndex < scene.pointLights.size();
+         pointIndex++) {
+      const PointLight& pointlight = scene.pointLights[pointIndex];
+
       if (!pointlight.castsShadow()) {
         continue;
       }
 
+      // one number per light, summed over its six faces
+      uint32_t pointDraws = 0;
+
       for (int i = 0; i <= PointLight::BACK; i++) {
         PointLight::Side side = static_cast<PointLight::Side>(i);
 
+        GpuProfileScope tileScope(
+          vkContext->profiler, vkSwapchain->commandBuffer, "point atlas tile");
+
         VkViewport viewport{};
         viewport.x = pointlight.getAtlasCoordinatesPixel(side).x;
         viewport.y = pointlight.getAtlasCoordinatesPixel(side).y;
@@ -293,43 +267,13 @@ ShadowMapPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
         // vkCmdSetDepthBias(vkSwapchain->commandBuffer, 1.5f, 0.0f, 2.0f);
         // vkCmdSetDepthBias(vkSwapchain->commandBuffer, 1.25f, 0.0f, 1.75f);
 
-        struct PushConstant
-        {
-          glm::mat4 lightSpaceMatrix;
-        };
-
-        for (auto& model : scene.models) {
-
-          VkBuffer vertexBuffers[] = { model.vertexBuffer };
-          VkDeviceSize offsets[] = { 0 };
-          vkCmdBindVertexBuffers(
-            vkSwapchain->commandBuffer, 0, 1, vertexBuffers, offsets);
-
-          vkCmdBindIndexBuffer(vkSwapchain->commandBuffer,
-                               model.indexBuffer,
-                               0,
-                               VK_INDEX_TYPE_UINT32);
-
-          for (const auto& instance : model.meshInstances) {
-            PushConstant pc;
-            pc.lightSpaceMatrix =
-              pointlight.getTransform(side) * instance.transformation;
-
-            vkCmdPushConstants(vkSwapchain->commandBuffer,
-                               shadowMapPipelineLayout,
-                               VK_SHADER_STAGE_VERTEX_BIT,
-                               0,
-                               64,
-                               &pc);
-
-            vkCmdDrawIndexed(vkSwapchain->commandBuffer,
-                             instance.mesh->indexCount,
-                             1,
-                             instance.mesh->startIndex,
-                             0,
-                             0);
-          }
-        }
+        pointDraws += drawCasters(
+          vkSwapchain->commandBuffer, scene, pointlight.getTransform(side));
+      }
+
+      if (!gpuCuller) {
+        vkContext->profiler->addCounter(
+          "shadow draws/point " + std::to_string(pointIndex), pointDraws);
       }
     }
 
@@ -337,6 +281,68 @@ ShadowMapPass::draw(VulkanSwapchain* vkSwapchain, const Scene& scene)
   }
 }
 
+uint32_t
+ShadowMapPass::drawCasters(VkCommandBuffer commandBuffer,
+                           const Scene& scene,
+                           const glm::mat4& lightSpaceMatrix)
+{
+  struct PushConstant
+  {
+    glm::mat4 lightSpaceMatrix;
+  };
+
+  // the model matrices come with the instances either way
+  PushConstant pc;
+  pc.lightSpaceMatrix = lightSpaceMatrix;
+  vkCmdPushConstants(commandBuffer,
+                     shadowMapPipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT,
+                     0,
+                     64,
+                     &pc);
+
+  if (gpuCuller) {
+    gpuCuller->drawShadowView(commandBuffer, shadowView++);
+    return 0;
+  }
+
+  // the scene already holds the box of every instance, a caster outside the
+  // light's frustum would be clipped away entirely so it's never drawn
+  scene.culler.cull(lightSpaceMatrix, visibleCasters);
+
+  casters.clear();
+  for (uint32_t index : visibleCasters) {
+    const MeshInstance* instance = scene.instances[index];
+    // depth of the center of the box as the light sees it
+    glm::vec3 center = 0.5f * (instance->worldMin + instance->worldMax);
+    glm::vec4 clip = lightSpaceMatrix * glm::vec4(center, 1.0f);
+    casters.add(instance->mesh,
+                instance->mesh->selectLod(instance->transformation,
+                                          scene.shadowLodSelector),
+                instance->transformation,
+                clip.w > 0.0f ? clip.z / clip.w : 0.0f);
+  }
+  casters.upload();
+
+  // no textures are bound here, only the depth orders the draws. every view
+  // has at most one batch per instance of the scene, sized for that the list
+  // takes its room from the arena once per frame and not once per view
+  const std::vector<InstanceBatch>& batches = casters.getBatches();
+  casterDraws.reset(static_cast<uint32_t>(scene.instances.size()));
+  for (uint32_t i = 0; i < batches.size(); i++) {
+    casterDraws.add(
+      DrawList::makeKey(DRAW_PASS_SHADOW, 0, 0, 0, batches[i].depth), i);
+  }
+  casterDraws.sort();
+
+  casters.bind(commandBuffer);
+  for (const DrawPacket& packet : casterDraws) {
+    casters.draw(commandBuffer, batches[packet.index]);
+  }
+
+  return static_cast<uint32_t>(casters.getBatches().size());
+}
+
 void
 ShadowMapPass::createFrameBuffers(std::array<AttachmentData, 16> attachmentData)
 {
@@ -504,92 +510,19 @@ ShadowMapPass::createDirectionalRenderPass(
 void
 ShadowMapPass::createShadowMapPipeline()
 {
-  std::string shaderPath = SHADER_PATH;
-  auto vertShaderCode =
-    readFile(shaderPath + "shadows/directional_shadow_vert.spv");
-
-  VkShaderModule vertShaderModule =
-    vkContext->createShaderModule(vertShaderCode);
-
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-  vertShaderStageInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-  vertexInputInfo.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-  auto bindingDescription = Vertex::getBindingDescription();
-  auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.vertexAttributeDescriptionCount =
-    static_cast<uint32_t>(attributeDescriptions.size());
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-  inputAssembly.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
-
   VkPushConstantRange lightSpaceMatrixPCRange{};
   lightSpaceMatrixPCRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   lightSpaceMatrixPCRange.offset = 0;
   lightSpaceMatrixPCRange.size = 64;
 
-  VkPipelineViewportStateCreateInfo viewportState{};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.scissorCount = 1;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer{};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth = 1.0f;
-  rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  rasterizer.depthBiasEnable = VK_TRUE;
-
-  VkPipelineMultisampleStateCreateInfo multisampling{};
-  multisampling.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-  VkPipelineDepthStencilStateCreateInfo depthStencil{};
-  depthStencil.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depthStencil.depthTestEnable = VK_TRUE;
-  depthStencil.depthWriteEnable = VK_TRUE;
-  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-
-  VkPipelineColorBlendStateCreateInfo colorBlending{};
-  colorBlending.sType =
-    VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable = VK_FALSE;
-
-  // std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT,
-  //                                               VK_DYNAMIC_STATE_SCISSOR,
-  //                                               VK_DYNAMIC_STATE_DEPTH_BIAS
-  //                                               };
-  std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT,
-                                                VK_DYNAMIC_STATE_SCISSOR };
-
-  VkPipelineDynamicStateCreateInfo dynamicState{};
-  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-  dynamicState.pDynamicStates = dynamicStates.data();
+  // the instances the indirect draws index into
+  VkDescriptorSetLayout instanceLayout =
+    gpuCuller ? gpuCuller->getDescriptorSetLayout() : VK_NULL_HANDLE;
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 0;
+  pipelineLayoutInfo.setLayoutCount = gpuCuller ? 1 : 0;
+  pipelineLayoutInfo.pSetLayouts = &instanceLayout;
   pipelineLayoutInfo.pushConstantRangeCount = 1;
   pipelineLayoutInfo.pPushConstantRanges = &lightSpaceMatrixPCRange;
 
@@ -600,31 +533,16 @@ ShadowMapPass::createShadowMapPipeline()
     throw std::runtime_error("failed to create pipeline layout!");
   }
 
-  VkGraphicsPipelineCreateInfo pipelineInfo{};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 1;
-  pipelineInfo.pStages = &vertShaderStageInfo;
-  pipelineInfo.pVertexInputState = &vertexInputInfo;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterizer;
-  pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = &dynamicState;
-  pipelineInfo.layout = shadowMapPipelineLayout;
-  pipelineInfo.renderPass = shadowMapRenderPass;
-  pipelineInfo.subpass = 0;
-  pipelineInfo.pDepthStencilState = &depthStencil;
-  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-  if (vkCreateGraphicsPipelines(vkContext->logicalDevice,
-                                VK_NULL_HANDLE,
-                                1,
-                                &pipelineInfo,
-                                nullptr,
-                                &shadowMapPipeline) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create graphics pipeline!");
-  }
-
-  vkDestroyShaderModule(vkContext->logicalDevice, vertShaderModule, nullptr);
+  GraphicsPipelineDesc desc;
+  desc.vertexShader = gpuCuller ? "gpu_driven/directional_shadow_vert.spv"
+                                : "shadows/directional_shadow_vert.spv";
+  // the gpu driven shader reads its instances from the culler's buffer
+  desc.instanceInput = !gpuCuller;
+  desc.cullMode = VK_CULL_MODE_FRONT_BIT;
+  desc.depthBias = true;
+  desc.colorAttachmentCount = 0;
+  desc.layout = shadowMapPipelineLayout;
+  desc.renderPass = shadowMapRenderPass;
+
+  shadowMapPipeline = vkContext->pipelineRegistry->request(desc);
 }
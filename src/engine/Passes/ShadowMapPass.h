@@ -1,9 +1,13 @@
 #ifndef _SHADOW_MAP_PASS_H_
 #define _SHADOW_MAP_PASS_H_
 
+#include "engine/DrawList.h"
 #include "engine/FramebufferAttachment.h"
+#include "engine/InstanceBatcher.h"
 #include "engine/Passes/IPassHelper.h"
 
+class GpuCuller;
+
 class ShadowMapPass : public IPassHelper
 {
 public:
@@ -11,7 +15,8 @@ public:
                 const std::array<AttachmentData, 16>& attachmentData,
                 const Scene& scene,
                 const uint32_t shadowMapWidth,
-                const uint32_t shadowMapHeight);
+                const uint32_t shadowMapHeight,
+                const GpuCuller* gpuCuller = nullptr);
   ~ShadowMapPass();
 
   void draw(VulkanSwapchain* vkSwapchain, const Scene& scene) override;
@@ -39,10 +44,29 @@ private:
     std::array<AttachmentData, 16> attachmentData);
   // void createSpotRenderPass(std::array<AttachmentData, 16> attachmentData);
 
-  VkPipeline shadowMapPipeline;
+  PipelineHandle shadowMapPipeline;
   VkPipelineLayout shadowMapPipelineLayout;
   void createShadowMapPipeline();
 
+  // draws the instances of the scene that touch the frustum of
+  // lightSpaceMatrix with the bound shadow pipeline, instanced by mesh.
+  // returns how many draws that took. with the gpu culler it draws its next
+  // shadow view instead, the number isn't known on the cpu then and it
+  // returns 0
+  uint32_t drawCasters(VkCommandBuffer commandBuffer,
+                       const Scene& scene,
+                       const glm::mat4& lightSpaceMatrix);
+  std::vector<uint32_t> visibleCasters;
+  // reused for every light view, each one uploads its own instances
+  InstanceBatcher casters;
+  // the casters nearest to the light first, the depth test rejects more of
+  // what's behind them
+  DrawList casterDraws;
+
+  const GpuCuller* gpuCuller;
+  // the GpuCuller view drawCasters draws next, reset every frame
+  uint32_t shadowView = 0;
+
   // VkPipeline spotShadowMapPipeline;
   // VkPipelineLayout spotShadowMapPipelineLayout;
   // void createSpotShadowMapPipeline();
@@ -0,0 +1,127 @@
+#include "engine/PipelineCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+PipelineCache::PipelineCache(VulkanContext* vkContext,
+                             const std::string& directory)
+  : vkContext(vkContext)
+{
+  const VkPhysicalDeviceProperties& properties = vkContext->deviceProperties;
+
+  std::ostringstream name;
+  name << std::hex << std::setfill('0') << "pipeline_cache_" << std::setw(4)
+       << properties.vendorID << "_" << std::setw(4) << properties.deviceID
+       << "_" << std::setw(8) << properties.driverVersion << "_";
+  for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+    uint32_t byte = properties.pipelineCacheUUID[i];
+    name << std::setw(2) << byte;
+  }
+  name << ".bin";
+  filePath = directory + name.str();
+
+  std::vector<char> data;
+  std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+  if (file.is_open()) {
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+    if (!file || !isValid(data)) {
+      std::cout << "ignoring pipeline cache " << filePath << std::endl;
+      data.clear();
+    }
+  }
+
+  VkPipelineCacheCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = data.size();
+  createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+  if (vkCreatePipelineCache(
+        vkContext->logicalDevice, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+  loadedSize = data.size();
+
+  if (isWarm()) {
+    std::cout << "pipeline cache: warm, " << loadedSize << " bytes from "
+              << filePath << std::endl;
+  } else {
+    std::cout << "pipeline cache: cold" << std::endl;
+  }
+}
+
+PipelineCache::~PipelineCache()
+{
+  save();
+  vkDestroyPipelineCache(vkContext->logicalDevice, cache, nullptr);
+}
+
+void
+PipelineCache::save()
+{
+  size_t size = 0;
+  if (vkGetPipelineCacheData(
+        vkContext->logicalDevice, cache, &size, nullptr) != VK_SUCCESS ||
+      size == 0) {
+    return;
+  }
+
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(
+        vkContext->logicalDevice, cache, &size, data.data()) != VK_SUCCESS) {
+    return;
+  }
+
+  // written next to it first, a run killed halfway through a write would
+  // otherwise leave a truncated cache behind
+  std::string tempPath = filePath + ".tmp";
+  {
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), size);
+    if (!out) {
+      std::cout << "failed to write pipeline cache " << tempPath << std::endl;
+      return;
+    }
+  }
+
+  std::remove(filePath.c_str());
+  if (std::rename(tempPath.c_str(), filePath.c_str()) != 0) {
+    std::cout << "failed to write pipeline cache " << filePath << std::endl;
+  }
+}
+
+bool
+PipelineCache::isValid(const std::vector<char>& data) const
+{
+  // VkPipelineCacheHeaderVersionOne, read field by field
+  struct Header
+  {
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+  };
+
+  Header header;
+  if (data.size() < sizeof(Header)) {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof(Header));
+
+  const VkPhysicalDeviceProperties& properties = vkContext->deviceProperties;
+  return header.headerSize >= sizeof(Header) &&
+         header.headerSize <= data.size() &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         memcmp(header.pipelineCacheUUID,
+                properties.pipelineCacheUUID,
+                VK_UUID_SIZE) == 0;
+}
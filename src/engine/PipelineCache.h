@@ -0,0 +1,51 @@
+#ifndef _PIPELINE_CACHE_H_
+#define _PIPELINE_CACHE_H_
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "engine/VulkanContext.h"
+
+// where the pipeline cache files are kept, one per gpu and driver
+#ifndef PIPELINE_CACHE_PATH
+#define PIPELINE_CACHE_PATH "./"
+#endif
+
+// a VkPipelineCache every pass creates its pipelines through, so compiled
+// pipelines survive between runs. loaded at startup from a file named after
+// the vendor, device, driver version and pipelineCacheUUID, and written back
+// when it's destroyed.
+//
+// a file whose header doesn't match the current device is ignored (drivers
+// are supposed to reject those on their own, some just crash instead)
+class PipelineCache
+{
+public:
+  PipelineCache(VulkanContext* vkContext, const std::string& directory);
+  ~PipelineCache();
+
+  PipelineCache(const PipelineCache&) = delete;
+  PipelineCache& operator=(const PipelineCache&) = delete;
+
+  VkPipelineCache get() const { return cache; }
+
+  // true if the cache started out with data from a previous run
+  bool isWarm() const { return loadedSize > 0; }
+  size_t getLoadedSize() const { return loadedSize; }
+
+  void save();
+
+private:
+  VulkanContext* vkContext;
+
+  std::string filePath;
+  VkPipelineCache cache = VK_NULL_HANDLE;
+  size_t loadedSize = 0;
+
+  bool isValid(const std::vector<char>& data) const;
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "engine/PipelineRegistry.h"
+
+#include "engine/JobSystem.h"
+#include "engine/PipelineCache.h"
+#include "engine/ShaderLibrary.h"
+#include "engine/Vertex.h"
+
+#include <array>
+#include <functional>
+#include <stdexcept>
+
+PipelineRegistry::PipelineRegistry(VulkanContext* vkContext)
+  : vkContext(vkContext)
+{
+}
+
+PipelineRegistry::~PipelineRegistry()
+{
+  for (auto& pipeline : pipelines) {
+    // a failed compile has nothing to destroy, its error was already thrown
+    // at whoever asked for it
+    try {
+      VkPipeline handle = pipeline.second.get();
+      vkDestroyPipeline(vkContext->logicalDevice, handle, nullptr);
+    } catch (const std::exception&) {
+    }
+  }
+}
+
+PipelineHandle
+PipelineRegistry::request(const GraphicsPipelineDesc& desc)
+{
+  requestCount++;
+
+  PipelineHandle handle;
+  auto it = pipelines.find(desc);
+  if (it != pipelines.end()) {
+    handle.future = it->second;
+    return handle;
+  }
+
+  // modules are looked up here on the main thread, the job only compiles
+  VkShaderModule vertexModule =
+    vkContext->shaderLibrary->get(desc.vertexShader);
+  VkShaderModule fragmentModule =
+    desc.fragmentShader.empty()
+      ? VK_NULL_HANDLE
+      : vkContext->shaderLibrary->get(desc.fragmentShader);
+
+  handle.future =
+    vkContext->jobSystem
+      ->submit([this, desc, vertexModule, fragmentModule]() {
+        return create(desc, vertexModule, fragmentModule);
+      })
+      .share();
+  pipelines.emplace(desc, handle.future);
+  return handle;
+}
+
+void
+PipelineRegistry::wait()
+{
+  for (auto& pipeline : pipelines) {
+    pipeline.second.get();
+  }
+}
+
+VkPipeline
+PipelineRegistry::create(const GraphicsPipelineDesc& desc,
+                         VkShaderModule vertexModule,
+                         VkShaderModule fragmentModule) const
+{
+  // -------------------- SHADER STAGES --------------------
+  std::vector<VkSpecializationMapEntry> specializationMapEntries(
+    desc.fragmentConstants.size());
+  for (uint32_t i = 0; i < specializationMapEntries.size(); i++) {
+    specializationMapEntries[i].constantID = i;
+    specializationMapEntries[i].offset = i * sizeof(uint32_t);
+    specializationMapEntries[i].size = sizeof(uint32_t);
+  }
+
+  VkSpecializationInfo specializationInfo{};
+  specializationInfo.mapEntryCount =
+    static_cast<uint32_t>(specializationMapEntries.size());
+  specializationInfo.pMapEntries = specializationMapEntries.data();
+  specializationInfo.dataSize =
+    desc.fragmentConstants.size() * sizeof(uint32_t);
+  specializationInfo.pData = desc.fragmentConstants.data();
+
+  std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+  shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shaderStages[0].module = vertexModule;
+  shaderStages[0].pName = "main";
+
+  shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  shaderStages[1].module = fragmentModule;
+  shaderStages[1].pName = "main";
+  if (!desc.fragmentConstants.empty()) {
+    shaderStages[1].pSpecializationInfo = &specializationInfo;
+  }
+
+  // -------------------- FIXED FUNCTION --------------------
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+  if (desc.vertexInput) {
+    auto vertexAttributes = Vertex::getAttributeDescriptions();
+    bindingDescriptions.push_back(Vertex::getBindingDescription());
+    attributeDescriptions.insert(attributeDescriptions.end(),
+                                 vertexAttributes.begin(),
+                                 vertexAttributes.end());
+  }
+  if (desc.instanceInput) {
+    auto instanceAttributes = InstanceData::getAttributeDescriptions();
+    bindingDescriptions.push_back(InstanceData::getBindingDescription());
+    attributeDescriptions.insert(attributeDescriptions.end(),
+                                 instanceAttributes.begin(),
+                                 instanceAttributes.end());
+  }
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  vertexInputInfo.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount =
+    static_cast<uint32_t>(bindingDescriptions.size());
+  vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+  vertexInputInfo.vertexAttributeDescriptionCount =
+    static_cast<uint32_t>(attributeDescriptions.size());
+  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+  inputAssembly.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = desc.topology;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  VkPipelineViewportStateCreateInfo viewportState{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = desc.cullMode;
+  rasterizer.frontFace = desc.frontFace;
+  rasterizer.depthBiasEnable = desc.depthBias ? VK_TRUE : VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil{};
+  depthStencil.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+  depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+  depthStencil.depthCompareOp = desc.depthCompareOp;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.minDepthBounds = 0.0f;
+  depthStencil.maxDepthBounds = 1.0f;
+  depthStencil.stencilTestEnable = VK_FALSE;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+  colorBlendAttachment.colorWriteMask =
+    VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+    VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = VK_FALSE;
+  if (desc.additiveBlend) {
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
+  }
+
+  std::vector<VkPipelineColorBlendAttachmentState> blendAttachmentStates(
+    desc.colorAttachmentCount, colorBlendAttachment);
+
+  VkPipelineColorBlendStateCreateInfo colorBlending{};
+  colorBlending.sType =
+    VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable = VK_FALSE;
+  colorBlending.logicOp = VK_LOGIC_OP_COPY;
+  colorBlending.attachmentCount =
+    static_cast<uint32_t>(blendAttachmentStates.size());
+  colorBlending.pAttachments = blendAttachmentStates.data();
+
+  std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT,
+                                                  VK_DYNAMIC_STATE_SCISSOR };
+
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates = dynamicStates.data();
+
+  // -------------------- PIPELINE --------------------
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.stageCount = fragmentModule == VK_NULL_HANDLE ? 1 : 2;
+  pipelineInfo.pStages = shaderStages.data();
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = desc.layout;
+  pipelineInfo.renderPass = desc.renderPass;
+  pipelineInfo.subpass = desc.subpass;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  // vkCreateGraphicsPipelines can be called from any thread, the pipeline
+  // cache synchronizes itself
+  VkPipeline pipeline;
+  if (vkCreateGraphicsPipelines(vkContext->logicalDevice,
+                                vkContext->pipelineCache->get(),
+                                1,
+                                &pipelineInfo,
+                                nullptr,
+                                &pipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create graphics pipeline! " +
+                             desc.vertexShader + " " + desc.fragmentShader);
+  }
+  return pipeline;
+}
+
+bool
+GraphicsPipelineDesc::operator==(const GraphicsPipelineDesc& other) const
+{
+  return vertexShader == other.vertexShader &&
+         fragmentShader == other.fragmentShader &&
+         fragmentConstants == other.fragmentConstants &&
+         vertexInput == other.vertexInput &&
+         instanceInput == other.instanceInput && topology == other.topology &&
+         cullMode == other.cullMode && frontFace == other.frontFace &&
+         depthBias == other.depthBias && depthTest == other.depthTest &&
+         depthWrite == other.depthWrite &&
+         depthCompareOp == other.depthCompareOp &&
+         colorAttachmentCount == other.colorAttachmentCount &&
+         additiveBlend == other.additiveBlend && layout == other.layout &&
+         renderPass == other.renderPass && subpass == other.subpass;
+}
+
+size_t
+PipelineRegistry::DescHash::operator()(const GraphicsPipelineDesc& desc) const
+{
+  size_t seed = 0;
+  auto combine = [&seed](size_t value) {
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  };
+
+  combine(std::hash<std::string>()(desc.vertexShader));
+  combine(std::hash<std::string>()(desc.fragmentShader));
+  for (uint32_t constant : desc.fragmentConstants) {
+    combine(constant);
+  }
+  combine(desc.vertexInput);
+  combine(desc.instanceInput);
+  combine(desc.topology);
+  combine(desc.cullMode);
+  combine(desc.frontFace);
+  combine(desc.depthBias);
+  combine(desc.depthTest);
+  combine(desc.depthWrite);
+  combine(desc.depthCompareOp);
+  combine(desc.colorAttachmentCount);
+  combine(desc.additiveBlend);
+  combine(std::hash<VkPipelineLayout>()(desc.layout));
+  combine(std::hash<VkRenderPass>()(desc.renderPass));
+  combine(desc.subpass);
+  return seed;
+}
@@ -0,0 +1,113 @@
+#ifndef _PIPELINE_REGISTRY_H_
+#define _PIPELINE_REGISTRY_H_
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "engine/VulkanContext.h"
+
+// everything that differs between the graphics pipelines of the passes. the
+// rest is the same everywhere: one viewport and scissor set dynamically, no
+// multisampling, filled polygons and "main" as the entry point
+struct GraphicsPipelineDesc
+{
+  // relative to the shader library directory. no fragment shader means a
+  // depth only pipeline
+  std::string vertexShader;
+  std::string fragmentShader;
+
+  // fragment specialization constants, constant_id i gets the i-th value
+  std::vector<uint32_t> fragmentConstants;
+
+  // false for fullscreen triangles that make their vertices up in the shader
+  bool vertexInput = true;
+  // adds InstanceData at binding 1, for pipelines drawn with InstanceBatcher
+  bool instanceInput = false;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  bool depthBias = false;
+
+  bool depthTest = true;
+  bool depthWrite = true;
+  VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+  // one blend state per color attachment, all the same
+  uint32_t colorAttachmentCount = 1;
+  // color is added to what's there, alpha blends by its own value
+  bool additiveBlend = false;
+
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  uint32_t subpass = 0;
+
+  bool operator==(const GraphicsPipelineDesc& other) const;
+};
+
+// a pipeline that may still be compiling, get() waits for it the first time
+// and rethrows if it failed
+class PipelineHandle
+{
+public:
+  VkPipeline get() const { return future.get(); }
+
+private:
+  friend class PipelineRegistry;
+  std::shared_future<VkPipeline> future;
+};
+
+// the passes describe their pipelines and ask the registry for them instead
+// of creating them. a pipeline is compiled on the job system as soon as it's
+// requested, so everything the passes ask for while they're being set up is
+// built in parallel, and asking twice for the same state returns the same
+// pipeline.
+//
+// the registry owns the pipelines and destroys them when it goes away. the
+// layout and render pass of a request are only used while it compiles, but
+// they're part of the key, so they have to stay alive as long as a request
+// for them could still come in.
+class PipelineRegistry
+{
+public:
+  PipelineRegistry(VulkanContext* vkContext);
+  ~PipelineRegistry();
+
+  PipelineRegistry(const PipelineRegistry&) = delete;
+  PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+  PipelineHandle request(const GraphicsPipelineDesc& desc);
+
+  // blocks until everything requested so far is compiled, the first failure
+  // is rethrown here
+  void wait();
+
+  size_t getPipelineCount() const { return pipelines.size(); }
+  size_t getRequestCount() const { return requestCount; }
+
+private:
+  VulkanContext* vkContext;
+
+  struct DescHash
+  {
+    size_t operator()(const GraphicsPipelineDesc& desc) const;
+  };
+
+  std::unordered_map<GraphicsPipelineDesc,
+                     std::shared_future<VkPipeline>,
+                     DescHash>
+    pipelines;
+  size_t requestCount = 0;
+
+  VkPipeline create(const GraphicsPipelineDesc& desc,
+                    VkShaderModule vertexModule,
+                    VkShaderModule fragmentModule) const;
+};
+
+#endif
@@ -0,0 +1,372 @@
+#include "engine/Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+Profiler::Profiler(VulkanContext* vkContext, uint32_t graphicsQueueFamily)
+  : vkContext(vkContext)
+  , startTime(Clock::now())
+{
+  const VkPhysicalDeviceProperties& properties = vkContext->deviceProperties;
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(
+    vkContext->physicalDevice, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+    vkContext->physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+  uint32_t validBits = queueFamilies[graphicsQueueFamily].timestampValidBits;
+
+  // some implementations (older MoltenVK for one) report zero valid bits,
+  // cpu scopes still work in that case
+  timestampsSupported = validBits > 0 && properties.limits.timestampPeriod > 0;
+  timestampPeriod = properties.limits.timestampPeriod;
+  timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+  if (!timestampsSupported) {
+    return;
+  }
+
+  VkQueryPoolCreateInfo queryPoolInfo{};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolInfo.queryCount = MAX_QUERIES_PER_FRAME;
+
+  for (auto& frame : frames) {
+    if (vkCreateQueryPool(vkContext->logicalDevice,
+                          &queryPoolInfo,
+                          nullptr,
+                          &frame.queryPool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create timestamp query pool!");
+    }
+  }
+}
+
+Profiler::~Profiler()
+{
+  for (auto& frame : frames) {
+    if (frame.queryPool != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(vkContext->logicalDevice, frame.queryPool, nullptr);
+    }
+  }
+}
+
+double
+Profiler::cpuNowMicroseconds() const
+{
+  return std::chrono::duration<double, std::micro>(Clock::now() - startTime)
+    .count();
+}
+
+// -------------------- FRAME --------------------
+void
+Profiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+  currentFrame = frameIndex;
+  FrameQueries& frame = frames[currentFrame];
+
+  // the fence of this slot has been waited on already, so whatever was written
+  // the last time around is ready
+  resolveQueries(frame);
+
+  frame.scopes.clear();
+  frame.openScopes.clear();
+  frame.queryCount = 0;
+
+  if (timestampsSupported) {
+    vkCmdResetQueryPool(
+      commandBuffer, frame.queryPool, 0, MAX_QUERIES_PER_FRAME);
+  }
+
+  beginGpuScope(commandBuffer, "frame");
+}
+
+void
+Profiler::endFrame(VkCommandBuffer commandBuffer)
+{
+  FrameQueries& frame = frames[currentFrame];
+
+  // close anything left open so the queries always come in pairs
+  while (!frame.openScopes.empty()) {
+    endGpuScope(commandBuffer);
+  }
+
+  frame.cpuSubmitTime = cpuNowMicroseconds();
+}
+
+void
+Profiler::resolveQueries(FrameQueries& frame)
+{
+  if (!timestampsSupported || frame.queryCount == 0) {
+    return;
+  }
+
+  // [timestamp, availability] pairs
+  std::vector<uint64_t> results(frame.queryCount * 2);
+  VkResult result =
+    vkGetQueryPoolResults(vkContext->logicalDevice,
+                          frame.queryPool,
+                          0,
+                          frame.queryCount,
+                          results.size() * sizeof(uint64_t),
+                          results.data(),
+                          2 * sizeof(uint64_t),
+                          VK_QUERY_RESULT_64_BIT |
+                            VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+  if (result != VK_SUCCESS && result != VK_NOT_READY) {
+    return;
+  }
+
+  // gpu timestamps live in their own time domain, the trace lines them up
+  // with the moment the frame was submitted on the cpu. every offset is taken
+  // from the first query, without it the whole frame is skipped
+  if (results[1] == 0) {
+    return;
+  }
+  uint64_t frameBegin = results[0] & timestampMask;
+
+  for (const auto& scope : frame.scopes) {
+    if (scope.endQuery == UINT32_MAX || results[scope.beginQuery * 2 + 1] == 0 ||
+        results[scope.endQuery * 2 + 1] == 0) {
+      continue;
+    }
+
+    uint64_t begin = results[scope.beginQuery * 2] & timestampMask;
+    uint64_t end = results[scope.endQuery * 2] & timestampMask;
+    uint64_t ticks = (end - begin) & timestampMask;
+
+    double durationMicroseconds = ticks * timestampPeriod / 1000.0;
+    addSample("gpu/" + scope.name,
+              static_cast<float>(durationMicroseconds / 1000.0));
+
+    if (captureTrace) {
+      double offset =
+        ((begin - frameBegin) & timestampMask) * timestampPeriod / 1000.0;
+      traceEvents.push_back(
+        { scope.name, frame.cpuSubmitTime + offset, durationMicroseconds, 1 });
+    }
+  }
+}
+
+// -------------------- GPU SCOPES --------------------
+void
+Profiler::beginGpuScope(VkCommandBuffer commandBuffer, const std::string& name)
+{
+  FrameQueries& frame = frames[currentFrame];
+
+  if (!timestampsSupported || frame.queryCount + 2 > MAX_QUERIES_PER_FRAME) {
+    // keep begin/end balanced even when we're not recording anything
+    frame.openScopes.push_back(UINT32_MAX);
+    return;
+  }
+
+  vkCmdWriteTimestamp(commandBuffer,
+                      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      frame.queryPool,
+                      frame.queryCount);
+
+  frame.scopes.push_back({ name, frame.queryCount, UINT32_MAX });
+  frame.openScopes.push_back(static_cast<uint32_t>(frame.scopes.size() - 1));
+  frame.queryCount++;
+}
+
+void
+Profiler::endGpuScope(VkCommandBuffer commandBuffer)
+{
+  FrameQueries& frame = frames[currentFrame];
+
+  if (frame.openScopes.empty()) {
+    throw std::runtime_error("endGpuScope without a matching beginGpuScope!");
+  }
+
+  uint32_t scopeIndex = frame.openScopes.back();
+  frame.openScopes.pop_back();
+
+  if (scopeIndex == UINT32_MAX) {
+    return;
+  }
+
+  vkCmdWriteTimestamp(commandBuffer,
+                      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      frame.queryPool,
+                      frame.queryCount);
+
+  frame.scopes[scopeIndex].endQuery = frame.queryCount;
+  frame.queryCount++;
+}
+
+// -------------------- CPU SCOPES --------------------
+void
+Profiler::beginCpuScope(const std::string& name)
+{
+  openCpuScopes.push_back({ name, cpuNowMicroseconds() });
+}
+
+void
+Profiler::endCpuScope()
+{
+  if (openCpuScopes.empty()) {
+    throw std::runtime_error("endCpuScope without a matching beginCpuScope!");
+  }
+
+  OpenCpuScope scope = std::move(openCpuScopes.back());
+  openCpuScopes.pop_back();
+
+  double duration = cpuNowMicroseconds() - scope.start;
+  addSample("cpu/" + scope.name, static_cast<float>(duration / 1000.0));
+
+  if (captureTrace) {
+    traceEvents.push_back({ std::move(scope.name), scope.start, duration, 0 });
+  }
+}
+
+// -------------------- COUNTERS --------------------
+void
+Profiler::addCounter(const std::string& name, float value)
+{
+  addSample("count/" + name, value);
+}
+
+// -------------------- STATS --------------------
+void
+Profiler::addSample(const std::string& name, float milliseconds)
+{
+  RollingSamples& rolling = rollingSamples[name];
+  rolling.samples[rolling.head] = milliseconds;
+  rolling.head = (rolling.head + 1) % ROLLING_WINDOW;
+  rolling.count = std::min(rolling.count + 1, ROLLING_WINDOW);
+
+  if (keepHistory) {
+    history[name].push_back(milliseconds);
+  }
+}
+
+const std::vector<float>&
+Profiler::getHistory(const std::string& name) const
+{
+  static const std::vector<float> empty;
+
+  auto it = history.find(name);
+  return it != history.end() ? it->second : empty;
+}
+
+ProfilerStats
+Profiler::getStats(const std::string& name) const
+{
+  ProfilerStats stats;
+
+  auto it = rollingSamples.find(name);
+  if (it == rollingSamples.end() || it->second.count == 0) {
+    return stats;
+  }
+
+  const RollingSamples& rolling = it->second;
+  std::vector<float> sorted(rolling.samples.begin(),
+                            rolling.samples.begin() + rolling.count);
+  std::sort(sorted.begin(), sorted.end());
+
+  float sum = 0.0f;
+  for (float sample : sorted) {
+    sum += sample;
+  }
+
+  size_t p99Index = static_cast<size_t>(std::ceil(0.99 * sorted.size())) - 1;
+
+  stats.min = sorted.front();
+  stats.avg = sum / sorted.size();
+  stats.p99 = sorted[std::min(p99Index, sorted.size() - 1)];
+  stats.sampleCount = rolling.count;
+  return stats;
+}
+
+std::vector<std::string>
+Profiler::getScopeNames() const
+{
+  std::vector<std::string> names;
+  names.reserve(rollingSamples.size());
+  for (const auto& [name, samples] : rollingSamples) {
+    names.push_back(name);
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+void
+Profiler::printSummary(std::ostream& out) const
+{
+  out << std::left << std::setw(40) << "scope" << std::right << std::setw(10)
+      << "min ms" << std::setw(10) << "avg ms" << std::setw(10) << "p99 ms"
+      << std::endl;
+
+  std::vector<std::string> counters;
+  for (const auto& name : getScopeNames()) {
+    if (name.rfind("count/", 0) == 0) {
+      counters.push_back(name);
+      continue;
+    }
+
+    ProfilerStats stats = getStats(name);
+    out << std::left << std::setw(40) << name << std::right << std::fixed
+        << std::setprecision(3) << std::setw(10) << stats.min << std::setw(10)
+        << stats.avg << std::setw(10) << stats.p99 << std::endl;
+  }
+
+  if (counters.empty()) {
+    return;
+  }
+
+  out << std::left << std::setw(40) << "counter" << std::right << std::setw(10)
+      << "min" << std::setw(10) << "avg" << std::setw(10) << "p99" << std::endl;
+
+  for (const auto& name : counters) {
+    ProfilerStats stats = getStats(name);
+    out << std::left << std::setw(40) << name << std::right << std::fixed
+        << std::setprecision(1) << std::setw(10) << stats.min << std::setw(10)
+        << stats.avg << std::setw(10) << stats.p99 << std::endl;
+  }
+}
+
+// -------------------- CHROME TRACE --------------------
+static std::string
+escapeJson(const std::string& string)
+{
+  std::string escaped;
+  escaped.reserve(string.size());
+  for (char c : string) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+void
+Profiler::exportChromeTrace(const std::string& filePath) const
+{
+  std::ofstream file(filePath);
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open file! " + filePath);
+  }
+
+  // load it in chrome://tracing or ui.perfetto.dev
+  file << "{\"traceEvents\":[\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,"
+          "\"args\":{\"name\":\"CPU\"}},\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,"
+          "\"args\":{\"name\":\"GPU\"}}";
+
+  file << std::fixed << std::setprecision(3);
+  for (const auto& event : traceEvents) {
+    file << ",\n{\"name\":\"" << escapeJson(event.name)
+         << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.track
+         << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+  }
+
+  file << "\n]}\n";
+}
@@ -0,0 +1,182 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "engine/VulkanContext.h"
+
+// rolling window of the last samples of a scope, in milliseconds
+struct ProfilerStats
+{
+  float min = 0.0f;
+  float avg = 0.0f;
+  float p99 = 0.0f;
+  uint32_t sampleCount = 0;
+};
+
+class Profiler
+{
+public:
+  Profiler(VulkanContext* vkContext, uint32_t graphicsQueueFamily);
+  ~Profiler();
+
+  // -------------------- FRAME --------------------
+  // beginFrame must be called right after the frame's fence has been waited
+  // on and its command buffer has begun: the queries of the last frame that
+  // used this slot are resolved here, so reading them never stalls.
+  void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+  void endFrame(VkCommandBuffer commandBuffer);
+
+  // -------------------- GPU SCOPES --------------------
+  // scopes nest, every begin needs a matching end on the same command buffer
+  void beginGpuScope(VkCommandBuffer commandBuffer, const std::string& name);
+  void endGpuScope(VkCommandBuffer commandBuffer);
+
+  // -------------------- CPU SCOPES --------------------
+  void beginCpuScope(const std::string& name);
+  void endCpuScope();
+
+  // -------------------- COUNTERS --------------------
+  // anything counted once per frame that isn't a duration, like draw calls.
+  // kept and queried like the scopes, prefixed with "count/"
+  void addCounter(const std::string& name, float value);
+
+  bool gpuTimingSupported() const { return timestampsSupported; }
+
+  // stats over the last ROLLING_WINDOW samples of every scope (cpu scopes are
+  // prefixed with "cpu/", gpu ones with "gpu/"). counters are in their own
+  // units instead of milliseconds
+  ProfilerStats getStats(const std::string& name) const;
+  std::vector<std::string> getScopeNames() const;
+  void printSummary(std::ostream& out) const;
+
+  // every sample ever taken, per scope. off by default, the benchmark turns it
+  // on once it's done warming up
+  bool keepHistory = false;
+  const std::vector<float>& getHistory(const std::string& name) const;
+  void clearHistory() { history.clear(); }
+
+  // trace events are only kept while this is on, they grow unbounded otherwise
+  bool captureTrace = false;
+  void exportChromeTrace(const std::string& filePath) const;
+
+  static const uint32_t ROLLING_WINDOW = 256;
+
+private:
+  VulkanContext* vkContext;
+
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point startTime;
+  double cpuNowMicroseconds() const;
+
+  void addSample(const std::string& name, float milliseconds);
+
+  struct RollingSamples
+  {
+    std::array<float, ROLLING_WINDOW> samples{};
+    uint32_t head = 0;
+    uint32_t count = 0;
+  };
+  std::unordered_map<std::string, RollingSamples> rollingSamples;
+  std::unordered_map<std::string, std::vector<float>> history;
+
+  struct TraceEvent
+  {
+    std::string name;
+    double start; // microseconds since the profiler was created
+    double duration;
+    uint32_t track; // 0 = cpu, 1 = gpu
+  };
+  std::vector<TraceEvent> traceEvents;
+
+  // -------------------- GPU --------------------
+  static const uint32_t MAX_QUERIES_PER_FRAME = 256;
+
+  bool timestampsSupported = false;
+  float timestampPeriod = 1.0f; // nanoseconds per tick
+  uint64_t timestampMask = ~0ull;
+
+  struct GpuScope
+  {
+    std::string name;
+    uint32_t beginQuery;
+    uint32_t endQuery;
+  };
+
+  struct FrameQueries
+  {
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    uint32_t queryCount = 0;
+    std::vector<GpuScope> scopes;
+    std::vector<uint32_t> openScopes;
+    double cpuSubmitTime = 0.0;
+  };
+  std::array<FrameQueries, MAX_FRAMES_IN_FLIGHT> frames;
+  uint32_t currentFrame = 0;
+
+  void resolveQueries(FrameQueries& frame);
+
+  // -------------------- CPU --------------------
+  struct OpenCpuScope
+  {
+    std::string name;
+    double start;
+  };
+  std::vector<OpenCpuScope> openCpuScopes;
+};
+
+// helpers so scopes close themselves, both accept a null profiler
+class CpuProfileScope
+{
+public:
+  CpuProfileScope(Profiler* profiler, const std::string& name)
+    : profiler(profiler)
+  {
+    if (profiler) {
+      profiler->beginCpuScope(name);
+    }
+  }
+  ~CpuProfileScope()
+  {
+    if (profiler) {
+      profiler->endCpuScope();
+    }
+  }
+
+private:
+  Profiler* profiler;
+};
+
+class GpuProfileScope
+{
+public:
+  GpuProfileScope(Profiler* profiler,
+                  VkCommandBuffer commandBuffer,
+                  const std::string& name)
+    : profiler(profiler)
+    , commandBuffer(commandBuffer)
+  {
+    if (profiler) {
+      profiler->beginGpuScope(commandBuffer, name);
+    }
+  }
+  ~GpuProfileScope()
+  {
+    if (profiler) {
+      profiler->endGpuScope(commandBuffer);
+    }
+  }
+
+private:
+  Profiler* profiler;
+  VkCommandBuffer commandBuffer;
+};
+
+#endif
@@ -1,4 +1,9 @@
 #include "engine/Renderer.h"
+#include "engine/FrameArena.h"
+#include "engine/PipelineRegistry.h"
+#include "engine/Profiler.h"
+#include "engine/TextureStreamer.h"
+#include "engine/UploadBatcher.h"
 
 Renderer::Renderer(VulkanContext* vkContext, VulkanSwapchain* vkSwapchain,  const Scene& scene) : vkContext(vkContext), vkSwapchain(vkSwapchain)
 {
@@ -7,12 +12,26 @@ Renderer::Renderer(VulkanContext* vkContext, VulkanSwapchain* vkSwapchain,  cons
   // create descriptors
   // createDescriptors();
 
-  // create render passes
-  gBufferPass = new GBuffPass(vkContext, {}, scene, vkSwapchain->width, vkSwapchain->height);
-  lightPass = new LightPass(vkContext, {gBufferPass->depthAttachment->view, gBufferPass->depthAttachment->format}, scene, vkSwapchain->width, vkSwapchain->height);
-  shadowMapPass = new ShadowMapPass(vkContext, {}, scene, 4096, 4096); // <- 1024 is the fixed resolution i've chosen for the shadowmaps
-  blinnPhongPass = new BlinnPhongPass(vkContext, {vkSwapchain->depthImageView, vkSwapchain->getDepthImageFormat()}, scene, vkSwapchain->width, vkSwapchain->height);
-  hdrPass = new HDRPass(vkContext, {VK_NULL_HANDLE, vkSwapchain->getSwapChainImageFormat()}, scene, vkSwapchain->width, vkSwapchain->height);
+  // create render passes. this is mostly pipeline compilation, the time shows
+  // up as cpu/create passes and drops a lot once the pipeline cache is warm
+  {
+    CpuProfileScope scope(vkContext->profiler, "create passes");
+    if (GpuCuller::isSupported(vkContext)) {
+      gpuCuller = new GpuCuller(vkContext);
+    }
+#if CLUSTERED_LIGHTING
+    clusteredLights = new ClusteredLights(vkContext);
+#endif
+    gBufferPass = new GBuffPass(vkContext, {}, scene, vkSwapchain->width, vkSwapchain->height, gpuCuller);
+    lightPass = new LightPass(vkContext, {gBufferPass->depthAttachment->view, gBufferPass->depthAttachment->format}, scene, vkSwapchain->width, vkSwapchain->height);
+    shadowMapPass = new ShadowMapPass(vkContext, {}, scene, 4096, 4096, gpuCuller); // <- 1024 is the fixed resolution i've chosen for the shadowmaps
+    blinnPhongPass = new BlinnPhongPass(vkContext, {vkSwapchain->depthImageView, vkSwapchain->getDepthImageFormat()}, scene, vkSwapchain->width, vkSwapchain->height, gpuCuller, clusteredLights);
+    hdrPass = new HDRPass(vkContext, {VK_NULL_HANDLE, vkSwapchain->getSwapChainImageFormat()}, scene, vkSwapchain->width, vkSwapchain->height);
+
+    // the passes only queued their pipelines, they compile on the job system
+    // while the next pass is set up. a compile error shows up here
+    vkContext->pipelineRegistry->wait();
+  }
 
   // update descriptors
   // lightPass.updateDescriptors({gbufferPass.positionAttachment, gbufferPass.normalAttachment, gbufferPass.albedoAttachment, shadowMapPass.directionalShadowMap});
@@ -67,6 +86,9 @@ Renderer::~Renderer() {
   delete shadowMapPass;
   delete blinnPhongPass;
   delete hdrPass;
+
+  delete clusteredLights;
+  delete gpuCuller;
 }
 
 void
@@ -91,19 +113,64 @@ Renderer::update(const Scene& scene)
 }
 
 void
-Renderer::draw(const Scene& scene)
+Renderer::draw(Scene& scene)
 {
+  // streamed textures that finished decoding are recorded into the batch too
+  vkContext->textureStreamer->update();
+
+  // anything loaded since the last frame goes out before this frame's submit,
+  // the graphics queue orders it ahead of the draws that use it
+  vkContext->uploadBatcher->flush();
+  vkContext->uploadBatcher->collect();
+
   vkSwapchain->prepareFrame();
 
-  // gBufferPass->draw(vkSwapchain, scene);
-  shadowMapPass->draw(vkSwapchain, scene);
-  // lightPass->draw(vkSwapchain, scene);
-  blinnPhongPass->draw(vkSwapchain, scene);
-  hdrPass->draw(vkSwapchain, scene);
+  // the draw lists are rebuilt from scratch every frame
+  vkContext->frameArena->reset(vkSwapchain->currentFrame);
+
+  // this frame's fence has been waited on, its descriptor sets are idle
+  scene.prepareFrame(vkSwapchain->currentFrame);
+
+  // camera and lights go into the staging ring, the region is closed and
+  // tied to this frame's fence in submitFrame()
+  scene.uploadFrameData();
+
+  {
+    CpuProfileScope recordScope(vkContext->profiler, "record");
+
+    // the draws of every pass below come out of this when it's there
+    if (gpuCuller) {
+      CpuProfileScope cpuScope(vkContext->profiler, "GpuCuller");
+      GpuProfileScope gpuScope(vkContext->profiler, vkSwapchain->commandBuffer, "GpuCuller");
+      gpuCuller->record(vkSwapchain->commandBuffer, vkSwapchain->currentFrame, scene);
+    }
+
+    // the forward pass shades with the lights this assigns to its clusters
+    if (clusteredLights) {
+      CpuProfileScope cpuScope(vkContext->profiler, "ClusteredLights");
+      GpuProfileScope gpuScope(vkContext->profiler, vkSwapchain->commandBuffer, "ClusteredLights");
+      clusteredLights->record(vkSwapchain->commandBuffer, vkSwapchain->currentFrame, scene, {static_cast<uint32_t>(vkSwapchain->width), static_cast<uint32_t>(vkSwapchain->height)});
+    }
+
+    // gBufferPass->draw(vkSwapchain, scene);
+    drawPass(shadowMapPass, "ShadowMapPass", scene);
+    // lightPass->draw(vkSwapchain, scene);
+    drawPass(blinnPhongPass, "BlinnPhongPass", scene);
+    drawPass(hdrPass, "HDRPass", scene);
+  }
 
   vkSwapchain->submitFrame();
 }
 
+void
+Renderer::drawPass(IPassHelper* pass, const std::string& name, const Scene& scene)
+{
+  CpuProfileScope cpuScope(vkContext->profiler, name);
+  GpuProfileScope gpuScope(vkContext->profiler, vkSwapchain->commandBuffer, name);
+
+  pass->draw(vkSwapchain, scene);
+}
+
 void Renderer::createBuffers() {
   cameraBuffer.size = sizeof(CameraBuffer);
 
@@ -7,6 +7,8 @@
 #include "engine/Passes/ShadowMapPass.h"
 #include "engine/Passes/HDRPass.h"
 
+#include "engine/ClusteredLights.h"
+#include "engine/GpuCuller.h"
 #include "engine/Scene.h"
 #include "engine/VulkanContext.h"
 #include "engine/VulkanSwapchain.h"
@@ -24,9 +26,19 @@ public:
   ShadowMapPass* shadowMapPass;
   BlinnPhongPass* blinnPhongPass;
   HDRPass* hdrPass;
-  void draw(const Scene& scene);
+  void draw(Scene& scene);
+
+  // null when the device can't do gpu driven rendering (or it's turned off),
+  // the passes cull and draw on the cpu then
+  GpuCuller* gpuCuller = nullptr;
+
+  // null unless CLUSTERED_LIGHTING is on, the forward pass shades with the
+  // fixed light arrays of the scene then
+  ClusteredLights* clusteredLights = nullptr;
 
 private:
+  // brackets the pass with cpu and gpu profiler scopes
+  void drawPass(IPassHelper* pass, const std::string& name, const Scene& scene);
 
   VulkanContext* vkContext;
   VulkanSwapchain* vkSwapchain;
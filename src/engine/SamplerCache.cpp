@@ -0,0 +1,114 @@
+#include "engine/SamplerCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+SamplerCache::SamplerCache(VulkanContext* vkContext)
+  : vkContext(vkContext)
+{
+}
+
+SamplerCache::~SamplerCache()
+{
+  for (auto& sampler : samplers) {
+    vkDestroySampler(vkContext->logicalDevice, sampler.second, nullptr);
+  }
+}
+
+VkSampler
+SamplerCache::get(const VkSamplerCreateInfo& createInfo)
+{
+  if (createInfo.pNext != nullptr) {
+    throw std::runtime_error("sampler cache doesn't support pNext chains!");
+  }
+
+  VkSamplerCreateInfo samplerInfo = createInfo;
+  samplerInfo.maxAnisotropy =
+    std::min(samplerInfo.maxAnisotropy,
+             vkContext->deviceProperties.limits.maxSamplerAnisotropy);
+
+  Key key;
+  key.flags = samplerInfo.flags;
+  key.magFilter = samplerInfo.magFilter;
+  key.minFilter = samplerInfo.minFilter;
+  key.mipmapMode = samplerInfo.mipmapMode;
+  key.addressModeU = samplerInfo.addressModeU;
+  key.addressModeV = samplerInfo.addressModeV;
+  key.addressModeW = samplerInfo.addressModeW;
+  key.mipLodBias = samplerInfo.mipLodBias;
+  key.anisotropyEnable = samplerInfo.anisotropyEnable;
+  key.maxAnisotropy = samplerInfo.maxAnisotropy;
+  key.compareEnable = samplerInfo.compareEnable;
+  key.compareOp = samplerInfo.compareOp;
+  key.minLod = samplerInfo.minLod;
+  key.maxLod = samplerInfo.maxLod;
+  key.borderColor = samplerInfo.borderColor;
+  key.unnormalizedCoordinates = samplerInfo.unnormalizedCoordinates;
+
+  auto it = samplers.find(key);
+  if (it != samplers.end()) {
+    return it->second;
+  }
+
+  VkSampler sampler;
+  if (vkCreateSampler(
+        vkContext->logicalDevice, &samplerInfo, nullptr, &sampler) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture sampler!");
+  }
+
+  samplers[key] = sampler;
+  return sampler;
+}
+
+bool
+SamplerCache::Key::operator==(const Key& other) const
+{
+  return flags == other.flags && magFilter == other.magFilter &&
+         minFilter == other.minFilter && mipmapMode == other.mipmapMode &&
+         addressModeU == other.addressModeU &&
+         addressModeV == other.addressModeV &&
+         addressModeW == other.addressModeW &&
+         mipLodBias == other.mipLodBias &&
+         anisotropyEnable == other.anisotropyEnable &&
+         maxAnisotropy == other.maxAnisotropy &&
+         compareEnable == other.compareEnable &&
+         compareOp == other.compareOp && minLod == other.minLod &&
+         maxLod == other.maxLod && borderColor == other.borderColor &&
+         unnormalizedCoordinates == other.unnormalizedCoordinates;
+}
+
+size_t
+SamplerCache::KeyHash::operator()(const Key& key) const
+{
+  size_t seed = 0;
+  auto combine = [&seed](uint32_t value) {
+    seed ^= std::hash<uint32_t>()(value) + 0x9e3779b9 + (seed << 6) +
+            (seed >> 2);
+  };
+  auto bits = [](float value) {
+    uint32_t result;
+    memcpy(&result, &value, sizeof(result));
+    return result;
+  };
+
+  combine(key.flags);
+  combine(key.magFilter);
+  combine(key.minFilter);
+  combine(key.mipmapMode);
+  combine(key.addressModeU);
+  combine(key.addressModeV);
+  combine(key.addressModeW);
+  combine(bits(key.mipLodBias));
+  combine(key.anisotropyEnable);
+  combine(bits(key.maxAnisotropy));
+  combine(key.compareEnable);
+  combine(key.compareOp);
+  combine(bits(key.minLod));
+  combine(bits(key.maxLod));
+  combine(key.borderColor);
+  combine(key.unnormalizedCoordinates);
+  return seed;
+}
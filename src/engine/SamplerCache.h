@@ -0,0 +1,64 @@
+#ifndef _SAMPLER_CACHE_H_
+#define _SAMPLER_CACHE_H_
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <unordered_map>
+
+#include "engine/VulkanContext.h"
+
+// one VkSampler per distinct VkSamplerCreateInfo. the cache owns every
+// sampler, whoever asks for one just keeps the handle and never destroys it.
+// maxAnisotropy is clamped to the device limit so callers don't need to query
+// it themselves.
+class SamplerCache
+{
+public:
+  SamplerCache(VulkanContext* vkContext);
+  ~SamplerCache();
+
+  SamplerCache(const SamplerCache&) = delete;
+  SamplerCache& operator=(const SamplerCache&) = delete;
+
+  // pNext chains aren't supported, they can't be compared
+  VkSampler get(const VkSamplerCreateInfo& createInfo);
+
+  size_t getSamplerCount() const { return samplers.size(); }
+
+private:
+  VulkanContext* vkContext;
+
+  // the fields of VkSamplerCreateInfo that affect the sampler, compared one
+  // by one since the struct itself can have padding
+  struct Key
+  {
+    VkSamplerCreateFlags flags;
+    VkFilter magFilter;
+    VkFilter minFilter;
+    VkSamplerMipmapMode mipmapMode;
+    VkSamplerAddressMode addressModeU;
+    VkSamplerAddressMode addressModeV;
+    VkSamplerAddressMode addressModeW;
+    float mipLodBias;
+    VkBool32 anisotropyEnable;
+    float maxAnisotropy;
+    VkBool32 compareEnable;
+    VkCompareOp compareOp;
+    float minLod;
+    float maxLod;
+    VkBorderColor borderColor;
+    VkBool32 unnormalizedCoordinates;
+
+    bool operator==(const Key& other) const;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const Key& key) const;
+  };
+
+  std::unordered_map<Key, VkSampler, KeyHash> samplers;
+};
+
+#endif
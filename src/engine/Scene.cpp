@@ -1,13 +1,22 @@
 #include "Scene.h"
 #include "engine/Buffers.h"
+#include "engine/JobSystem.h"
 #include "engine/LightManager.h"
 #include "engine/Lights.h"
+#include "engine/Profiler.h"
+#include "engine/StagingRing.h"
+#include "engine/TextureStreamer.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <stdexcept>
 #include <vulkan/vulkan_core.h>
 
 Scene::Scene(VulkanContext* vkContext)
-  : vkContext(vkContext)
+  : cameraInstances(vkContext)
+  , lightCubeInstances(vkContext)
+  , vkContext(vkContext)
 {
   // --------------------- Init Scene ---------------------
   directionalLight = LightManager::createDirectionalLight(
@@ -37,21 +46,24 @@ Scene::Scene(VulkanContext* vkContext)
                                                         9.5f,
                                                         true));
 
-  // create light cubes for the lights
+  // --------------------- Load Assets ---------------------
+  // the files are read, imported and decoded on the job system while the main
+  // thread goes on. creating the models from them (and recording their gpu
+  // uploads) stays on the main thread, in the order below.
   std::string modelPath = MODEL_PATH;
-  for (auto& pointLight : pointLights) {
-    Model cube = Model(modelPath + "cube.glb",
-                       vkContext,
-                       pointLight.getPosition(),
-                       glm::vec3(0.0),
-                       0,
-                       glm::vec3(0.1f));
-    lightCubes.push_back(std::move(cube));
-  }
+  // with streaming on the textures are decoded by the TextureStreamer instead
+  bool decodeTextures = !vkContext->textureStreamer->isEnabled();
+  auto loadSource = [vkContext, decodeTextures](const std::string& filePath) {
+    return vkContext->jobSystem->submit([filePath, decodeTextures]() {
+      return Model::loadSource(filePath, decodeTextures);
+    });
+  };
+  auto cubeSource = loadSource(modelPath + "cube.glb");
+  auto planeSource = loadSource(modelPath + "for_demo/plane.glb");
 
   camera = new Camera3D(glm::vec3(0.0, 0.0, 3.0), glm::vec3(0.0, 0.0, -1.0));
 
-  // create new skybox
+  // create new skybox, its faces get decoded on the job system as well
   std::string texturePath = TEXTURE_PATH;
   std::array<std::string, 6> files = {
     texturePath + "skybox/right.jpg", texturePath + "skybox/left.jpg",
@@ -60,15 +72,19 @@ Scene::Scene(VulkanContext* vkContext)
   };
   skybox = new Skybox(vkContext, files);
 
+  // one cube for all the lights, they're placed when they get drawn
+  std::shared_ptr<ModelSource> cubeModel = cubeSource.get();
+  lightCube = new Model(*cubeModel, vkContext);
+
   // finish initializing models and loading them, setup camera etc.
-  Model plane = Model(modelPath + "for_demo/plane.glb",
+  Model plane = Model(*planeSource.get(),
                       vkContext,
                       glm::vec3(0, 1, 0),
                       glm::vec3(0),
                       0,
                       glm::vec3(50));
   models.push_back(std::move(plane));
-  Model cube = Model(modelPath + "cube.glb", vkContext, glm::vec3(0, 0, 0));
+  Model cube = Model(*cubeModel, vkContext, glm::vec3(0, 0, 0));
   models.push_back(std::move(cube));
   // Model voyager = Model(modelPath + "voyager.gltf", vkContext, glm::vec3(0,
   // -2, 0)); models.push_back(std::move(voyager));
@@ -87,9 +103,9 @@ Scene::Scene(VulkanContext* vkContext)
   //                         glm::vec3(0.1f));
   //  models.push_back(std::move(rare));
 
-  // --------------------- Create Buffers ---------------------
-  // TODO: move inside light manager
-  createBuffers();
+  cameraData.view = camera->getCameraMatrix();
+  cameraData.proj = camera->getCameraProjectionMatrix();
+  cameraData.cameraPos = glm::vec4(camera->getCameraPos(), 1);
 
   // TODO: move inside of renderer class
   createDescriptors();
@@ -103,6 +119,7 @@ Scene::~Scene()
 
   // destroy models
   models.clear();
+  delete lightCube;
   vkDestroyDescriptorSetLayout(
     vkContext->logicalDevice, Model::textureLayout, nullptr);
 
@@ -117,21 +134,6 @@ Scene::~Scene()
   // destroy pool
   vkDestroyDescriptorPool(
     vkContext->logicalDevice, sceneDescriptorPool, nullptr);
-
-  // destroy buffers
-  vmaDestroyBuffer(
-    vkContext->allocator, cameraBuffer.buffer, cameraBuffer.allocation);
-
-  vmaDestroyBuffer(vkContext->allocator,
-                   directionalLightBuffer.buffer,
-                   directionalLightBuffer.allocation);
-
-  vmaDestroyBuffer(vkContext->allocator,
-                   pointLightsBuffer.buffer,
-                   pointLightsBuffer.allocation);
-
-  vmaDestroyBuffer(
-    vkContext->allocator, spotLightsBuffer.buffer, spotLightsBuffer.allocation);
 }
 
 void
@@ -140,7 +142,7 @@ Scene::createDescriptors()
   // --------------------- Create Pool ---------------------
   std::array<VkDescriptorPoolSize, 2> poolSizes;
 
-  poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   poolSizes[0].descriptorCount =
     4; // UBO, PointLights, DirectionalLights, SpotLights
 
@@ -165,7 +167,7 @@ Scene::createDescriptors()
     std::array<VkDescriptorSetLayoutBinding, 1> bindings;
     bindings[0].binding = 0;
     bindings[0].descriptorCount = 1;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     bindings[0].pImmutableSamplers = nullptr;
     bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -189,19 +191,19 @@ Scene::createDescriptors()
     std::array<VkDescriptorSetLayoutBinding, 3> bindings;
     bindings[0].binding = 1;
     bindings[0].descriptorCount = 1;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     bindings[0].pImmutableSamplers = nullptr;
     bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     bindings[1].binding = 2;
     bindings[1].descriptorCount = 1;
-    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     bindings[1].pImmutableSamplers = nullptr;
     bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     bindings[2].binding = 3;
     bindings[2].descriptorCount = 1;
-    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     bindings[2].pImmutableSamplers = nullptr;
     bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
@@ -253,6 +255,10 @@ Scene::createDescriptors()
   }
 
   // --------------------- Create Descriptorset for Camera ---------------------
+  // camera and lights are written into the staging ring every frame, the sets
+  // point at the start of the ring and get the actual location as dynamic
+  // offsets at bind time
+  VkBuffer ringBuffer = vkContext->stagingRing->getBuffer();
   {
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -267,7 +273,7 @@ Scene::createDescriptors()
     }
 
     VkDescriptorBufferInfo uniformBufferInfo{};
-    uniformBufferInfo.buffer = cameraBuffer.buffer;
+    uniformBufferInfo.buffer = ringBuffer;
     uniformBufferInfo.offset = 0;
     uniformBufferInfo.range = sizeof(CameraBuffer);
 
@@ -277,7 +283,8 @@ Scene::createDescriptors()
     descriptorWrites[0].dstSet = cameraUBODescriptorset;
     descriptorWrites[0].dstBinding = 0;
     descriptorWrites[0].dstArrayElement = 0;
-    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrites[0].descriptorType =
+      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     descriptorWrites[0].descriptorCount = 1;
     descriptorWrites[0].pBufferInfo = &uniformBufferInfo;
 
@@ -304,21 +311,19 @@ Scene::createDescriptors()
     }
 
     VkDescriptorBufferInfo directionalLightBufferInfo{};
-    directionalLightBufferInfo.buffer = directionalLightBuffer.buffer;
+    directionalLightBufferInfo.buffer = ringBuffer;
     directionalLightBufferInfo.offset = 0;
     directionalLightBufferInfo.range = sizeof(DirectionalLight);
 
     VkDescriptorBufferInfo pointLightBufferInfo{};
-    pointLightBufferInfo.buffer = pointLightsBuffer.buffer;
+    pointLightBufferInfo.buffer = ringBuffer;
     pointLightBufferInfo.offset = 0;
     pointLightBufferInfo.range = sizeof(PointLight) * MAX_POINT_LIGHTS;
 
     VkDescriptorBufferInfo spotLightBufferInfo{};
-    spotLightBufferInfo.buffer = spotLightsBuffer.buffer;
+    spotLightBufferInfo.buffer = ringBuffer;
     spotLightBufferInfo.offset = 0;
     spotLightBufferInfo.range = sizeof(SpotLight) * MAX_SPOT_LIGHTS;
-    // spotLightBufferInfo.range =
-    //   sizeof(SpotLight::SpotLightBuffer) * MAX_SPOT_LIGHTS;
 
     std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
 
@@ -326,7 +331,8 @@ Scene::createDescriptors()
     descriptorWrites[0].dstSet = lightsUBODescriptorset;
     descriptorWrites[0].dstBinding = 1;
     descriptorWrites[0].dstArrayElement = 0;
-    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrites[0].descriptorType =
+      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     descriptorWrites[0].descriptorCount = 1;
     descriptorWrites[0].pBufferInfo = &directionalLightBufferInfo;
 
@@ -334,7 +340,8 @@ Scene::createDescriptors()
     descriptorWrites[1].dstSet = lightsUBODescriptorset;
     descriptorWrites[1].dstBinding = 2;
     descriptorWrites[1].dstArrayElement = 0;
-    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrites[1].descriptorType =
+      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     descriptorWrites[1].descriptorCount = 1;
     descriptorWrites[1].pBufferInfo = &pointLightBufferInfo;
 
@@ -342,7 +349,8 @@ Scene::createDescriptors()
     descriptorWrites[2].dstSet = lightsUBODescriptorset;
     descriptorWrites[2].dstBinding = 3;
     descriptorWrites[2].dstArrayElement = 0;
-    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrites[2].descriptorType =
+      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     descriptorWrites[2].descriptorCount = 1;
     descriptorWrites[2].pBufferInfo = &spotLightBufferInfo;
 
@@ -370,87 +378,138 @@ Scene::createDescriptors()
   }
 }
 
-void
-Scene::createBuffers()
-{
-  // --------------------- Camera Buffer ---------------------
-  VkDeviceSize uboBufferSize = sizeof(CameraBuffer);
-
-  cameraBuffer.mapped =
-    vkContext->createBuffer(uboBufferSize,
-                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                            BufferType::STAGING_BUFFER,
-                            cameraBuffer.buffer,
-                            cameraBuffer.allocation);
-
-  // --------------------- Light Buffers ---------------------
-  VkDeviceSize directionalLightBufferSize = sizeof(DirectionalLight);
-
-  VkDeviceSize pointLightBufferSize = sizeof(PointLight) * MAX_POINT_LIGHTS;
-
-  VkDeviceSize spotLightBufferSize = sizeof(SpotLight) * MAX_SPOT_LIGHTS;
-
-  directionalLightBuffer.mapped =
-    vkContext->createBuffer(directionalLightBufferSize,
-                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                            BufferType::STAGING_BUFFER,
-                            directionalLightBuffer.buffer,
-                            directionalLightBuffer.allocation);
-
-  pointLightsBuffer.mapped =
-    vkContext->createBuffer(pointLightBufferSize,
-                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                            BufferType::STAGING_BUFFER,
-                            pointLightsBuffer.buffer,
-                            pointLightsBuffer.allocation);
-
-  spotLightsBuffer.mapped =
-    vkContext->createBuffer(spotLightBufferSize,
-                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                            BufferType::STAGING_BUFFER,
-                            spotLightsBuffer.buffer,
-                            spotLightsBuffer.allocation);
-
-  uint8_t* directionalMapped =
-    reinterpret_cast<uint8_t*>(directionalLightBuffer.mapped);
-  memcpy(directionalMapped, directionalLight, directionalLightBufferSize);
-
-  uint8_t* pointMapped = reinterpret_cast<uint8_t*>(pointLightsBuffer.mapped);
-  memcpy(pointMapped, pointLights.data(), pointLightBufferSize);
-
-  if (!spotLights.empty()) {
-    uint8_t* spotMapped = reinterpret_cast<uint8_t*>(spotLightsBuffer.mapped);
-    memcpy(spotMapped, spotLights.data(), spotLightBufferSize);
-  }
-}
-
 void
 Scene::update()
 {
-  // update camera data
-  CameraBuffer cb;
-
-  if (spotLights.size() > MAX_SPOT_LIGHTS) {
-    throw std::runtime_error("spotLights > MAX_SPOT_LIGHTS");
-  }
+  CpuProfileScope scope(vkContext->profiler, "Scene::update");
 
   // position, target, up
-  cb.view = camera->getCameraMatrix();
-  cb.proj = camera->getCameraProjectionMatrix();
-  cb.cameraPos = glm::vec4(camera->getCameraPos(), 1);
+  cameraData.view = camera->getCameraMatrix();
+  cameraData.proj = camera->getCameraProjectionMatrix();
+  cameraData.cameraPos = glm::vec4(camera->getCameraPos(), 1);
 
   models[1].rotate(1.0, glm::vec3(1.0, 0.5, 0.3));
 
+  // proj[1][1] is 1 / tan(fov / 2), half the viewport covers that many units
+  // at a distance of one
+  lodSelector.eye = camera->getCameraPos();
+  lodSelector.projectionScale =
+    std::fabs(cameraData.proj[1][1]) * camera->getViewportHeight() * 0.5f;
+  lodSelector.maxPixelError = LOD_PIXEL_ERROR;
+  shadowLodSelector = lodSelector;
+  shadowLodSelector.maxPixelError = LOD_PIXEL_ERROR * LOD_SHADOW_BIAS;
+
+  cullInstances();
+
   // directionalLight->follow(camera->getCameraPos() +
   //                          (-glm::vec3(directionalLight->getDirection())));
-  // uint8_t* directionalMapped =
-  //   reinterpret_cast<uint8_t*>(directionalLightBuffer.mapped);
-  // memcpy(directionalMapped, directionalLight, sizeof(DirectionalLight));
 
   // spotLights[1].move(glm::vec4(camera->getCameraPos(), 1.0),
   //                    glm::vec4(camera->getCameraFront(), 1.0));
-  // uint8_t* spotMapped = reinterpret_cast<uint8_t*>(spotLightsBuffer.mapped);
-  // memcpy(spotMapped, spotLights.data(), sizeof(SpotLight) * MAX_SPOT_LIGHTS);
+}
 
-  memcpy(cameraBuffer.mapped, &cb, sizeof(CameraBuffer));
+void
+Scene::cullInstances()
+{
+  CpuProfileScope scope(vkContext->profiler, "frustum culling");
+
+  // the boxes are gathered again every frame, any model may have moved
+  instances.clear();
+  for (const Model& model : models) {
+    for (const MeshInstance& instance : model.meshInstances) {
+      instances.push_back(&instance);
+    }
+  }
+
+  culler.resize(instances.size());
+  for (size_t i = 0; i < instances.size(); i++) {
+    culler.setBox(i, instances[i]->worldMin, instances[i]->worldMax);
+  }
+  culler.cull(getViewProjection(), visibleIndices);
+
+  visibleInstances.clear();
+  for (uint32_t index : visibleIndices) {
+    visibleInstances.push_back(instances[index]);
+  }
+}
+
+void
+Scene::prepareFrame(uint32_t frameIndex)
+{
+  for (Model& model : models) {
+    model.prepareFrame(frameIndex);
+  }
+  lightCube->prepareFrame(frameIndex);
+}
+
+void
+Scene::uploadFrameData()
+{
+  StagingRing* ring = vkContext->stagingRing;
+  VkDeviceSize alignment = ring->getUniformAlignment();
+
+  // the whole range of every binding is always allocated, the light slots that
+  // aren't in use are zeroed so the shaders never read stale ring memory
+  auto upload = [ring, alignment](const void* data,
+                                  VkDeviceSize dataSize,
+                                  VkDeviceSize range) -> uint32_t {
+    StagingAllocation allocation = ring->allocateFrameData(range, alignment);
+
+    // data is null for an empty light vector
+    if (dataSize > 0) {
+      memcpy(allocation.mapped, data, static_cast<size_t>(dataSize));
+    }
+    memset(static_cast<char*>(allocation.mapped) + dataSize,
+           0,
+           static_cast<size_t>(range - dataSize));
+    ring->flush(allocation);
+    return static_cast<uint32_t>(allocation.offset);
+  };
+
+  cameraUBOOffset =
+    upload(&cameraData, sizeof(CameraBuffer), sizeof(CameraBuffer));
+
+  // lights are tiny, re-uploading them every frame is cheaper than tracking
+  // which copy is stale. the uniform arrays only take the first
+  // MAX_POINT_LIGHTS and MAX_SPOT_LIGHTS, ClusteredLights uploads all of them
+  lightsUBOOffsets[0] = upload(
+    directionalLight, sizeof(DirectionalLight), sizeof(DirectionalLight));
+  lightsUBOOffsets[1] = upload(
+    pointLights.data(),
+    sizeof(PointLight) * std::min<size_t>(pointLights.size(), MAX_POINT_LIGHTS),
+    sizeof(PointLight) * MAX_POINT_LIGHTS);
+  lightsUBOOffsets[2] = upload(
+    spotLights.data(),
+    sizeof(SpotLight) * std::min<size_t>(spotLights.size(), MAX_SPOT_LIGHTS),
+    sizeof(SpotLight) * MAX_SPOT_LIGHTS);
+
+  // every visible instance of a mesh goes into the same draw, as long as
+  // they picked the same level of detail. the depth is the one of the center
+  // of its box in view space
+  cameraInstances.clear();
+  for (const MeshInstance* instance : visibleInstances) {
+    glm::vec3 center = 0.5f * (instance->worldMin + instance->worldMax);
+    cameraInstances.add(
+      instance->mesh,
+      instance->mesh->selectLod(instance->transformation, lodSelector),
+      instance->transformation,
+      -(cameraData.view * glm::vec4(center, 1.0f)).z);
+  }
+  cameraInstances.upload();
+
+  lightCubeInstances.clear();
+  for (const PointLight& pointLight : pointLights) {
+    glm::mat4 placement =
+      glm::translate(glm::mat4(1.0f), glm::vec3(pointLight.getPosition()));
+    placement = glm::scale(placement, glm::vec3(0.1f));
+    for (const MeshInstance& instance : lightCube->meshInstances) {
+      // one batch, nothing to sort
+      lightCubeInstances.add(instance.mesh,
+                             instance.mesh->lods[0],
+                             placement * instance.transformation,
+                             0.0f,
+                             glm::vec4(glm::vec3(pointLight.getColor()), 1.0f));
+    }
+  }
+  lightCubeInstances.upload();
 }
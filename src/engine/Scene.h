@@ -3,30 +3,71 @@
 
 #include "engine/Buffers.h"
 #include "engine/Camera3D.h"
+#include "engine/FrustumCuller.h"
+#include "engine/InstanceBatcher.h"
 #include "engine/LightManager.h"
 #include "engine/ModelLoading/Model.h"
 #include "engine/Skybox.h"
 #include "engine/VulkanContext.h"
 
+#include <array>
+
 class Scene
 {
 public:
   Scene(VulkanContext* vkContext);
   ~Scene();
 
-  void update(); // used for sending data to GPU in case camera or lights have
-                 // changed.
+  void update(); // used for updating camera and lights on the cpu side
+
+  // writes camera and lights into the staging ring and updates the offsets
+  // below. called once per frame, between prepareFrame and submitFrame.
+  void uploadFrameData();
+
+  // lets the meshes pick up streamed textures in the descriptor sets of
+  // frameIndex, called right after the fence of that frame has been waited on
+  void prepareFrame(uint32_t frameIndex);
 
   VkDescriptorSetLayout cameraUBOLayout;
   VkDescriptorSetLayout lightsUBOLayout;
   VkDescriptorSetLayout directionalShadowMapLayout;
 
+  // both use dynamic uniform buffers, bind them with the offsets of the
+  // current frame
   VkDescriptorSet cameraUBODescriptorset;
   VkDescriptorSet lightsUBODescriptorset;
+  uint32_t cameraUBOOffset = 0;
+  std::array<uint32_t, 3> lightsUBOOffsets{}; // directional, point, spot
   VkDescriptorSet shadowMapDescriptorSet;
 
   std::vector<Model> models;
-  std::vector<Model> lightCubes;
+  // drawn once for every point light, at its position and in its color
+  Model* lightCube;
+
+  // the instances of models that touch the camera frustum, in model order,
+  // updated by update(). the camera passes draw them through cameraInstances
+  std::vector<const MeshInstance*> visibleInstances;
+
+  // every instance of models, with its world space box at the same index in
+  // culler. the shadow pass culls these again for each light view
+  std::vector<const MeshInstance*> instances;
+  FrustumCuller culler;
+
+  // the visible instances and the light cubes grouped into instanced draws,
+  // rebuilt by uploadFrameData()
+  InstanceBatcher cameraInstances;
+  InstanceBatcher lightCubeInstances;
+
+  // levels of detail are picked from the camera in every pass, the shadow
+  // passes just accept a larger error. updated by update()
+  LodSelector lodSelector;
+  LodSelector shadowLodSelector;
+
+  // of the camera, as of the last update()
+  glm::mat4 getViewProjection() const
+  {
+    return cameraData.proj * cameraData.view;
+  }
 
   Skybox* skybox;
 
@@ -43,11 +84,10 @@ private:
 
   void createDescriptors();
 
-  VulkanBufferDefinition cameraBuffer;
-  VulkanBufferDefinition pointLightsBuffer;
-  VulkanBufferDefinition directionalLightBuffer;
-  VulkanBufferDefinition spotLightsBuffer;
-  void createBuffers();
+  CameraBuffer cameraData;
+
+  std::vector<uint32_t> visibleIndices;
+  void cullInstances();
 };
 
 #endif
@@ -0,0 +1,76 @@
+#include "engine/ShaderLibrary.h"
+
+#include "engine/MappedFile.h"
+
+#include <cstring>
+#include <stdexcept>
+
+ShaderLibrary::ShaderLibrary(VulkanContext* vkContext,
+                             const std::string& directory)
+  : vkContext(vkContext)
+  , directory(directory)
+{
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+  for (auto& module : modules) {
+    vkDestroyShaderModule(
+      vkContext->logicalDevice, module.second.module, nullptr);
+  }
+}
+
+VkShaderModule
+ShaderLibrary::get(const std::string& name)
+{
+  auto it = modulesByName.find(name);
+  if (it != modulesByName.end()) {
+    return it->second;
+  }
+
+  // the mapping is page aligned, so it can be handed to vulkan as uint32_t
+  // words without a copy
+  MappedFile file;
+  if (!file.open(directory + name)) {
+    throw std::runtime_error("failed to open file! " + directory + name);
+  }
+  if (file.size() % sizeof(uint32_t) != 0) {
+    throw std::runtime_error("not a spir-v file! " + directory + name);
+  }
+
+  // 64 bit FNV-1a over the whole file
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < file.size(); i++) {
+    hash ^= file.data()[i];
+    hash *= 1099511628211ull;
+  }
+
+  // two different files can still hash the same, only reuse a module whose
+  // file has the exact same bytes
+  Key key{ hash, file.size() };
+  auto range = modules.equal_range(key);
+  for (auto found = range.first; found != range.second; ++found) {
+    MappedFile other;
+    if (other.open(found->second.path) && other.size() == file.size() &&
+        memcmp(other.data(), file.data(), file.size()) == 0) {
+      modulesByName[name] = found->second.module;
+      return found->second.module;
+    }
+  }
+
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = file.size();
+  createInfo.pCode = reinterpret_cast<const uint32_t*>(file.data());
+
+  VkShaderModule module;
+  if (vkCreateShaderModule(
+        vkContext->logicalDevice, &createInfo, nullptr, &module) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module!");
+  }
+
+  modules.insert({ key, { module, directory + name } });
+  modulesByName[name] = module;
+  return module;
+}
@@ -0,0 +1,71 @@
+#ifndef _SHADER_LIBRARY_H_
+#define _SHADER_LIBRARY_H_
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "engine/VulkanContext.h"
+
+// every VkShaderModule the passes use. a .spv file is mapped and turned into a
+// module the first time it's asked for, after that the name alone finds it.
+// files with the same contents share one module, they're looked up by a hash
+// of the spir-v words and its size and compared byte for byte on a match.
+//
+// the library owns the modules, they stay alive until it's destroyed so
+// pipelines can be created from them at any point. only the main thread asks
+// for modules, pipeline jobs get the handles handed to them.
+class ShaderLibrary
+{
+public:
+  // directory is prepended to every name, SHADER_PATH in practice
+  ShaderLibrary(VulkanContext* vkContext, const std::string& directory);
+  ~ShaderLibrary();
+
+  ShaderLibrary(const ShaderLibrary&) = delete;
+  ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+  VkShaderModule get(const std::string& name);
+
+  size_t getFileCount() const { return modulesByName.size(); }
+  size_t getModuleCount() const { return modules.size(); }
+
+private:
+  VulkanContext* vkContext;
+  std::string directory;
+
+  struct Key
+  {
+    uint64_t hash;
+    size_t size;
+
+    bool operator==(const Key& other) const
+    {
+      return hash == other.hash && size == other.size;
+    }
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const Key& key) const
+    {
+      return static_cast<size_t>(key.hash);
+    }
+  };
+
+  // the file a module was created from, mapped again to compare it with a
+  // file that has the same key
+  struct Module
+  {
+    VkShaderModule module;
+    std::string path;
+  };
+
+  std::unordered_map<std::string, VkShaderModule> modulesByName;
+  std::unordered_multimap<Key, Module, KeyHash> modules;
+};
+
+#endif
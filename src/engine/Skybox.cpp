@@ -1,6 +1,12 @@
 #include "engine/Skybox.h"
+#include "engine/JobSystem.h"
+#include "engine/KtxLoader.h"
+#include "engine/SamplerCache.h"
+#include "engine/UploadBatcher.h"
 
 #include <stb_image.h>
+#include <cstring>
+#include <future>
 #include <stdexcept>
 #include <vector>
 
@@ -12,63 +18,118 @@ Skybox::Skybox(VulkanContext* vkContext, std::array<std::string, 6> filePaths)
   std::string modelPath = MODEL_PATH;
   cube = std::make_unique<Model>(modelPath + "cube.glb", vkContext);
 
-  int texWidth, texHeight, texChannels;
-
   if (image != VK_NULL_HANDLE) {
     throw std::runtime_error("Skybox already present!");
   }
 
-  std::vector<stbi_uc*> pixels;
-  pixels.resize(filePaths.size());
-  for (int i = 0; i < filePaths.size(); i++) {
-    pixels[i] = stbi_load(filePaths[i].c_str(),
-                          &texWidth,
-                          &texHeight,
-                          &texChannels,
-                          STBI_rgb_alpha);
-    if (!pixels[i]) {
-      throw std::runtime_error("Failed to load texture image from memory!");
-    }
+  // a precompressed cubemap next to the faces, "skybox/right.jpg" looks for
+  // skybox/skybox.ktx (and its .bc7/.astc/.etc2 variants)
+  std::string directory =
+    filePaths[0].substr(0, filePaths[0].find_last_of("/\\") + 1);
+  if (!createCubemapFromKtx(directory + "skybox")) {
+    createCubemapFromFaces(filePaths);
   }
 
-  VkDeviceSize imageSize = static_cast<uint64_t>(texWidth) *
-                           static_cast<uint64_t>(texHeight) * 4 *
-                           sizeof(stbi_uc);
+  // -------------------- CREATE IMAGE VIEW --------------------
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+  viewInfo.format = format;
+  viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+  viewInfo.subresourceRange.layerCount = 6;
+  viewInfo.subresourceRange.levelCount = mipLevels;
 
-  VkBuffer stagingBuffer;
-  VmaAllocation stagingBufferAllocation;
-
-  char* data =
-    static_cast<char*>(vkContext->createBuffer(imageSize * filePaths.size(),
-                                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                               BufferType::STAGING_BUFFER,
-                                               stagingBuffer,
-                                               stagingBufferAllocation));
-
-  size_t byteOffset = 0;
-  std::vector<size_t> byteOffsets;
-  byteOffsets.resize(filePaths.size());
-
-  // Put all the image data into a single buffer
-  for (int i = 0; i < pixels.size(); i++) {
-    data += byteOffset;
-    memcpy(data, pixels[i], imageSize * sizeof(stbi_uc));
-    byteOffset = imageSize;
+  if (vkCreateImageView(vkContext->logicalDevice, &viewInfo, nullptr, &view) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture image view!");
   }
 
-  // populate the offsets vector
-  for (int i = 0; i < byteOffsets.size(); i++) {
-    if (i == 0) {
-      byteOffsets[i] = 0;
-    } else {
-      byteOffsets[i] += imageSize + byteOffsets[i - 1];
+  // -------------------- CREATE SAMPLER --------------------
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = samplerInfo.addressModeU;
+  samplerInfo.addressModeW = samplerInfo.addressModeU;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+  samplerInfo.maxAnisotropy = 1.0f;
+  samplerInfo.maxAnisotropy =
+    vkContext->deviceProperties.limits.maxSamplerAnisotropy;
+  samplerInfo.anisotropyEnable = VK_TRUE;
+
+  sampler = vkContext->samplerCache->get(samplerInfo);
+
+  setupDescriptors();
+}
+
+bool
+Skybox::createCubemapFromKtx(const std::string& filePath)
+{
+  for (const std::string& candidate : getKtxCandidates(filePath)) {
+    KtxImage ktx;
+    if (!loadKtxImage(vkContext, candidate, ktx)) {
+      continue;
+    }
+
+    if (ktx.layerCount != 6) {
+      vmaDestroyImage(vkContext->allocator, ktx.image, ktx.allocation);
+      throw std::runtime_error("ktx skybox is not a cubemap! " + candidate);
     }
+
+    image = ktx.image;
+    imageAllocation = ktx.allocation;
+    format = ktx.format;
+    mipLevels = ktx.mipLevels;
+    return true;
   }
+  return false;
+}
 
-  for (auto& currentPixeData : pixels) {
-    stbi_image_free(currentPixeData);
+void
+Skybox::createCubemapFromFaces(const std::array<std::string, 6>& filePaths)
+{
+  // the six faces are decoded in parallel on the job system
+  std::array<std::future<ImageData>, 6> decodes;
+  for (size_t i = 0; i < filePaths.size(); i++) {
+    std::string filePath = filePaths[i];
+    decodes[i] = vkContext->jobSystem->submit([filePath]() {
+      ImageData image;
+      Texture::decode(filePath, image);
+      return image;
+    });
   }
 
+  std::array<ImageData, 6> faces;
+  for (size_t i = 0; i < faces.size(); i++) {
+    faces[i] = decodes[i].get();
+  }
+
+  for (const ImageData& face : faces) {
+    if (!face.valid()) {
+      throw std::runtime_error("Failed to load texture image from memory!");
+    }
+    if (face.width != faces[0].width || face.height != faces[0].height) {
+      throw std::runtime_error("skybox faces have different sizes!");
+    }
+  }
+
+  int texWidth = faces[0].width;
+  int texHeight = faces[0].height;
+
+  VkDeviceSize imageSize = static_cast<uint64_t>(texWidth) *
+                           static_cast<uint64_t>(texHeight) * 4 *
+                           sizeof(stbi_uc);
+
+  mipLevels = VulkanContext::getMipLevels(texWidth, texHeight);
+
   // -------------------- CREATE IMAGE --------------------
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -76,12 +137,13 @@ Skybox::Skybox(VulkanContext* vkContext, std::array<std::string, 6> filePaths)
   imageInfo.extent.width = texWidth;
   imageInfo.extent.height = texHeight;
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
+  imageInfo.mipLevels = mipLevels;
   imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
   imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
   imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  imageInfo.usage =
-    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT;
   imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
   imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -103,173 +165,29 @@ Skybox::Skybox(VulkanContext* vkContext, std::array<std::string, 6> filePaths)
     throw std::runtime_error("failed to create image!");
   }
 
-  // Copy data from staging buffer to image
-  transitionImageLayout(image,
-                        VK_FORMAT_R8G8B8A8_SRGB,
-                        byteOffsets,
-                        VK_IMAGE_LAYOUT_UNDEFINED,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  copyBufferToImage(stagingBuffer,
-                    image,
-                    byteOffsets,
-                    static_cast<uint32_t>(texWidth),
-                    static_cast<uint32_t>(texHeight));
-  transitionImageLayout(image,
-                        VK_FORMAT_R8G8B8A8_SRGB,
-                        byteOffsets,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-  // -------------------- CREATE IMAGE VIEW --------------------
-  VkImageViewCreateInfo viewInfo{};
-  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-  viewInfo.image = image;
-  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-  viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
-  viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-
-  viewInfo.subresourceRange.layerCount = 6;
-  viewInfo.subresourceRange.levelCount = 1;
-
-  if (vkCreateImageView(vkContext->logicalDevice, &viewInfo, nullptr, &view) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to create texture image view!");
+  // all six faces go into one staging buffer, one after the other
+  char* data = static_cast<char*>(
+    vkContext->uploadBatcher->stageImage(image,
+                                         static_cast<uint32_t>(texWidth),
+                                         static_cast<uint32_t>(texHeight),
+                                         static_cast<uint32_t>(faces.size()),
+                                         imageSize,
+                                         mipLevels));
+  for (size_t i = 0; i < faces.size(); i++) {
+    memcpy(data + imageSize * i, faces[i].pixels.get(), imageSize);
   }
-
-  // -------------------- CREATE SAMPLER --------------------
-  VkPhysicalDeviceProperties properties{};
-  vkGetPhysicalDeviceProperties(vkContext->physicalDevice, &properties);
-
-  VkSamplerCreateInfo samplerInfo{};
-  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-  samplerInfo.magFilter = VK_FILTER_LINEAR;
-  samplerInfo.minFilter = VK_FILTER_LINEAR;
-  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-  samplerInfo.addressModeV = samplerInfo.addressModeU;
-  samplerInfo.addressModeW = samplerInfo.addressModeU;
-  samplerInfo.mipLodBias = 0.0f;
-  samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
-  samplerInfo.minLod = 0.0f;
-  samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-  samplerInfo.maxAnisotropy = 1.0f;
-  samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-  samplerInfo.anisotropyEnable = VK_TRUE;
-
-  if (vkCreateSampler(
-        vkContext->logicalDevice, &samplerInfo, nullptr, &sampler) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to create texture sampler!");
-  }
-
-  vmaDestroyBuffer(
-    vkContext->allocator, stagingBuffer, stagingBufferAllocation);
-
-  setupDescriptors();
 }
 
 Skybox::~Skybox()
 {
   vkDestroyImageView(vkContext->logicalDevice, view, nullptr);
   vmaDestroyImage(vkContext->allocator, image, imageAllocation);
-  vkDestroySampler(vkContext->logicalDevice, sampler, nullptr);
 
   vkDestroyDescriptorSetLayout(vkContext->logicalDevice, skyboxLayout, nullptr);
 
   vkDestroyDescriptorPool(vkContext->logicalDevice, descriptorPool, nullptr);
 }
 
-void
-Skybox::transitionImageLayout(VkImage image,
-                              VkFormat format,
-                              std::vector<size_t> offsets,
-                              VkImageLayout oldLayout,
-                              VkImageLayout newLayout)
-{
-  VkCommandBuffer commandBuffer = vkContext->beginSingleTimeCommands();
-
-  // -------------------- TRANSITION LAYOUT --------------------
-  VkImageMemoryBarrier barrier{};
-  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  barrier.oldLayout = oldLayout;
-  barrier.newLayout = newLayout;
-  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  barrier.image = image;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
-  barrier.subresourceRange.baseArrayLayer = 0;
-  barrier.subresourceRange.layerCount = offsets.size();
-
-  VkPipelineStageFlags sourceStage;
-  VkPipelineStageFlags destinationStage;
-
-  if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-      newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-  } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-             newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-  } else {
-    throw std::invalid_argument("unsupported layout transition!");
-  }
-
-  vkCmdPipelineBarrier(commandBuffer,
-                       sourceStage,
-                       destinationStage,
-                       0,
-                       0,
-                       nullptr,
-                       0,
-                       nullptr,
-                       1,
-                       &barrier);
-
-  vkContext->endSingleTimeCommands(commandBuffer);
-}
-
-void
-Skybox::copyBufferToImage(VkBuffer buffer,
-                          VkImage image,
-                          std::vector<size_t> offsets,
-                          uint32_t width,
-                          uint32_t height)
-{
-  VkCommandBuffer commandBuffer = vkContext->beginSingleTimeCommands();
-
-  std::vector<VkBufferImageCopy> bufferCopyRegions;
-  for (int i = 0; i < offsets.size(); i++) {
-    VkBufferImageCopy bufferCopyRegion = {};
-    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    bufferCopyRegion.imageSubresource.mipLevel = 0;
-    bufferCopyRegion.imageSubresource.baseArrayLayer = i;
-    bufferCopyRegion.imageSubresource.layerCount = 1;
-    bufferCopyRegion.imageExtent.width = width;
-    bufferCopyRegion.imageExtent.height = height;
-    bufferCopyRegion.imageExtent.depth = 1;
-    bufferCopyRegion.bufferOffset = offsets[i];
-    bufferCopyRegions.push_back(bufferCopyRegion);
-  }
-
-  vkCmdCopyBufferToImage(commandBuffer,
-                         buffer,
-                         image,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                         static_cast<uint32_t>(bufferCopyRegions.size()),
-                         bufferCopyRegions.data());
-
-  vkContext->endSingleTimeCommands(commandBuffer);
-}
-
 void
 Skybox::setupDescriptors()
 {
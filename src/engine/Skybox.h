@@ -31,21 +31,16 @@ private:
 
   VkImage image = VK_NULL_HANDLE;
   VkImageView view = VK_NULL_HANDLE;
-  VkSampler sampler = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE; // owned by the SamplerCache
 
   VmaAllocation imageAllocation = VK_NULL_HANDLE;
+  VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+  uint32_t mipLevels = 1;
 
-  void transitionImageLayout(VkImage image,
-                             VkFormat format,
-                             std::vector<size_t> offsets,
-                             VkImageLayout oldLayout,
-                             VkImageLayout newLayout);
-
-  void copyBufferToImage(VkBuffer buffer,
-                         VkImage image,
-                         std::vector<size_t> offsets,
-                         uint32_t width,
-                         uint32_t height);
+  // false when there is no usable .ktx cubemap for filePath
+  bool createCubemapFromKtx(const std::string& filePath);
+  // six separate images, mips generated on upload
+  void createCubemapFromFaces(const std::array<std::string, 6>& filePaths);
 
   void createTextureImageView();
 
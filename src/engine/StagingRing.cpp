@@ -0,0 +1,122 @@
+#include "engine/StagingRing.h"
+#include "engine/UploadBatcher.h"
+
+#include <stdexcept>
+
+StagingRing::StagingRing(VulkanContext* vkContext, VkDeviceSize size)
+  : vkContext(vkContext)
+  , size(size)
+{
+  uniformAlignment =
+    vkContext->deviceProperties.limits.minUniformBufferOffsetAlignment;
+
+  // uniform and storage usage so the per-frame data can be bound straight
+  // from the ring with dynamic offsets, vertex usage for the instance data
+  mapped = static_cast<char*>(vkContext->createBuffer(
+    size,
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+    BufferType::STAGING_BUFFER,
+    buffer,
+    allocation));
+  vmaSetAllocationName(vkContext->allocator, allocation, "stagingRing");
+}
+
+StagingRing::~StagingRing()
+{
+  vmaDestroyBuffer(vkContext->allocator, buffer, allocation);
+}
+
+StagingAllocation
+StagingRing::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment)
+{
+  StagingAllocation result;
+  if (allocationSize == 0 || allocationSize > size) {
+    return result;
+  }
+
+  VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+  VkDeviceSize padding = offset - head;
+
+  // doesn't fit before the end, skip what's left and start over from zero
+  if (offset + allocationSize > size) {
+    padding = size - head;
+    offset = 0;
+  }
+
+  // the free space is contiguous starting at head (wrapping around), so this
+  // is the only check needed
+  if (used + padding + allocationSize > size) {
+    return result;
+  }
+
+  head = offset + allocationSize;
+  used += padding + allocationSize;
+  openBytes += padding + allocationSize;
+
+  result.buffer = buffer;
+  result.offset = offset;
+  result.size = allocationSize;
+  result.mapped = mapped + offset;
+  return result;
+}
+
+StagingAllocation
+StagingRing::allocateFrameData(VkDeviceSize allocationSize,
+                               VkDeviceSize alignment)
+{
+  StagingAllocation result = allocate(allocationSize, alignment);
+  if (!result.valid()) {
+    vkContext->uploadBatcher->waitIdle();
+    result = allocate(allocationSize, alignment);
+  }
+
+  if (!result.valid()) {
+    throw std::runtime_error("staging ring is out of space for frame data!");
+  }
+  return result;
+}
+
+uint64_t
+StagingRing::closeRegion()
+{
+  if (openBytes == 0) {
+    return 0;
+  }
+
+  uint64_t id = nextRegion++;
+  regions.push_back({ id, openBytes, false });
+  openBytes = 0;
+  return id;
+}
+
+void
+StagingRing::release(uint64_t region)
+{
+  if (region == 0) {
+    return;
+  }
+
+  for (auto& r : regions) {
+    if (r.id == region) {
+      r.released = true;
+      break;
+    }
+  }
+
+  // regions can complete out of order (an upload batch and a frame), the
+  // memory only comes back once everything before it is done too
+  while (!regions.empty() && regions.front().released) {
+    used -= regions.front().bytes;
+    regions.pop_front();
+  }
+}
+
+void
+StagingRing::flush(const StagingAllocation& stagingAllocation)
+{
+  vmaFlushAllocation(vkContext->allocator,
+                     allocation,
+                     stagingAllocation.offset,
+                     stagingAllocation.size);
+}
@@ -0,0 +1,92 @@
+#ifndef _STAGING_RING_H_
+#define _STAGING_RING_H_
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_core.h>
+
+#include <deque>
+
+#include "engine/VulkanContext.h"
+
+// size of the ring in bytes. it's set from cmake, the fallback is here so the
+// header works on its own
+#ifndef STAGING_RING_SIZE
+#define STAGING_RING_SIZE (64 * 1024 * 1024)
+#endif
+
+struct StagingAllocation
+{
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void* mapped = nullptr;
+
+  bool valid() const { return mapped != nullptr; }
+};
+
+// one big persistently mapped host visible buffer, handed out linearly. used
+// for upload staging and for the per-frame uniform data, so nothing on the
+// hot path goes through the allocator.
+//
+// allocations are grouped into regions: closeRegion() seals everything
+// allocated since the previous call, right before the submission that
+// consumes it, and release() hands the region back once that submission's
+// fence has signaled. memory is reclaimed in order, oldest region first.
+class StagingRing
+{
+public:
+  StagingRing(VulkanContext* vkContext, VkDeviceSize size);
+  ~StagingRing();
+
+  StagingRing(const StagingRing&) = delete;
+  StagingRing& operator=(const StagingRing&) = delete;
+
+  // returns an invalid allocation when the ring is full, it's up to the
+  // caller to release older regions and try again (or fall back to its own
+  // buffer)
+  StagingAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+  // for the data of the frame being recorded. load time uploads and streamed
+  // textures share the ring, when it's full the upload batches in flight are
+  // waited on to get their regions back and it tries again. throws only if
+  // the frame data doesn't fit even then. Renderer::draw flushes the uploads
+  // before any frame data goes in, so none of it ends up in an upload region
+  StagingAllocation allocateFrameData(VkDeviceSize size,
+                                      VkDeviceSize alignment = 16);
+
+  // 0 means nothing was allocated, releasing it is a no-op
+  uint64_t closeRegion();
+  void release(uint64_t region);
+
+  // the memory isn't guaranteed to be host coherent
+  void flush(const StagingAllocation& allocation);
+
+  VkBuffer getBuffer() const { return buffer; }
+  VkDeviceSize getSize() const { return size; }
+  VkDeviceSize getUniformAlignment() const { return uniformAlignment; }
+
+private:
+  VulkanContext* vkContext;
+
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  char* mapped = nullptr;
+
+  VkDeviceSize size;
+  VkDeviceSize uniformAlignment;
+
+  VkDeviceSize head = 0; // next free byte
+  VkDeviceSize used = 0; // bytes between the oldest live region and head
+
+  struct Region
+  {
+    uint64_t id;
+    VkDeviceSize bytes; // including alignment and wrap-around padding
+    bool released;
+  };
+  std::deque<Region> regions;
+  VkDeviceSize openBytes = 0;
+  uint64_t nextRegion = 1;
+};
+
+#endif
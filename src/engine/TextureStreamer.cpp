@@ -0,0 +1,334 @@
+#include "engine/TextureStreamer.h"
+#include "engine/JobSystem.h"
+#include "engine/UploadBatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// the low copy is downscaled until it fits in this many pixels per side
+static const int LOW_RES_SIZE = 64;
+// full images uploaded per update(), anything past it waits for the next
+// frame so a burst of finished decodes doesn't turn into a hitch
+static const VkDeviceSize UPLOAD_BYTES_PER_FRAME = 32 * 1024 * 1024;
+
+// 2x2 box filter until both sides are at most maxSize
+static ImageData
+downsample(const ImageData& source, int maxSize)
+{
+  int width = source.width;
+  int height = source.height;
+  std::vector<stbi_uc> current(source.pixels.get(),
+                               source.pixels.get() + width * height * 4);
+
+  while (width > maxSize || height > maxSize) {
+    int nextWidth = std::max(width / 2, 1);
+    int nextHeight = std::max(height / 2, 1);
+    std::vector<stbi_uc> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+    for (int y = 0; y < nextHeight; y++) {
+      int y0 = std::min(y * 2, height - 1);
+      int y1 = std::min(y * 2 + 1, height - 1);
+      for (int x = 0; x < nextWidth; x++) {
+        int x0 = std::min(x * 2, width - 1);
+        int x1 = std::min(x * 2 + 1, width - 1);
+        for (int c = 0; c < 4; c++) {
+          int sum = current[(y0 * width + x0) * 4 + c] +
+                    current[(y0 * width + x1) * 4 + c] +
+                    current[(y1 * width + x0) * 4 + c] +
+                    current[(y1 * width + x1) * 4 + c];
+          next[(y * nextWidth + x) * 4 + c] = static_cast<stbi_uc>(sum / 4);
+        }
+      }
+    }
+
+    current.swap(next);
+    width = nextWidth;
+    height = nextHeight;
+  }
+
+  // stbi_image_free is a plain free() unless STBI_FREE is overridden
+  ImageData result;
+  result.width = width;
+  result.height = height;
+  result.pixels.reset(static_cast<stbi_uc*>(malloc(current.size())));
+  memcpy(result.pixels.get(), current.data(), current.size());
+  return result;
+}
+
+TextureStreamer::TextureStreamer(VulkanContext* vkContext,
+                                 VkDeviceSize budget,
+                                 uint32_t evictAfterFrames)
+  : vkContext(vkContext)
+  , budget(budget)
+  , evictAfterFrames(evictAfterFrames)
+{
+  if (!isEnabled()) {
+    return;
+  }
+
+  // mid grey, neutral enough for both diffuse and specular maps
+  ImageData grey;
+  grey.width = 1;
+  grey.height = 1;
+  grey.pixels.reset(static_cast<stbi_uc*>(malloc(4)));
+  memset(grey.pixels.get(), 128, 4);
+  grey.pixels.get()[3] = 255;
+
+  placeholder = createImage(grey);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+  for (TextureStream* stream : streams) {
+    destroyImage(stream->full);
+    destroyImage(stream->low);
+    delete stream;
+  }
+
+  for (Retired& image : retired) {
+    destroyImage(image.image);
+  }
+
+  destroyImage(placeholder);
+}
+
+TextureStream*
+TextureStreamer::add(const std::string& filePath)
+{
+  TextureStream* stream = new TextureStream();
+  stream->filePath = filePath;
+  stream->view = placeholder.view;
+  stream->lastUsedFrame = frame;
+
+  streams.push_back(stream);
+  request(stream, true);
+  return stream;
+}
+
+TextureStream*
+TextureStreamer::add(const unsigned char* data, size_t size)
+{
+  // the model the data came from is gone by the time the image is decoded,
+  // and the data is needed again if the texture ever gets evicted
+  TextureStream* stream = new TextureStream();
+  stream->encoded =
+    std::make_shared<const std::vector<unsigned char>>(data, data + size);
+  stream->view = placeholder.view;
+  stream->lastUsedFrame = frame;
+
+  streams.push_back(stream);
+  request(stream, true);
+  return stream;
+}
+
+void
+TextureStreamer::remove(TextureStream* stream)
+{
+  auto it = std::find(streams.begin(), streams.end(), stream);
+  if (it == streams.end()) {
+    return;
+  }
+  streams.erase(it);
+
+  if (stream->full.image != VK_NULL_HANDLE) {
+    residentBytes -= stream->full.size;
+  }
+  retire(stream->full);
+  retire(stream->low);
+
+  // a decode still running just finishes into a future nobody reads
+  delete stream;
+}
+
+void
+TextureStreamer::touch(TextureStream* stream)
+{
+  stream->lastUsedFrame = frame;
+
+  if (stream->full.image == VK_NULL_HANDLE && !stream->pending.valid() &&
+      !stream->failed) {
+    request(stream, false);
+  }
+}
+
+void
+TextureStreamer::update()
+{
+  frame++;
+
+  // -------------------- FINISHED DECODES --------------------
+  VkDeviceSize uploaded = 0;
+  for (TextureStream* stream : streams) {
+    if (uploaded >= UPLOAD_BYTES_PER_FRAME) {
+      break;
+    }
+
+    if (!stream->pending.valid() ||
+        stream->pending.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready) {
+      continue;
+    }
+
+    TextureStream::Pixels pixels = stream->pending.get();
+    if (!pixels.full.valid()) {
+      // stays on the placeholder, or on its low copy after an eviction
+      std::cout << "failed to stream texture "
+                << (stream->encoded ? "(embedded)" : stream->filePath)
+                << std::endl;
+      stream->failed = true;
+      continue;
+    }
+
+    if (pixels.low.valid() && stream->low.image == VK_NULL_HANDLE) {
+      stream->low = createImage(pixels.low);
+    }
+
+    // the copies are recorded into the upload batch, flushed before this
+    // frame is submitted, so the view can be swapped in right away
+    stream->full = createImage(pixels.full);
+    residentBytes += stream->full.size;
+    uploaded += stream->full.size;
+    setView(stream, stream->full.view);
+  }
+
+  evict();
+
+  // -------------------- RETIRED IMAGES --------------------
+  // a frame slot's descriptors are rewritten after its fence, so once every
+  // slot has been through that since the image was replaced nothing refers to
+  // it anymore
+  for (auto it = retired.begin(); it != retired.end();) {
+    if (frame > it->frame + MAX_FRAMES_IN_FLIGHT) {
+      destroyImage(it->image);
+      it = retired.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void
+TextureStreamer::request(TextureStream* stream, bool withLow)
+{
+  std::string filePath = stream->filePath;
+  std::shared_ptr<const std::vector<unsigned char>> encoded = stream->encoded;
+
+  stream->pending =
+    vkContext->jobSystem->submit([filePath, encoded, withLow]() {
+      TextureStream::Pixels pixels;
+      if (encoded) {
+        Texture::decode(encoded->data(), encoded->size(), pixels.full);
+      } else {
+        Texture::decode(filePath, pixels.full);
+      }
+
+      if (withLow && pixels.full.valid()) {
+        pixels.low = downsample(pixels.full, LOW_RES_SIZE);
+      }
+      return pixels;
+    });
+}
+
+void
+TextureStreamer::evict()
+{
+  if (residentBytes <= budget) {
+    return;
+  }
+
+  std::vector<TextureStream*> candidates;
+  for (TextureStream* stream : streams) {
+    if (stream->full.image != VK_NULL_HANDLE &&
+        frame - stream->lastUsedFrame > evictAfterFrames) {
+      candidates.push_back(stream);
+    }
+  }
+
+  std::sort(candidates.begin(),
+            candidates.end(),
+            [](const TextureStream* a, const TextureStream* b) {
+              return a->lastUsedFrame < b->lastUsedFrame;
+            });
+
+  for (TextureStream* stream : candidates) {
+    if (residentBytes <= budget) {
+      break;
+    }
+
+    residentBytes -= stream->full.size;
+    setView(stream,
+            stream->low.view != VK_NULL_HANDLE ? stream->low.view
+                                               : placeholder.view);
+    retire(stream->full);
+  }
+}
+
+StreamedImage
+TextureStreamer::createImage(const ImageData& pixels)
+{
+  StreamedImage result;
+
+  uint32_t width = static_cast<uint32_t>(pixels.width);
+  uint32_t height = static_cast<uint32_t>(pixels.height);
+  uint32_t mipLevels = VulkanContext::getMipLevels(width, height);
+
+  // TRANSFER_SRC because the mip chain is blitted from level 0
+  result.image =
+    vkContext->createImage(width,
+                           height,
+                           VK_FORMAT_R8G8B8A8_SRGB,
+                           1,
+                           VK_IMAGE_TILING_OPTIMAL,
+                           VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                             VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                             VK_IMAGE_USAGE_SAMPLED_BIT,
+                           VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+                           result.allocation,
+                           mipLevels);
+
+  vkContext->uploadBatcher->uploadImage(
+    result.image, pixels.pixels.get(), width, height, 1, mipLevels);
+
+  result.view = vkContext->createImageView(result.image,
+                                           VK_FORMAT_R8G8B8A8_SRGB,
+                                           1,
+                                           VK_IMAGE_ASPECT_COLOR_BIT,
+                                           mipLevels);
+
+  for (uint32_t i = 0; i < mipLevels; i++) {
+    result.size += static_cast<VkDeviceSize>(std::max(width >> i, 1u)) *
+                   std::max(height >> i, 1u) * 4;
+  }
+  return result;
+}
+
+void
+TextureStreamer::retire(StreamedImage& image)
+{
+  if (image.image != VK_NULL_HANDLE) {
+    retired.push_back({ image, frame });
+  }
+  image = StreamedImage();
+}
+
+void
+TextureStreamer::destroyImage(StreamedImage& image)
+{
+  if (image.image == VK_NULL_HANDLE) {
+    return;
+  }
+
+  vkDestroyImageView(vkContext->logicalDevice, image.view, nullptr);
+  vmaDestroyImage(vkContext->allocator, image.image, image.allocation);
+  image = StreamedImage();
+}
+
+void
+TextureStreamer::setView(TextureStream* stream, VkImageView view)
+{
+  stream->view = view;
+  stream->version++;
+}
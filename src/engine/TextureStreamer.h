@@ -0,0 +1,143 @@
+#ifndef _TEXTURE_STREAMER_H_
+#define _TEXTURE_STREAMER_H_
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "engine/ModelLoading/Texture.h"
+#include "engine/VulkanContext.h"
+
+// bytes of full resolution textures to keep resident, 0 turns streaming off
+// and every texture is loaded in full when it's created
+#ifndef TEXTURE_STREAMING_BUDGET
+#define TEXTURE_STREAMING_BUDGET (256 * 1024 * 1024)
+#endif
+// frames a texture has to go unused before its full mips can be evicted
+#ifndef TEXTURE_STREAMING_EVICT_FRAMES
+#define TEXTURE_STREAMING_EVICT_FRAMES 300
+#endif
+
+// an image owned by the streamer, full mip chain included
+struct StreamedImage
+{
+  VkImage image = VK_NULL_HANDLE;
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  VkDeviceSize size = 0;
+};
+
+// the streaming state of one texture. the texture only keeps a pointer to it,
+// everything in here is managed by the TextureStreamer on the main thread.
+struct TextureStream
+{
+  // where the pixels come from, decoded again whenever the full image has to
+  // be brought back after an eviction
+  std::string filePath;
+  std::shared_ptr<const std::vector<unsigned char>> encoded;
+
+  // a downscaled copy, uploaded once and never evicted
+  StreamedImage low;
+  // the full resolution image, dropped when over budget and unused
+  StreamedImage full;
+
+  // what the texture is bound as right now: the placeholder, low or full
+  VkImageView view = VK_NULL_HANDLE;
+  // bumped every time view changes, Mesh compares it against the version its
+  // descriptor sets were written with
+  uint32_t version = 0;
+
+  uint64_t lastUsedFrame = 0;
+  // the image couldn't be decoded, it isn't tried again
+  bool failed = false;
+
+  // the decode running on the job system, if any
+  struct Pixels
+  {
+    ImageData full;
+    ImageData low;
+  };
+  std::future<Pixels> pending;
+};
+
+// streams texture contents in the background. a streamed texture is bound as
+// a shared 1x1 placeholder right away, its image is decoded on the job system
+// and once that's done a downscaled copy and then the full mip chain are
+// uploaded and swapped in.
+//
+// views are only ever swapped by update() on the main thread, meshes pick up
+// the new one the next time the descriptor set of a frame slot is idle (see
+// Mesh::prepareFrame), so nothing in flight sees a descriptor change. images
+// that get replaced are destroyed once no frame can be using them anymore.
+//
+// the budget is a target: when the full images go over it, the ones that
+// haven't been drawn for TEXTURE_STREAMING_EVICT_FRAMES frames fall back to
+// their low copy, least recently used first. textures still in use are never
+// evicted.
+class TextureStreamer
+{
+public:
+  TextureStreamer(VulkanContext* vkContext,
+                  VkDeviceSize budget,
+                  uint32_t evictAfterFrames);
+  ~TextureStreamer();
+
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+  bool isEnabled() const { return budget > 0; }
+
+  // starts streaming a texture, the decode is queued right away
+  TextureStream* add(const std::string& filePath);
+  TextureStream* add(const unsigned char* data, size_t size);
+  // the stream's images are destroyed once the frames in flight are done
+  void remove(TextureStream* stream);
+
+  // marks the texture as drawn this frame, brings its full image back if it
+  // had been evicted
+  void touch(TextureStream* stream);
+
+  // once per frame, before the upload batch is flushed. uploads what has
+  // finished decoding (up to a per frame limit), evicts over budget and
+  // destroys the images nothing uses anymore
+  void update();
+
+  VkDeviceSize getResidentBytes() const { return residentBytes; }
+  VkDeviceSize getBudget() const { return budget; }
+
+private:
+  VulkanContext* vkContext;
+
+  VkDeviceSize budget;
+  uint32_t evictAfterFrames;
+
+  uint64_t frame = 0;
+  // size of every full image currently resident
+  VkDeviceSize residentBytes = 0;
+
+  StreamedImage placeholder;
+
+  std::vector<TextureStream*> streams;
+
+  struct Retired
+  {
+    StreamedImage image;
+    uint64_t frame;
+  };
+  std::vector<Retired> retired;
+
+  void request(TextureStream* stream, bool withLow);
+  void evict();
+
+  StreamedImage createImage(const ImageData& pixels);
+  void retire(StreamedImage& image);
+  void destroyImage(StreamedImage& image);
+  void setView(TextureStream* stream, VkImageView view);
+};
+
+#endif
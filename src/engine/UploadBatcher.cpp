@@ -0,0 +1,748 @@
+#include "engine/UploadBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// every stage an uploaded resource can be consumed from
+static const VkPipelineStageFlags CONSUMER_STAGES =
+  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+// mip chains are blitted on the graphics queue right after the acquire, so
+// it has to wait for transfers as well
+static const VkPipelineStageFlags ACQUIRE_STAGES =
+  CONSUMER_STAGES | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+UploadBatcher::UploadBatcher(VulkanContext* vkContext,
+                             uint32_t graphicsQueueFamily,
+                             uint32_t transferQueueFamily)
+  : vkContext(vkContext)
+  , graphicsQueueFamily(graphicsQueueFamily)
+  , transferQueueFamily(transferQueueFamily)
+  , dedicatedTransfer(graphicsQueueFamily != transferQueueFamily)
+{
+  vkGetDeviceQueue(
+    vkContext->logicalDevice, transferQueueFamily, 0, &transferQueue);
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = transferQueueFamily;
+
+  if (vkCreateCommandPool(vkContext->logicalDevice,
+                          &poolInfo,
+                          nullptr,
+                          &transferCommandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create transfer command pool!");
+  }
+
+  if (dedicatedTransfer) {
+    poolInfo.queueFamilyIndex = graphicsQueueFamily;
+
+    if (vkCreateCommandPool(vkContext->logicalDevice,
+                            &poolInfo,
+                            nullptr,
+                            &graphicsCommandPool) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create graphics command pool!");
+    }
+  }
+}
+
+UploadBatcher::~UploadBatcher()
+{
+  waitIdle();
+
+  vkDestroyCommandPool(vkContext->logicalDevice, transferCommandPool, nullptr);
+  if (graphicsCommandPool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(
+      vkContext->logicalDevice, graphicsCommandPool, nullptr);
+  }
+}
+
+void
+UploadBatcher::beginBatch()
+{
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = transferCommandPool;
+  allocInfo.commandBufferCount = 1;
+
+  if (vkAllocateCommandBuffers(vkContext->logicalDevice,
+                               &allocInfo,
+                               &current.transferCommandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate upload command buffer!");
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkBeginCommandBuffer(current.transferCommandBuffer, &beginInfo);
+  recording = true;
+}
+
+StagingAllocation
+UploadBatcher::allocateStaging(VkDeviceSize size)
+{
+  StagingRing* ring = vkContext->stagingRing;
+
+  // anything bigger than half the ring (a whole cubemap) would stall every
+  // other upload behind it
+  if (size <= ring->getSize() / 2) {
+    StagingAllocation staging = ring->allocate(size);
+    if (!staging.valid()) {
+      // out of room: push out what's recorded and wait for the older batches
+      // to hand their regions back
+      waitIdle();
+      staging = ring->allocate(size);
+    }
+
+    if (staging.valid()) {
+      current.ringAllocations.push_back(staging);
+      return staging;
+    }
+  }
+
+  StagingBuffer dedicated;
+  StagingAllocation staging;
+  staging.mapped = vkContext->createBuffer(size,
+                                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                           BufferType::STAGING_BUFFER,
+                                           dedicated.buffer,
+                                           dedicated.allocation);
+  staging.buffer = dedicated.buffer;
+  staging.offset = 0;
+  staging.size = size;
+  current.dedicatedBuffers.push_back(dedicated);
+  return staging;
+}
+
+// -------------------- BUFFERS --------------------
+void
+UploadBatcher::uploadBuffer(VkBuffer dstBuffer,
+                            const void* data,
+                            VkDeviceSize size,
+                            VkDeviceSize dstOffset)
+{
+  if (size == 0) {
+    return;
+  }
+
+  // allocating can flush the current batch, so it goes first
+  StagingAllocation staging = allocateStaging(size);
+  memcpy(staging.mapped, data, static_cast<size_t>(size));
+
+  if (!recording) {
+    beginBatch();
+  }
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = staging.offset;
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(
+    current.transferCommandBuffer, staging.buffer, dstBuffer, 1, &copyRegion);
+
+  VkBufferMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+    VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+  barrier.srcQueueFamilyIndex =
+    dedicatedTransfer ? transferQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex =
+    dedicatedTransfer ? graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = dstBuffer;
+  barrier.offset = dstOffset;
+  barrier.size = size;
+  current.bufferBarriers.push_back(barrier);
+}
+
+// -------------------- IMAGES --------------------
+void*
+UploadBatcher::stageImage(VkImage image,
+                          uint32_t width,
+                          uint32_t height,
+                          uint32_t layerCount,
+                          VkDeviceSize layerSize,
+                          uint32_t mipLevels,
+                          VkFormat format)
+{
+  bool blit = mipLevels > 1 && supportsBlit(format);
+  bool cpu = mipLevels > 1 && !blit;
+
+  // the cpu fallback needs room for the whole chain, each level is a quarter
+  // of the previous one
+  std::vector<ImageLevel> levels;
+  VkDeviceSize size = 0;
+  for (uint32_t i = 0; i < (cpu ? mipLevels : 1); i++) {
+    ImageLevel level;
+    level.width = std::max(width >> i, 1u);
+    level.height = std::max(height >> i, 1u);
+    level.offset = size;
+    level.layerSize =
+      i == 0 ? layerSize
+             : static_cast<VkDeviceSize>(level.width) * level.height * 4;
+    levels.push_back(level);
+
+    size += level.layerSize * layerCount;
+  }
+
+  StagingAllocation staging = allocateStaging(size);
+
+  if (!recording) {
+    beginBatch();
+  }
+
+  recordImageCopy(image, layerCount, mipLevels, levels, staging);
+
+  MipJob job;
+  job.image = image;
+  job.width = width;
+  job.height = height;
+  job.layerCount = layerCount;
+  job.mipLevels = mipLevels;
+  job.mapped = static_cast<char*>(staging.mapped);
+  job.layerSize = layerSize;
+
+  if (cpu) {
+    current.cpuJobs.push_back(job);
+  }
+
+  if (!blit) {
+    pushReadBarrier(image, layerCount, mipLevels);
+  } else {
+    current.blitJobs.push_back(job);
+
+    // blits need a graphics queue, so with a dedicated transfer queue only the
+    // ownership moves over here and the layout stays TRANSFER_DST
+    if (dedicatedTransfer) {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask =
+        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.srcQueueFamilyIndex = transferQueueFamily;
+      barrier.dstQueueFamilyIndex = graphicsQueueFamily;
+      barrier.image = image;
+      barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      barrier.subresourceRange.baseMipLevel = 0;
+      barrier.subresourceRange.levelCount = mipLevels;
+      barrier.subresourceRange.baseArrayLayer = 0;
+      barrier.subresourceRange.layerCount = layerCount;
+      current.imageBarriers.push_back(barrier);
+    }
+  }
+
+  return staging.mapped;
+}
+
+void*
+UploadBatcher::stageImageLevels(VkImage image,
+                                uint32_t layerCount,
+                                const std::vector<ImageLevel>& levels,
+                                VkDeviceSize size)
+{
+  StagingAllocation staging = allocateStaging(size);
+
+  if (!recording) {
+    beginBatch();
+  }
+
+  uint32_t mipLevels = static_cast<uint32_t>(levels.size());
+  recordImageCopy(image, layerCount, mipLevels, levels, staging);
+  pushReadBarrier(image, layerCount, mipLevels);
+
+  return staging.mapped;
+}
+
+void
+UploadBatcher::uploadImage(VkImage image,
+                           const void* data,
+                           uint32_t width,
+                           uint32_t height,
+                           uint32_t layerCount,
+                           uint32_t mipLevels)
+{
+  VkDeviceSize layerSize = static_cast<VkDeviceSize>(width) * height * 4;
+  void* mapped =
+    stageImage(image, width, height, layerCount, layerSize, mipLevels);
+  memcpy(mapped, data, static_cast<size_t>(layerSize * layerCount));
+}
+
+bool
+UploadBatcher::supportsBlit(VkFormat format) const
+{
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(
+    vkContext->physicalDevice, format, &properties);
+
+  VkFormatFeatureFlags required =
+    VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  return (properties.optimalTilingFeatures & required) == required;
+}
+
+void
+UploadBatcher::recordImageCopy(VkImage image,
+                               uint32_t layerCount,
+                               uint32_t mipLevels,
+                               const std::vector<ImageLevel>& levels,
+                               const StagingAllocation& staging)
+{
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = mipLevels;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = layerCount;
+
+  vkCmdPipelineBarrier(current.transferCommandBuffer,
+                       VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+
+  std::vector<VkBufferImageCopy> regions;
+  regions.reserve(levels.size() * layerCount);
+  for (uint32_t mip = 0; mip < levels.size(); mip++) {
+    const ImageLevel& level = levels[mip];
+    for (uint32_t i = 0; i < layerCount; i++) {
+      VkBufferImageCopy region{};
+      region.bufferOffset = staging.offset + level.offset + level.layerSize * i;
+      region.bufferRowLength = 0;
+      region.bufferImageHeight = 0;
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.mipLevel = mip;
+      region.imageSubresource.baseArrayLayer = i;
+      region.imageSubresource.layerCount = 1;
+      region.imageOffset = { 0, 0, 0 };
+      region.imageExtent = { level.width, level.height, 1 };
+      regions.push_back(region);
+    }
+  }
+
+  vkCmdCopyBufferToImage(current.transferCommandBuffer,
+                         staging.buffer,
+                         image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
+}
+
+void
+UploadBatcher::pushReadBarrier(VkImage image,
+                               uint32_t layerCount,
+                               uint32_t mipLevels)
+{
+  // the transition to SHADER_READ_ONLY happens when the batch is flushed,
+  // together with the queue ownership transfer if there is one
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.srcQueueFamilyIndex =
+    dedicatedTransfer ? transferQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex =
+    dedicatedTransfer ? graphicsQueueFamily : VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = mipLevels;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = layerCount;
+  current.imageBarriers.push_back(barrier);
+}
+
+void
+UploadBatcher::recordMipChain(VkCommandBuffer commandBuffer,
+                              const MipJob& job,
+                              std::vector<VkImageMemoryBarrier>& readBarriers)
+{
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = job.image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = job.layerCount;
+
+  int32_t mipWidth = static_cast<int32_t>(job.width);
+  int32_t mipHeight = static_cast<int32_t>(job.height);
+
+  // every level is blitted from the one before it, which has to be done being
+  // written first
+  for (uint32_t i = 1; i < job.mipLevels; i++) {
+    barrier.subresourceRange.baseMipLevel = i - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr,
+                         1,
+                         &barrier);
+
+    int32_t nextWidth = std::max(mipWidth / 2, 1);
+    int32_t nextHeight = std::max(mipHeight / 2, 1);
+
+    VkImageBlit blit{};
+    blit.srcOffsets[0] = { 0, 0, 0 };
+    blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.mipLevel = i - 1;
+    blit.srcSubresource.baseArrayLayer = 0;
+    blit.srcSubresource.layerCount = job.layerCount;
+    blit.dstOffsets[0] = { 0, 0, 0 };
+    blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+    blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.dstSubresource.mipLevel = i;
+    blit.dstSubresource.baseArrayLayer = 0;
+    blit.dstSubresource.layerCount = job.layerCount;
+
+    vkCmdBlitImage(commandBuffer,
+                   job.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   job.image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1,
+                   &blit,
+                   VK_FILTER_LINEAR);
+
+    mipWidth = nextWidth;
+    mipHeight = nextHeight;
+  }
+
+  // all levels but the last one have been read from
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = job.mipLevels - 1;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  readBarriers.push_back(barrier);
+
+  barrier.subresourceRange.baseMipLevel = job.mipLevels - 1;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  readBarriers.push_back(barrier);
+}
+
+void
+UploadBatcher::generateMips(const MipJob& job)
+{
+  // 2x2 box filter, same layout stageImage() reserved: every level's layers
+  // one after the other, levels one after the other. the values are averaged
+  // as they are (no srgb decoding), good enough for a fallback
+  const char* src = job.mapped;
+  VkDeviceSize srcLayerSize = job.layerSize;
+  uint32_t srcWidth = job.width;
+  uint32_t srcHeight = job.height;
+
+  for (uint32_t mip = 1; mip < job.mipLevels; mip++) {
+    uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+    uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+    VkDeviceSize dstLayerSize =
+      static_cast<VkDeviceSize>(dstWidth) * dstHeight * 4;
+    char* dst = const_cast<char*>(src) + srcLayerSize * job.layerCount;
+
+    for (uint32_t layer = 0; layer < job.layerCount; layer++) {
+      const uint8_t* in =
+        reinterpret_cast<const uint8_t*>(src + srcLayerSize * layer);
+      uint8_t* out = reinterpret_cast<uint8_t*>(dst + dstLayerSize * layer);
+
+      for (uint32_t y = 0; y < dstHeight; y++) {
+        uint32_t y0 = std::min(y * 2, srcHeight - 1);
+        uint32_t y1 = std::min(y * 2 + 1, srcHeight - 1);
+        for (uint32_t x = 0; x < dstWidth; x++) {
+          uint32_t x0 = std::min(x * 2, srcWidth - 1);
+          uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1);
+          for (uint32_t c = 0; c < 4; c++) {
+            uint32_t sum = in[(y0 * srcWidth + x0) * 4 + c] +
+                           in[(y0 * srcWidth + x1) * 4 + c] +
+                           in[(y1 * srcWidth + x0) * 4 + c] +
+                           in[(y1 * srcWidth + x1) * 4 + c];
+            out[(y * dstWidth + x) * 4 + c] = static_cast<uint8_t>(sum / 4);
+          }
+        }
+      }
+    }
+
+    src = dst;
+    srcLayerSize = dstLayerSize;
+    srcWidth = dstWidth;
+    srcHeight = dstHeight;
+  }
+}
+
+// -------------------- SUBMISSION --------------------
+void
+UploadBatcher::flush()
+{
+  if (!recording) {
+    return;
+  }
+
+  Batch& batch = current;
+
+  for (const auto& job : batch.cpuJobs) {
+    generateMips(job);
+  }
+
+  // staging memory isn't guaranteed to be host coherent
+  for (const auto& staging : batch.ringAllocations) {
+    vkContext->stagingRing->flush(staging);
+  }
+  for (const auto& staging : batch.dedicatedBuffers) {
+    vmaFlushAllocation(
+      vkContext->allocator, staging.allocation, 0, VK_WHOLE_SIZE);
+  }
+  batch.ringRegion = vkContext->stagingRing->closeRegion();
+
+  if (!dedicatedTransfer) {
+    // same queue, the mips can be blitted right after the copies
+    for (const auto& job : batch.blitJobs) {
+      recordMipChain(batch.transferCommandBuffer, job, batch.imageBarriers);
+    }
+
+    vkCmdPipelineBarrier(
+      batch.transferCommandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      CONSUMER_STAGES,
+      0,
+      0,
+      nullptr,
+      static_cast<uint32_t>(batch.bufferBarriers.size()),
+      batch.bufferBarriers.data(),
+      static_cast<uint32_t>(batch.imageBarriers.size()),
+      batch.imageBarriers.data());
+  } else {
+    // release: the dst access mask is ignored on this side
+    std::vector<VkBufferMemoryBarrier> bufferReleases = batch.bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageReleases = batch.imageBarriers;
+    for (auto& barrier : bufferReleases) {
+      barrier.dstAccessMask = 0;
+    }
+    for (auto& barrier : imageReleases) {
+      barrier.dstAccessMask = 0;
+    }
+
+    vkCmdPipelineBarrier(batch.transferCommandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0,
+                         0,
+                         nullptr,
+                         static_cast<uint32_t>(bufferReleases.size()),
+                         bufferReleases.data(),
+                         static_cast<uint32_t>(imageReleases.size()),
+                         imageReleases.data());
+  }
+
+  vkEndCommandBuffer(batch.transferCommandBuffer);
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(
+        vkContext->logicalDevice, &fenceInfo, nullptr, &batch.fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create upload fence!");
+  }
+
+  if (!dedicatedTransfer) {
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+
+    if (vkQueueSubmit(transferQueue, 1, &submitInfo, batch.fence) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to submit upload batch!");
+    }
+  } else {
+    // -------------------- ACQUIRE --------------------
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = graphicsCommandPool;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(vkContext->logicalDevice,
+                                 &allocInfo,
+                                 &batch.graphicsCommandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(batch.graphicsCommandBuffer, &beginInfo);
+
+    // acquire: the src access mask is ignored on this side
+    for (auto& barrier : batch.bufferBarriers) {
+      barrier.srcAccessMask = 0;
+    }
+    for (auto& barrier : batch.imageBarriers) {
+      barrier.srcAccessMask = 0;
+    }
+
+    vkCmdPipelineBarrier(
+      batch.graphicsCommandBuffer,
+      ACQUIRE_STAGES,
+      ACQUIRE_STAGES,
+      0,
+      0,
+      nullptr,
+      static_cast<uint32_t>(batch.bufferBarriers.size()),
+      batch.bufferBarriers.data(),
+      static_cast<uint32_t>(batch.imageBarriers.size()),
+      batch.imageBarriers.data());
+
+    std::vector<VkImageMemoryBarrier> mipBarriers;
+    for (const auto& job : batch.blitJobs) {
+      recordMipChain(batch.graphicsCommandBuffer, job, mipBarriers);
+    }
+    if (!mipBarriers.empty()) {
+      vkCmdPipelineBarrier(batch.graphicsCommandBuffer,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           CONSUMER_STAGES,
+                           0,
+                           0,
+                           nullptr,
+                           0,
+                           nullptr,
+                           static_cast<uint32_t>(mipBarriers.size()),
+                           mipBarriers.data());
+    }
+
+    vkEndCommandBuffer(batch.graphicsCommandBuffer);
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (vkCreateSemaphore(vkContext->logicalDevice,
+                          &semaphoreInfo,
+                          nullptr,
+                          &batch.transferDone) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create upload semaphore!");
+    }
+
+    VkSubmitInfo transferSubmit{};
+    transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    transferSubmit.commandBufferCount = 1;
+    transferSubmit.pCommandBuffers = &batch.transferCommandBuffer;
+    transferSubmit.signalSemaphoreCount = 1;
+    transferSubmit.pSignalSemaphores = &batch.transferDone;
+
+    if (vkQueueSubmit(transferQueue, 1, &transferSubmit, VK_NULL_HANDLE) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to submit upload batch!");
+    }
+
+    VkPipelineStageFlags waitStage = ACQUIRE_STAGES;
+
+    VkSubmitInfo graphicsSubmit{};
+    graphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    graphicsSubmit.waitSemaphoreCount = 1;
+    graphicsSubmit.pWaitSemaphores = &batch.transferDone;
+    graphicsSubmit.pWaitDstStageMask = &waitStage;
+    graphicsSubmit.commandBufferCount = 1;
+    graphicsSubmit.pCommandBuffers = &batch.graphicsCommandBuffer;
+
+    if (vkQueueSubmit(
+          vkContext->graphicsQueue, 1, &graphicsSubmit, batch.fence) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to submit upload acquire!");
+    }
+  }
+
+  batch.bufferBarriers.clear();
+  batch.imageBarriers.clear();
+  batch.blitJobs.clear();
+  batch.cpuJobs.clear();
+
+  inFlight.push_back(std::move(batch));
+  current = Batch();
+  recording = false;
+}
+
+void
+UploadBatcher::collect()
+{
+  for (auto it = inFlight.begin(); it != inFlight.end();) {
+    if (vkGetFenceStatus(vkContext->logicalDevice, it->fence) == VK_SUCCESS) {
+      destroyBatch(*it);
+      it = inFlight.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void
+UploadBatcher::waitIdle()
+{
+  flush();
+
+  for (auto& batch : inFlight) {
+    vkWaitForFences(
+      vkContext->logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+  }
+
+  collect();
+}
+
+void
+UploadBatcher::destroyBatch(Batch& batch)
+{
+  vkContext->stagingRing->release(batch.ringRegion);
+  for (const auto& staging : batch.dedicatedBuffers) {
+    vmaDestroyBuffer(vkContext->allocator, staging.buffer, staging.allocation);
+  }
+  batch.dedicatedBuffers.clear();
+
+  vkFreeCommandBuffers(vkContext->logicalDevice,
+                       transferCommandPool,
+                       1,
+                       &batch.transferCommandBuffer);
+  if (batch.graphicsCommandBuffer != VK_NULL_HANDLE) {
+    vkFreeCommandBuffers(vkContext->logicalDevice,
+                         graphicsCommandPool,
+                         1,
+                         &batch.graphicsCommandBuffer);
+  }
+
+  if (batch.transferDone != VK_NULL_HANDLE) {
+    vkDestroySemaphore(vkContext->logicalDevice, batch.transferDone, nullptr);
+  }
+  vkDestroyFence(vkContext->logicalDevice, batch.fence, nullptr);
+}
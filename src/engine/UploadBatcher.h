@@ -0,0 +1,171 @@
+#ifndef _UPLOAD_BATCHER_H_
+#define _UPLOAD_BATCHER_H_
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan_core.h>
+
+#include <vector>
+
+#include "engine/StagingRing.h"
+#include "engine/VulkanContext.h"
+
+// one mip level of an image staged with stageImageLevels(). its layers are
+// tightly packed one after the other starting at offset
+struct ImageLevel
+{
+  uint32_t width;
+  uint32_t height;
+  VkDeviceSize offset;
+  VkDeviceSize layerSize;
+};
+
+// records every staging copy and layout transition into a single command
+// buffer instead of submitting and waiting on each one. flush() submits the
+// batch without blocking, the staging memory (a region of the StagingRing) is
+// released by collect() once the batch's fence has signaled.
+//
+// when the device has a dedicated transfer queue family the copies run there
+// and ownership is handed over to the graphics queue, which waits on a
+// semaphore, so anything submitted to the graphics queue afterwards already
+// sees the data.
+class UploadBatcher
+{
+public:
+  UploadBatcher(VulkanContext* vkContext,
+                uint32_t graphicsQueueFamily,
+                uint32_t transferQueueFamily);
+  ~UploadBatcher();
+
+  UploadBatcher(const UploadBatcher&) = delete;
+  UploadBatcher& operator=(const UploadBatcher&) = delete;
+
+  // -------------------- BUFFERS --------------------
+  // data is copied into staging memory right away, it can be freed as soon as
+  // this returns
+  void uploadBuffer(VkBuffer dstBuffer,
+                    const void* data,
+                    VkDeviceSize size,
+                    VkDeviceSize dstOffset = 0);
+
+  // -------------------- IMAGES --------------------
+  // returns staging memory for layerCount tightly packed RGBA8 layers of mip
+  // level 0, fill it before the next flush(). the other mipLevels - 1 levels
+  // are generated from it, with a blit chain on the graphics queue or, if the
+  // format can't be blitted with linear filtering, a box filter on the cpu.
+  // the image (created with TRANSFER_SRC usage if it has more than one level)
+  // ends up in SHADER_READ_ONLY_OPTIMAL.
+  void* stageImage(VkImage image,
+                   uint32_t width,
+                   uint32_t height,
+                   uint32_t layerCount,
+                   VkDeviceSize layerSize,
+                   uint32_t mipLevels = 1,
+                   VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
+  void uploadImage(VkImage image,
+                   const void* data,
+                   uint32_t width,
+                   uint32_t height,
+                   uint32_t layerCount = 1,
+                   uint32_t mipLevels = 1);
+
+  // same as stageImage() but every level is provided by the caller (mips that
+  // were precomputed offline), nothing gets generated. returns size bytes of
+  // staging memory, the levels' offsets are relative to it
+  void* stageImageLevels(VkImage image,
+                         uint32_t layerCount,
+                         const std::vector<ImageLevel>& levels,
+                         VkDeviceSize size);
+
+  // -------------------- SUBMISSION --------------------
+  // submits whatever has been recorded so far, doesn't wait for it
+  void flush();
+  // releases the staging memory of the batches the gpu is done with
+  void collect();
+  // flushes and blocks until every batch has completed
+  void waitIdle();
+
+  bool usesTransferQueue() const { return dedicatedTransfer; }
+
+private:
+  VulkanContext* vkContext;
+
+  uint32_t graphicsQueueFamily;
+  uint32_t transferQueueFamily;
+  bool dedicatedTransfer;
+
+  VkQueue transferQueue = VK_NULL_HANDLE;
+  VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+  VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+
+  struct StagingBuffer
+  {
+    VkBuffer buffer;
+    VmaAllocation allocation;
+  };
+
+  // an image whose mip levels past the first still have to be filled in
+  struct MipJob
+  {
+    VkImage image;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layerCount;
+    uint32_t mipLevels;
+    // cpu fallback only, the whole chain in staging memory
+    char* mapped;
+    VkDeviceSize layerSize;
+  };
+
+  struct Batch
+  {
+    VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+    // only used with a dedicated transfer queue, acquires the resources on
+    // the graphics queue
+    VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+    VkSemaphore transferDone = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+
+    std::vector<StagingAllocation> ringAllocations;
+    uint64_t ringRegion = 0;
+    // uploads too big for the ring get a buffer of their own
+    std::vector<StagingBuffer> dedicatedBuffers;
+
+    // blitted on the graphics queue when the batch is flushed
+    std::vector<MipJob> blitJobs;
+    // box filtered into staging memory right before the batch is submitted
+    std::vector<MipJob> cpuJobs;
+
+    // release (transfer queue) and acquire (graphics queue) barriers, emitted
+    // all at once when the batch is flushed
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+  };
+
+  Batch current;
+  bool recording = false;
+  std::vector<Batch> inFlight;
+
+  void beginBatch();
+  StagingAllocation allocateStaging(VkDeviceSize size);
+  void destroyBatch(Batch& batch);
+
+  bool supportsBlit(VkFormat format) const;
+  // transitions every level to TRANSFER_DST and copies the given ones
+  void recordImageCopy(VkImage image,
+                       uint32_t layerCount,
+                       uint32_t mipLevels,
+                       const std::vector<ImageLevel>& levels,
+                       const StagingAllocation& staging);
+  // the final transition to SHADER_READ_ONLY of levels still in TRANSFER_DST
+  void pushReadBarrier(VkImage image,
+                       uint32_t layerCount,
+                       uint32_t mipLevels);
+  // leaves the whole chain in SHADER_READ_ONLY, the barriers doing that are
+  // appended to readBarriers
+  static void recordMipChain(VkCommandBuffer commandBuffer,
+                             const MipJob& job,
+                             std::vector<VkImageMemoryBarrier>& readBarriers);
+  static void generateMips(const MipJob& job);
+};
+
+#endif
@@ -65,6 +65,53 @@ struct Vertex
   }
 };
 
+// what the instanced pipelines read per instance, from a second vertex buffer
+// at binding 1. the model matrix takes locations 3 to 6, one column each,
+// color is only read by the light cubes
+struct InstanceData
+{
+  glm::mat4 model;
+  glm::vec4 color;
+  // slot of the textures in BindlessTextures, unused without it
+  uint32_t material = 0;
+
+  static VkVertexInputBindingDescription getBindingDescription()
+  {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 1;
+    bindingDescription.stride = sizeof(InstanceData);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    return bindingDescription;
+  }
+
+  static std::array<VkVertexInputAttributeDescription, 6>
+  getAttributeDescriptions()
+  {
+    std::array<VkVertexInputAttributeDescription, 6> attributeDescriptions{};
+
+    for (uint32_t column = 0; column < 4; column++) {
+      attributeDescriptions[column].binding = 1;
+      attributeDescriptions[column].location = 3 + column;
+      attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+      attributeDescriptions[column].offset =
+        offsetof(InstanceData, model) + sizeof(glm::vec4) * column;
+    }
+
+    attributeDescriptions[4].binding = 1;
+    attributeDescriptions[4].location = 7;
+    attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[4].offset = offsetof(InstanceData, color);
+
+    attributeDescriptions[5].binding = 1;
+    attributeDescriptions[5].location = 8;
+    attributeDescriptions[5].format = VK_FORMAT_R32_UINT;
+    attributeDescriptions[5].offset = offsetof(InstanceData, material);
+
+    return attributeDescriptions;
+  }
+};
+
 const std::vector<Vertex> cube_vertices = {
   { { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 0.0f } },
   { { 0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, -1.0f }, { 1.0f, 0.0f } },
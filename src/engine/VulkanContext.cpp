@@ -1,5 +1,6 @@
 #include "VulkanContext.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 VkImage
@@ -10,7 +11,8 @@ VulkanContext::createImage(uint32_t width,
                            VkImageTiling tiling,
                            VkImageUsageFlags usage,
                            VmaAllocationCreateFlagBits flags,
-                           VmaAllocation& allocation)
+                           VmaAllocation& allocation,
+                           uint32_t mipLevels)
 {
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -18,7 +20,7 @@ VulkanContext::createImage(uint32_t width,
   imageInfo.extent.width = width;
   imageInfo.extent.height = height;
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
+  imageInfo.mipLevels = mipLevels;
   imageInfo.arrayLayers = layerCount;
   imageInfo.format = format;
   imageInfo.tiling = tiling;
@@ -66,7 +68,8 @@ VkImageView
 VulkanContext::createImageView(VkImage image,
                                VkFormat format,
                                uint32_t layerCount,
-                               VkImageAspectFlags aspectFlags)
+                               VkImageAspectFlags aspectFlags,
+                               uint32_t mipLevels)
 {
   VkImageViewCreateInfo viewInfo{};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -75,7 +78,7 @@ VulkanContext::createImageView(VkImage image,
   viewInfo.format = format;
   viewInfo.subresourceRange.aspectMask = aspectFlags;
   viewInfo.subresourceRange.baseMipLevel = 0;
-  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = layerCount;
 
@@ -88,41 +91,16 @@ VulkanContext::createImageView(VkImage image,
   return imageView;
 }
 
-void
-VulkanContext::copyBuffer(VkBuffer srcBuffer,
-                          VkBuffer dstBuffer,
-                          VkDeviceSize size)
+uint32_t
+VulkanContext::getMipLevels(uint32_t width, uint32_t height)
 {
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = commandPool;
-  allocInfo.commandBufferCount = 1;
-
-  VkCommandBuffer commandBuffer;
-  vkAllocateCommandBuffers(logicalDevice, &allocInfo, &commandBuffer);
-
-  VkCommandBufferBeginInfo beginInfo{};
-  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-  vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-  VkBufferCopy copyRegion{};
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-  vkEndCommandBuffer(commandBuffer);
-
-  VkSubmitInfo submitInfo{};
-  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffer;
-
-  vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(graphicsQueue);
-
-  vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+  uint32_t levels = 1;
+  uint32_t size = std::max(width, height);
+  while (size > 1) {
+    size /= 2;
+    levels++;
+  }
+  return levels;
 }
 
 void*
@@ -151,6 +129,10 @@ VulkanContext::createBuffer(VkDeviceSize size,
       allocCreateInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
       allocCreateInfo.priority = 1.0f;
       break;
+    case BufferType::READBACK_BUFFER:
+      allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                              VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      break;
   }
 
   VmaAllocationInfo allocInfo;
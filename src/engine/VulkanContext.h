@@ -8,7 +8,40 @@
 
 #include "engine/Buffers.h"
 
+// how many frames the cpu is allowed to record ahead of the gpu. it's set from
+// cmake, the fallback is here so the header works on its own
+#ifndef FRAMES_IN_FLIGHT
+#define FRAMES_IN_FLIGHT 2
+#endif
+const uint32_t MAX_FRAMES_IN_FLIGHT = FRAMES_IN_FLIGHT;
+
+// culls on the gpu and draws with vkCmdDrawIndexedIndirectCount where the
+// device allows it. set from cmake, off unless asked for
+#ifndef GPU_DRIVEN_RENDERING
+#define GPU_DRIVEN_RENDERING 0
+#endif
+
+// reads the material textures out of one descriptor array indexed per
+// instance where the device has VK_EXT_descriptor_indexing. set from cmake,
+// on unless turned off
+#ifndef BINDLESS_TEXTURES
+#define BINDLESS_TEXTURES 1
+#endif
+
 class VulkanInitializer;
+class Profiler;
+class UploadBatcher;
+class StagingRing;
+class GeometryArena;
+class TextureCache;
+class SamplerCache;
+class JobSystem;
+class TextureStreamer;
+class PipelineCache;
+class ShaderLibrary;
+class PipelineRegistry;
+class BindlessTextures;
+class FrameArena;
 
 class VulkanContext
 {
@@ -20,6 +53,9 @@ public:
   VkInstance instance;
 
   VkPhysicalDevice physicalDevice;
+  // queried once when the physical device is picked, use this instead of
+  // calling vkGetPhysicalDeviceProperties again
+  VkPhysicalDeviceProperties deviceProperties{};
   VkDevice logicalDevice;
 
   VmaAllocator allocator;
@@ -29,6 +65,59 @@ public:
 
   VkCommandPool commandPool;
 
+  // vkCmdDrawIndexedIndirectCountKHR, only set when GPU_DRIVEN_RENDERING is
+  // on and the device has VK_KHR_draw_indirect_count, multiDrawIndirect and
+  // drawIndirectFirstInstance. the passes draw instance by instance without
+  // it
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+
+  // gpu timestamps and cpu scopes, owned by VulkanInitializer
+  Profiler* profiler = nullptr;
+
+  // staging copies for resources created at load time, owned by
+  // VulkanInitializer
+  UploadBatcher* uploadBatcher = nullptr;
+
+  // persistently mapped memory for staging and per-frame data, owned by
+  // VulkanInitializer
+  StagingRing* stagingRing = nullptr;
+
+  // shared vertex and index buffers every model lives in, owned by
+  // VulkanInitializer
+  GeometryArena* geometryArena = nullptr;
+
+  // shares textures between meshes and models, owned by VulkanInitializer
+  TextureCache* textureCache = nullptr;
+
+  // deduplicated samplers, owned by VulkanInitializer
+  SamplerCache* samplerCache = nullptr;
+
+  // background texture uploads and residency, owned by VulkanInitializer
+  TextureStreamer* textureStreamer = nullptr;
+
+  // worker threads for asset loading, owned by VulkanInitializer
+  JobSystem* jobSystem = nullptr;
+
+  // pass pipelineCache->get() to every vkCreate*Pipelines, owned by
+  // VulkanInitializer and saved to disk when it's destroyed
+  PipelineCache* pipelineCache = nullptr;
+
+  // shader modules loaded once and shared, owned by VulkanInitializer
+  ShaderLibrary* shaderLibrary = nullptr;
+
+  // the passes ask this for their pipelines instead of creating them, owned
+  // by VulkanInitializer
+  PipelineRegistry* pipelineRegistry = nullptr;
+
+  // the material textures as one array, owned by VulkanInitializer. only set
+  // when BINDLESS_TEXTURES is on and the device has VK_EXT_descriptor_indexing,
+  // the meshes bind their own sets without it
+  BindlessTextures* bindlessTextures = nullptr;
+
+  // scratch memory that only lives for a frame, like the draw lists. owned by
+  // VulkanInitializer and reset by the Renderer every frame
+  FrameArena* frameArena = nullptr;
+
   // create vulkan primitives
   VkImage createImage(uint32_t width,
                       uint32_t height,
@@ -37,14 +126,19 @@ public:
                       VkImageTiling tiling,
                       VkImageUsageFlags usage,
                       VmaAllocationCreateFlagBits flags,
-                      VmaAllocation& allocation);
+                      VmaAllocation& allocation,
+                      uint32_t mipLevels = 1);
 
   VkShaderModule createShaderModule(const std::vector<char>& code);
 
   VkImageView createImageView(VkImage image,
                               VkFormat format,
                               uint32_t layerCount,
-                              VkImageAspectFlags aspectFlags);
+                              VkImageAspectFlags aspectFlags,
+                              uint32_t mipLevels = 1);
+
+  // length of the full mip chain, down to 1x1
+  static uint32_t getMipLevels(uint32_t width, uint32_t height);
 
   void* createBuffer(VkDeviceSize size,
                      VkBufferUsageFlags usage,
@@ -55,9 +149,6 @@ public:
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
-  // void copyBuffer
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-
   // destroy vulkan primitives
   void destroyImageView(VkImageView view);
 
@@ -1,4 +1,17 @@
 #include "VulkanInitializer.h"
+#include "engine/BindlessTextures.h"
+#include "engine/FrameArena.h"
+#include "engine/GeometryArena.h"
+#include "engine/JobSystem.h"
+#include "engine/ModelLoading/TextureCache.h"
+#include "engine/PipelineCache.h"
+#include "engine/PipelineRegistry.h"
+#include "engine/Profiler.h"
+#include "engine/SamplerCache.h"
+#include "engine/ShaderLibrary.h"
+#include "engine/StagingRing.h"
+#include "engine/TextureStreamer.h"
+#include "engine/UploadBatcher.h"
 #include "engine/VulkanQueueFamiliesHelper.h"
 #include "engine/VulkanSwapchain.h"
 
@@ -13,8 +26,24 @@ VulkanInitializer::VulkanInitializer(GLFWwindow* window)
   vkContext = new VulkanContext();
   vkSwapchain = new VulkanSwapchain(vkContext, window);
 
+  init();
+}
+
+VulkanInitializer::VulkanInitializer(int width, int height)
+{
+  vkContext = new VulkanContext();
+  vkSwapchain = new VulkanSwapchain(vkContext, width, height);
+
+  init();
+}
+
+void
+VulkanInitializer::init()
+{
   createInstance();
-  vkSwapchain->createSurface();
+  if (!vkSwapchain->isHeadless()) {
+    vkSwapchain->createSurface();
+  }
 
   setupDebugMessenger();
 
@@ -25,6 +54,30 @@ VulkanInitializer::VulkanInitializer(GLFWwindow* window)
 
   createVMAAllocator();
 
+  QueueFamilyIndices indices = QueueFamilyIndices::findQueueFamilies(
+    vkContext->physicalDevice, vkSwapchain->surface);
+  vkContext->jobSystem = new JobSystem();
+  vkContext->frameArena = new FrameArena(FRAME_ARENA_SIZE);
+  vkContext->profiler =
+    new Profiler(vkContext, indices.graphicsFamily.value());
+  vkContext->pipelineCache = new PipelineCache(vkContext, PIPELINE_CACHE_PATH);
+  vkContext->shaderLibrary = new ShaderLibrary(vkContext, SHADER_PATH);
+  vkContext->pipelineRegistry = new PipelineRegistry(vkContext);
+  vkContext->stagingRing = new StagingRing(vkContext, STAGING_RING_SIZE);
+  vkContext->uploadBatcher = new UploadBatcher(
+    vkContext,
+    indices.graphicsFamily.value(),
+    indices.transferFamily.value_or(indices.graphicsFamily.value()));
+  vkContext->geometryArena = new GeometryArena(
+    vkContext, GEOMETRY_ARENA_VERTICES, GEOMETRY_ARENA_INDICES);
+  vkContext->samplerCache = new SamplerCache(vkContext);
+  vkContext->textureStreamer = new TextureStreamer(
+    vkContext, TEXTURE_STREAMING_BUDGET, TEXTURE_STREAMING_EVICT_FRAMES);
+  vkContext->textureCache = new TextureCache(vkContext);
+  if (bindless) {
+    vkContext->bindlessTextures = new BindlessTextures(vkContext);
+  }
+
   vkSwapchain->createSwapChain();
   vkSwapchain->createSyncObjects();
   vkSwapchain->createCommandBuffer();
@@ -33,6 +86,19 @@ VulkanInitializer::VulkanInitializer(GLFWwindow* window)
 VulkanInitializer::~VulkanInitializer()
 {
   delete vkSwapchain;
+  delete vkContext->bindlessTextures;
+  delete vkContext->textureCache;
+  delete vkContext->textureStreamer;
+  delete vkContext->samplerCache;
+  delete vkContext->geometryArena;
+  delete vkContext->uploadBatcher;
+  delete vkContext->stagingRing;
+  delete vkContext->pipelineRegistry;
+  delete vkContext->shaderLibrary;
+  delete vkContext->pipelineCache;
+  delete vkContext->profiler;
+  delete vkContext->frameArena;
+  delete vkContext->jobSystem;
 
   vmaDestroyAllocator(vkContext->allocator);
 
@@ -80,6 +146,16 @@ VulkanInitializer::createInstance()
     VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
   createInfo.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+  physicalDeviceProperties2 = true;
+#else
+  // lets supportsBindless() ask for the descriptor indexing features
+  if (BINDLESS_TEXTURES &&
+      hasInstanceExtension(
+        VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+    extensions.emplace_back(
+      VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    physicalDeviceProperties2 = true;
+  }
 #endif
 
   createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
@@ -123,12 +199,16 @@ VulkanInitializer::populateDebugMessengerCreateInfo(
 std::vector<const char*>
 VulkanInitializer::getRequiredExtensions()
 {
-  uint32_t glfwExtensionCount = 0;
-  const char** glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+  std::vector<const char*> extensions;
 
-  std::vector<const char*> extensions(glfwExtensions,
-                                      glfwExtensions + glfwExtensionCount);
+  // no surface extensions needed when there's no window to present to
+  if (!vkSwapchain->isHeadless()) {
+    uint32_t glfwExtensionCount = 0;
+    const char** glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -221,6 +301,7 @@ VulkanInitializer::selectPhysicalDevice()
   }
 
   vkGetPhysicalDeviceProperties(vkContext->physicalDevice, &deviceProperties);
+  vkContext->deviceProperties = deviceProperties;
   vkGetPhysicalDeviceFeatures(vkContext->physicalDevice, &deviceFeatures);
   vkGetPhysicalDeviceMemoryProperties(vkContext->physicalDevice,
                                       &deviceMemoryProperties);
@@ -234,8 +315,8 @@ VulkanInitializer::isDeviceSuitable(VkPhysicalDevice device)
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  bool swapChainAdequate = vkSwapchain->isHeadless();
+  if (extensionsSupported && !vkSwapchain->isHeadless()) {
     SwapChainSupportDetails swapChainSupport =
       vkSwapchain->querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() &&
@@ -270,6 +351,103 @@ VulkanInitializer::checkDeviceExtensionSupport(VkPhysicalDevice device)
   return requiredExtensions.empty();
 }
 
+bool
+VulkanInitializer::hasDeviceExtension(VkPhysicalDevice device,
+                                      const char* name)
+{
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(
+    device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+    device, nullptr, &extensionCount, availableExtensions.data());
+
+  for (const auto& extension : availableExtensions) {
+    if (strcmp(extension.extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+VulkanInitializer::hasInstanceExtension(const char* name)
+{
+  uint32_t extensionCount;
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateInstanceExtensionProperties(
+    nullptr, &extensionCount, availableExtensions.data());
+
+  for (const auto& extension : availableExtensions) {
+    if (strcmp(extension.extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+VulkanInitializer::supportsGpuDriven(VkPhysicalDevice device)
+{
+  bool drawIndirectCount =
+    hasDeviceExtension(device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+
+  // the forward pass binds the instances as a fifth set, four is all the spec
+  // guarantees
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+
+  return drawIndirectCount && supportedFeatures.multiDrawIndirect &&
+         supportedFeatures.drawIndirectFirstInstance &&
+         properties.limits.maxBoundDescriptorSets >= 5;
+}
+
+bool
+VulkanInitializer::supportsBindless(VkPhysicalDevice device)
+{
+  if (!physicalDeviceProperties2 ||
+      !hasDeviceExtension(device,
+                          VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+      !hasDeviceExtension(device, VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+    return false;
+  }
+
+  auto getFeatures2 =
+    (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+      vkContext->instance, "vkGetPhysicalDeviceFeatures2KHR");
+  if (getFeatures2 == nullptr) {
+    return false;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+  indexingFeatures.sType =
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  VkPhysicalDeviceFeatures2KHR features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features.pNext = &indexingFeatures;
+  getFeatures2(device, &features);
+
+  // the array plus the two shadow maps of the forward pass
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+  const VkPhysicalDeviceLimits& limits = properties.limits;
+  uint32_t samplers = BINDLESS_MAX_TEXTURES + 2;
+
+  return indexingFeatures.descriptorBindingPartiallyBound &&
+         features.features.shaderSampledImageArrayDynamicIndexing &&
+         limits.maxPerStageDescriptorSamplers >= samplers &&
+         limits.maxPerStageDescriptorSampledImages >= samplers &&
+         limits.maxDescriptorSetSamplers >= samplers &&
+         limits.maxDescriptorSetSampledImages >= samplers &&
+         limits.maxPerStageResources >= samplers;
+}
+
 void
 VulkanInitializer::createLogicalDevice()
 {
@@ -279,6 +457,9 @@ VulkanInitializer::createLogicalDevice()
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(),
                                              indices.presentFamily.value() };
+  if (indices.transferFamily.has_value()) {
+    uniqueQueueFamilies.insert(indices.transferFamily.value());
+  }
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -293,15 +474,36 @@ VulkanInitializer::createLogicalDevice()
   VkPhysicalDeviceFeatures deviceFeatures{};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+  std::vector<const char*> enabledExtensions = deviceExtensions;
+  bool gpuDriven =
+    GPU_DRIVEN_RENDERING && supportsGpuDriven(vkContext->physicalDevice);
+  if (gpuDriven) {
+    enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    deviceFeatures.multiDrawIndirect = VK_TRUE;
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+  indexingFeatures.sType =
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  bindless = BINDLESS_TEXTURES && supportsBindless(vkContext->physicalDevice);
+  if (bindless) {
+    enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+    enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+  }
+
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = bindless ? &indexingFeatures : nullptr;
   createInfo.pEnabledFeatures = &deviceFeatures;
   createInfo.queueCreateInfoCount =
     static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.enabledExtensionCount =
-    static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    static_cast<uint32_t>(enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   if (enableValidationLayers) {
     createInfo.enabledLayerCount =
@@ -318,6 +520,12 @@ VulkanInitializer::createLogicalDevice()
     throw std::runtime_error("failed to create logical device!");
   }
 
+  if (gpuDriven) {
+    vkContext->cmdDrawIndexedIndirectCount =
+      (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+        vkContext->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR");
+  }
+
   vkGetDeviceQueue(vkContext->logicalDevice,
                    indices.graphicsFamily.value(),
                    0,
@@ -14,6 +14,9 @@ class VulkanInitializer
 {
 public:
   VulkanInitializer(GLFWwindow* window);
+  // headless: no window, no surface. renders into offscreen images of the
+  // given size (see VulkanSwapchain::isHeadless())
+  VulkanInitializer(int width, int height);
 
   VulkanContext* vkContext;
   VulkanSwapchain* vkSwapchain;
@@ -21,6 +24,8 @@ public:
   ~VulkanInitializer();
 
 private:
+  void init();
+
   VkDebugUtilsMessengerEXT debugMessenger;
   void setupDebugMessenger();
 
@@ -36,6 +41,8 @@ private:
 
   bool isDeviceSuitable(VkPhysicalDevice device);
 
+  // the swapchain extension stays on in headless mode too: the presentation
+  // pass still transitions its output to PRESENT_SRC_KHR
 #ifdef __APPLE__
   const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME,
@@ -48,6 +55,20 @@ private:
 #endif
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
 
+  // everything the GpuCuller needs, checked on the picked device only. the
+  // device stays suitable without it
+  bool supportsGpuDriven(VkPhysicalDevice device);
+
+  // VK_EXT_descriptor_indexing with partially bound sampler arrays big enough
+  // for BindlessTextures. needs vkGetPhysicalDeviceFeatures2KHR to ask, so
+  // the instance has to have VK_KHR_get_physical_device_properties2
+  bool supportsBindless(VkPhysicalDevice device);
+  bool physicalDeviceProperties2 = false;
+  bool bindless = false;
+
+  bool hasDeviceExtension(VkPhysicalDevice device, const char* name);
+  bool hasInstanceExtension(const char* name);
+
   VkPhysicalDeviceProperties deviceProperties{};
   VkPhysicalDeviceFeatures deviceFeatures{};
   VkPhysicalDeviceMemoryProperties deviceMemoryProperties{};
@@ -9,6 +9,9 @@ struct QueueFamilyIndices
 {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // a family that can copy but not draw, usually backed by a dma engine. not
+  // every device has one, uploads go through the graphics queue then
+  std::optional<uint32_t> transferFamily;
 
   bool isComplete()
   {
@@ -30,18 +33,36 @@ struct QueueFamilyIndices
 
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-      if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-        indices.graphicsFamily = i;
-      }
+      if (!indices.isComplete()) {
+        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+          indices.graphicsFamily = i;
+        }
+
+        // headless: nothing is ever presented, so the "present" queue is just
+        // the graphics one
+        if (surface == VK_NULL_HANDLE) {
+          if (indices.graphicsFamily.has_value()) {
+            indices.presentFamily = indices.graphicsFamily;
+          }
+        } else {
+          VkBool32 presentSupport = false;
+          vkGetPhysicalDeviceSurfaceSupportKHR(
+            device, i, surface, &presentSupport);
 
-      VkBool32 presentSupport = false;
-      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+          if (presentSupport) {
+            indices.presentFamily = i;
+          }
+        }
+      }
 
-      if (presentSupport) {
-        indices.presentFamily = i;
+      if (!indices.transferFamily.has_value() &&
+          (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+          !(queueFamily.queueFlags &
+            (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+        indices.transferFamily = i;
       }
 
-      if (indices.isComplete()) {
+      if (indices.isComplete() && indices.transferFamily.has_value()) {
         break;
       }
 
@@ -2,10 +2,13 @@
 
 #include <algorithm>
 #include <array>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
 #include "GLFW/glfw3.h"
+#include "engine/Profiler.h"
+#include "engine/StagingRing.h"
 #include "engine/VulkanQueueFamiliesHelper.h"
 
 void
@@ -26,17 +29,39 @@ VulkanSwapchain::VulkanSwapchain(VulkanContext* vkContext, GLFWwindow* window)
   glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
 }
 
+VulkanSwapchain::VulkanSwapchain(VulkanContext* vkContext, int width, int height)
+  : resized(false)
+  , width(width)
+  , height(height)
+  , headless(true)
+  , window(nullptr)
+  , vkContext(vkContext)
+  , surface(VK_NULL_HANDLE)
+{
+}
+
 VulkanSwapchain::~VulkanSwapchain()
 {
   cleanSwapChain();
 
-  vkDestroySurfaceKHR(vkContext->instance, surface, nullptr);
+  if (!headless) {
+    vkDestroySurfaceKHR(vkContext->instance, surface, nullptr);
+  }
+
+  for (auto& readbackBuffer : readbackBuffers) {
+    if (readbackBuffer.buffer != VK_NULL_HANDLE) {
+      vmaDestroyBuffer(
+        vkContext->allocator, readbackBuffer.buffer, readbackBuffer.allocation);
+    }
+  }
 
-  vkDestroySemaphore(
-    vkContext->logicalDevice, renderFinishedSemaphore, nullptr);
-  vkDestroySemaphore(
-    vkContext->logicalDevice, imageAvailableSemaphore, nullptr);
-  vkDestroyFence(vkContext->logicalDevice, inFlightFence, nullptr);
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    vkDestroySemaphore(
+      vkContext->logicalDevice, renderFinishedSemaphores[i], nullptr);
+    vkDestroySemaphore(
+      vkContext->logicalDevice, imageAvailableSemaphores[i], nullptr);
+    vkDestroyFence(vkContext->logicalDevice, inFlightFences[i], nullptr);
+  }
 }
 
 void
@@ -111,26 +136,48 @@ VulkanSwapchain::createCommandBuffer()
   allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   allocInfo.commandPool = vkContext->commandPool;
   allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = 1;
+  allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
-  if (vkAllocateCommandBuffers(
-        vkContext->logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+  if (vkAllocateCommandBuffers(vkContext->logicalDevice,
+                               &allocInfo,
+                               commandBuffers.data()) != VK_SUCCESS) {
     throw std::runtime_error("failed to allocate command buffers!");
   }
+
+  commandBuffer = commandBuffers[currentFrame];
 }
 
 void
 VulkanSwapchain::prepareFrame()
 {
-  vkWaitForFences(
-    vkContext->logicalDevice, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-
-  VkResult result = vkAcquireNextImageKHR(vkContext->logicalDevice,
-                                          swapChain,
-                                          UINT64_MAX,
-                                          imageAvailableSemaphore,
-                                          VK_NULL_HANDLE,
-                                          &imageIndex);
+  // only wait for the last frame that used this slot, not the previous one
+  vkContext->profiler->beginCpuScope("wait for frame");
+  vkWaitForFences(vkContext->logicalDevice,
+                  1,
+                  &inFlightFences[currentFrame],
+                  VK_TRUE,
+                  UINT64_MAX);
+  vkContext->profiler->endCpuScope();
+
+  // whatever this slot took from the staging ring last time is free again
+  vkContext->stagingRing->release(stagingRegions[currentFrame]);
+  stagingRegions[currentFrame] = 0;
+
+  commandBuffer = commandBuffers[currentFrame];
+
+  VkResult result = VK_SUCCESS;
+  if (headless) {
+    // every frame slot owns its offscreen image, the fence above already
+    // guarantees the gpu is done with it
+    imageIndex = currentFrame;
+  } else {
+    result = vkAcquireNextImageKHR(vkContext->logicalDevice,
+                                   swapChain,
+                                   UINT64_MAX,
+                                   imageAvailableSemaphores[currentFrame],
+                                   VK_NULL_HANDLE,
+                                   &imageIndex);
+  }
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     recreateSwapChain();
@@ -139,7 +186,7 @@ VulkanSwapchain::prepareFrame()
     throw std::runtime_error("failed to acquire swap chain image!");
   }
 
-  vkResetFences(vkContext->logicalDevice, 1, &inFlightFence);
+  vkResetFences(vkContext->logicalDevice, 1, &inFlightFences[currentFrame]);
   vkResetCommandBuffer(commandBuffer, 0);
 
   VkCommandBufferBeginInfo beginInfo{};
@@ -147,11 +194,19 @@ VulkanSwapchain::prepareFrame()
   if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
     throw std::runtime_error("failed to begin recording command buffer!");
   }
+
+  vkContext->profiler->beginFrame(commandBuffer, currentFrame);
 }
 
 void
 VulkanSwapchain::submitFrame()
 {
+  if (headless && readbackEnabled) {
+    recordReadback();
+  }
+
+  vkContext->profiler->endFrame(commandBuffer);
+
   if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to record command buffer!");
   }
@@ -159,25 +214,39 @@ VulkanSwapchain::submitFrame()
   VkSubmitInfo submitInfo{};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
+  VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
   VkPipelineStageFlags waitStages[] = {
     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
   };
-  submitInfo.waitSemaphoreCount = 1;
+  submitInfo.waitSemaphoreCount = headless ? 0 : 1;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
   submitInfo.commandBufferCount = 1;
   submitInfo.pCommandBuffers = &commandBuffer;
 
-  VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
-  submitInfo.signalSemaphoreCount = 1;
+  VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+  submitInfo.signalSemaphoreCount = headless ? 0 : 1;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
-  if (vkQueueSubmit(vkContext->graphicsQueue, 1, &submitInfo, inFlightFence) !=
-      VK_SUCCESS) {
+  stagingRegions[currentFrame] = vkContext->stagingRing->closeRegion();
+
+  vkContext->profiler->beginCpuScope("submit");
+  if (vkQueueSubmit(vkContext->graphicsQueue,
+                    1,
+                    &submitInfo,
+                    inFlightFences[currentFrame]) != VK_SUCCESS) {
     throw std::runtime_error("failed to submit draw command buffer!");
   }
+  vkContext->profiler->endCpuScope();
+
+  lastSubmittedFrame = currentFrame;
+
+  // nothing to present when headless
+  if (headless) {
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    return;
+  }
 
   VkPresentInfoKHR presentInfo{};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -191,7 +260,11 @@ VulkanSwapchain::submitFrame()
 
   presentInfo.pImageIndices = &imageIndex;
 
+  vkContext->profiler->beginCpuScope("present");
   VkResult result = vkQueuePresentKHR(vkContext->presentQueue, &presentInfo);
+  vkContext->profiler->endCpuScope();
+
+  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
       resized == true) {
@@ -205,6 +278,12 @@ VulkanSwapchain::submitFrame()
 void
 VulkanSwapchain::createSwapChain()
 {
+  if (headless) {
+    createOffscreenImages();
+    createDepthResources();
+    return;
+  }
+
   SwapChainSupportDetails swapChainSupport =
     querySwapChainSupport(vkContext->physicalDevice);
 
@@ -272,7 +351,12 @@ VulkanSwapchain::createSwapChain()
       swapChainImages[i], swapChainImageFormat, 1, VK_IMAGE_ASPECT_COLOR_BIT);
   }
 
-  // create depth resources
+  createDepthResources();
+}
+
+void
+VulkanSwapchain::createDepthResources()
+{
   depthFormat = vkContext->findSupportedFormat(
     { VK_FORMAT_D32_SFLOAT,
       VK_FORMAT_D32_SFLOAT_S8_UINT,
@@ -323,10 +407,19 @@ VulkanSwapchain::cleanSwapChain()
     vkDestroyImageView(vkContext->logicalDevice, imageView, nullptr);
   }
 
+  if (headless) {
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+      vmaDestroyImage(
+        vkContext->allocator, swapChainImages[i], offscreenAllocations[i]);
+    }
+  }
+
   vmaDestroyImage(vkContext->allocator, depthImage, depthAllocation);
   vkDestroyImageView(vkContext->logicalDevice, depthImageView, nullptr);
 
-  vkDestroySwapchainKHR(vkContext->logicalDevice, swapChain, nullptr);
+  if (!headless) {
+    vkDestroySwapchainKHR(vkContext->logicalDevice, swapChain, nullptr);
+  }
 }
 
 VkSurfaceFormatKHR
@@ -391,18 +484,159 @@ VulkanSwapchain::createSyncObjects()
   fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-  if (vkCreateSemaphore(vkContext->logicalDevice,
-                        &semaphoreInfo,
-                        nullptr,
-                        &imageAvailableSemaphore) != VK_SUCCESS ||
-      vkCreateSemaphore(vkContext->logicalDevice,
-                        &semaphoreInfo,
-                        nullptr,
-                        &renderFinishedSemaphore) != VK_SUCCESS ||
-      vkCreateFence(
-        vkContext->logicalDevice, &fenceInfo, nullptr, &inFlightFence) !=
-        VK_SUCCESS) {
-    throw std::runtime_error(
-      "failed to create synchronization objects for a frame!");
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    if (vkCreateSemaphore(vkContext->logicalDevice,
+                          &semaphoreInfo,
+                          nullptr,
+                          &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+        vkCreateSemaphore(vkContext->logicalDevice,
+                          &semaphoreInfo,
+                          nullptr,
+                          &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+        vkCreateFence(
+          vkContext->logicalDevice, &fenceInfo, nullptr, &inFlightFences[i]) !=
+          VK_SUCCESS) {
+      throw std::runtime_error(
+        "failed to create synchronization objects for a frame!");
+    }
+  }
+}
+
+void
+VulkanSwapchain::createOffscreenImages()
+{
+  // same format a desktop swapchain would most likely give us, so the passes
+  // and their pipelines don't have to care which one they're rendering into
+  swapChainImageFormat =
+    vkContext->findSupportedFormat({ VK_FORMAT_B8G8R8A8_SRGB,
+                                     VK_FORMAT_R8G8B8A8_SRGB },
+                                   VK_IMAGE_TILING_OPTIMAL,
+                                   VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+  swapChainExtent = { static_cast<uint32_t>(width),
+                      static_cast<uint32_t>(height) };
+
+  swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+  swapChainImageViews.resize(MAX_FRAMES_IN_FLIGHT);
+  offscreenAllocations.resize(MAX_FRAMES_IN_FLIGHT);
+
+  for (size_t i = 0; i < swapChainImages.size(); i++) {
+    swapChainImages[i] = vkContext->createImage(
+      swapChainExtent.width,
+      swapChainExtent.height,
+      swapChainImageFormat,
+      1,
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+      VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+      offscreenAllocations[i]);
+
+    swapChainImageViews[i] = vkContext->createImageView(
+      swapChainImages[i], swapChainImageFormat, 1, VK_IMAGE_ASPECT_COLOR_BIT);
+  }
+}
+
+void
+VulkanSwapchain::recordReadback()
+{
+  VulkanBufferDefinition& readbackBuffer = readbackBuffers[currentFrame];
+
+  if (readbackBuffer.buffer == VK_NULL_HANDLE) {
+    readbackBuffer.size = swapChainExtent.width * swapChainExtent.height * 4;
+    readbackBuffer.mapped =
+      vkContext->createBuffer(readbackBuffer.size,
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              BufferType::READBACK_BUFFER,
+                              readbackBuffer.buffer,
+                              readbackBuffer.allocation);
   }
+
+  // the presentation pass leaves the image in PRESENT_SRC_KHR
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = swapChainImages[imageIndex];
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       0,
+                       nullptr,
+                       1,
+                       &barrier);
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = { 0, 0, 0 };
+  region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+
+  vkCmdCopyImageToBuffer(commandBuffer,
+                         swapChainImages[imageIndex],
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         readbackBuffer.buffer,
+                         1,
+                         &region);
+
+  VkBufferMemoryBarrier bufferBarrier{};
+  bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.buffer = readbackBuffer.buffer;
+  bufferBarrier.offset = 0;
+  bufferBarrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT,
+                       0,
+                       0,
+                       nullptr,
+                       1,
+                       &bufferBarrier,
+                       0,
+                       nullptr);
+}
+
+void
+VulkanSwapchain::readbackLastFrame(std::vector<uint8_t>& pixels)
+{
+  const VulkanBufferDefinition& readbackBuffer =
+    readbackBuffers[lastSubmittedFrame];
+
+  if (!headless || readbackBuffer.buffer == VK_NULL_HANDLE) {
+    throw std::runtime_error("no headless frame has been read back yet!");
+  }
+
+  vkWaitForFences(vkContext->logicalDevice,
+                  1,
+                  &inFlightFences[lastSubmittedFrame],
+                  VK_TRUE,
+                  UINT64_MAX);
+
+  vmaInvalidateAllocation(
+    vkContext->allocator, readbackBuffer.allocation, 0, VK_WHOLE_SIZE);
+
+  // tightly packed rows, 4 bytes per pixel in swapChainImageFormat order
+  pixels.resize(readbackBuffer.size);
+  memcpy(pixels.data(), readbackBuffer.mapped, readbackBuffer.size);
 }
@@ -4,6 +4,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <array>
 #include <functional>
 #include <vector>
 #include <vk_mem_alloc.h>
@@ -24,12 +25,26 @@ public:
   void recreateSwapChain();
   void createSwapChainFrameBuffer();
 
+  // command buffer of the frame currently being recorded, passes only ever
+  // see this one. it gets swapped at every prepareFrame()
   VkCommandBuffer commandBuffer;
   void createCommandBuffer();
 
+  // index of the frame in flight being recorded, in [0, MAX_FRAMES_IN_FLIGHT)
+  uint32_t currentFrame = 0;
+
   void prepareFrame();
   void submitFrame();
 
+  // headless mode renders into MAX_FRAMES_IN_FLIGHT offscreen images instead
+  // of a VkSwapchainKHR. there is no surface and nothing gets presented
+  bool isHeadless() const { return headless; }
+
+  // when set (headless only) every frame is copied into a host visible buffer
+  // that can be fetched with readbackLastFrame()
+  bool readbackEnabled = false;
+  void readbackLastFrame(std::vector<uint8_t>& pixels);
+
   bool resized;
   int width;
   int height;
@@ -46,8 +61,11 @@ private:
   friend VulkanInitializer;
 
   VulkanSwapchain(VulkanContext* vkContext, GLFWwindow* window);
+  VulkanSwapchain(VulkanContext* vkContext, int width, int height);
   ~VulkanSwapchain();
 
+  bool headless = false;
+
   static void framebufferResizeCallback(GLFWwindow* window,
                                         int width,
                                         int height);
@@ -68,8 +86,17 @@ private:
   std::vector<VkImageView> swapChainImageViews;
   VkFormat swapChainImageFormat;
   void createSwapChain();
+  void createDepthResources();
   void cleanSwapChain();
 
+  // -------------------- HEADLESS --------------------
+  std::vector<VmaAllocation> offscreenAllocations;
+  void createOffscreenImages();
+
+  std::array<VulkanBufferDefinition, MAX_FRAMES_IN_FLIGHT> readbackBuffers{};
+  uint32_t lastSubmittedFrame = 0;
+  void recordReadback();
+
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(
     const std::vector<VkSurfaceFormatKHR>& availableFormats);
   VkPresentModeKHR chooseSwapPresentMode(
@@ -77,10 +104,17 @@ private:
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities,
                               GLFWwindow* window);
 
-  VkSemaphore imageAvailableSemaphore;
-  VkSemaphore renderFinishedSemaphore;
-  VkFence inFlightFence;
+  // one set of these per frame in flight, so the cpu can record frame n+1
+  // while the gpu is still busy with frame n
+  std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> commandBuffers;
+  std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> imageAvailableSemaphores;
+  std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> renderFinishedSemaphores;
+  std::array<VkFence, MAX_FRAMES_IN_FLIGHT> inFlightFences;
   void createSyncObjects();
+
+  // staging ring region used by each frame's uniform data, released once the
+  // frame's fence has been waited on
+  std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> stagingRegions{};
 };
 
 struct SwapChainSupportDetails
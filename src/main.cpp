@@ -1,5 +1,7 @@
 #include "GLFW/glfw3.h"
 
+#include "engine/CameraPath.h"
+#include "engine/Profiler.h"
 #include "engine/Renderer.h"
 
 #include "engine/VulkanInitializer.h"
@@ -10,16 +12,59 @@
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
 #include <thread>
 
 std::chrono::microseconds
 calculateFrameDuration(int target_fps);
 void
 moveCamera(GLFWwindow* window, float deltaTime, Camera3D* camera);
+int
+runHeadless(uint32_t frameCount,
+            const std::string& dumpPath,
+            const std::string& tracePath);
+void
+reportProfile(Profiler* profiler, const std::string& tracePath);
+void
+writePPM(const std::string& path,
+         const std::vector<uint8_t>& pixels,
+         VkFormat format,
+         VkExtent2D extent);
 
 int
-main()
+main(int argc, char** argv)
 {
+  // --headless [--frames N] [--dump out.ppm]: render without a window or a
+  // display, e.g. on a build machine with a software implementation
+  // --trace out.json: write a chrome trace of the whole run on exit
+  // --record-path out.txt: press K to drop a camera keyframe, the path is
+  // saved on exit and can be replayed with Vulkan_Benchmark --path
+  bool headless = false;
+  uint32_t headlessFrames = 1000;
+  std::string dumpPath;
+  std::string tracePath;
+  std::string recordPath;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--headless") == 0) {
+      headless = true;
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      headlessFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+    } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+      dumpPath = argv[++i];
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      tracePath = argv[++i];
+    } else if (strcmp(argv[i], "--record-path") == 0 && i + 1 < argc) {
+      recordPath = argv[++i];
+    }
+  }
+
+  if (headless) {
+    return runHeadless(headlessFrames, dumpPath, tracePath);
+  }
+
   GLFWwindow* window;
 
   glfwInit();
@@ -41,10 +86,15 @@ main()
 
   Renderer renderer(vkContext, vkInitializer.vkSwapchain, scene);
 
+  vkContext->profiler->captureTrace = !tracePath.empty();
+
   auto frame_duration = calculateFrameDuration(60.0f);
   frame_duration = std::chrono::microseconds(8333);
   auto lastFrameTime = std::chrono::steady_clock::now();
 
+  CameraPath recordedPath;
+  bool keyframeKeyDown = false;
+
   while (!glfwWindowShouldClose(window)) {
     auto frameStart = std::chrono::steady_clock::now();
     std::chrono::duration<float> deltaTime = frameStart - lastFrameTime;
@@ -57,6 +107,13 @@ main()
     }
 
     moveCamera(window, deltaTime.count(), scene.camera);
+
+    bool keyframeKeyPressed = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS;
+    if (!recordPath.empty() && keyframeKeyPressed && !keyframeKeyDown) {
+      recordedPath.addKeyframe(*scene.camera);
+    }
+    keyframeKeyDown = keyframeKeyPressed;
+
     scene.update();
 
     renderer.draw(scene);
@@ -74,9 +131,100 @@ main()
   }
   vkDeviceWaitIdle(vkContext->logicalDevice);
 
+  reportProfile(vkContext->profiler, tracePath);
+
+  if (!recordedPath.empty()) {
+    recordedPath.save(recordPath);
+    std::cout << "camera path written to " << recordPath << std::endl;
+  }
+
+  return 0;
+}
+
+int
+runHeadless(uint32_t frameCount,
+            const std::string& dumpPath,
+            const std::string& tracePath)
+{
+  const int width = 800;
+  const int height = 600;
+
+  VulkanInitializer vkInitializer(width, height);
+  VulkanContext* vkContext = vkInitializer.vkContext;
+  VulkanSwapchain* vkSwapchain = vkInitializer.vkSwapchain;
+
+  Scene scene(vkContext);
+  scene.camera->resizeCamera(width, height);
+
+  Renderer renderer(vkContext, vkSwapchain, scene);
+
+  vkSwapchain->readbackEnabled = !dumpPath.empty();
+  vkContext->profiler->captureTrace = !tracePath.empty();
+
+  // no pacing here, we want to know how fast it can go
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < frameCount; i++) {
+    scene.update();
+    renderer.draw(scene);
+  }
+  vkDeviceWaitIdle(vkContext->logicalDevice);
+  std::chrono::duration<double, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  double frameTime = frameCount > 0 ? elapsed.count() / frameCount : 0.0;
+  std::cout << "headless: " << frameCount << " frames in " << elapsed.count()
+            << " ms (" << frameTime << " ms/frame, "
+            << (frameTime > 0.0 ? 1000.0 / frameTime : 0.0) << " fps)"
+            << std::endl;
+
+  if (!dumpPath.empty() && frameCount > 0) {
+    std::vector<uint8_t> pixels;
+    vkSwapchain->readbackLastFrame(pixels);
+    writePPM(dumpPath,
+             pixels,
+             vkSwapchain->getSwapChainImageFormat(),
+             vkSwapchain->swapChainExtent);
+  }
+
+  reportProfile(vkContext->profiler, tracePath);
+
   return 0;
 }
 
+void
+reportProfile(Profiler* profiler, const std::string& tracePath)
+{
+  profiler->printSummary(std::cout);
+
+  if (!tracePath.empty()) {
+    profiler->exportChromeTrace(tracePath);
+    std::cout << "trace written to " << tracePath << std::endl;
+  }
+}
+
+void
+writePPM(const std::string& path,
+         const std::vector<uint8_t>& pixels,
+         VkFormat format,
+         VkExtent2D extent)
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open file! " + path);
+  }
+
+  file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+
+  bool bgra = format == VK_FORMAT_B8G8R8A8_SRGB ||
+              format == VK_FORMAT_B8G8R8A8_UNORM;
+  for (size_t i = 0; i + 3 < pixels.size(); i += 4) {
+    char rgb[3] = { static_cast<char>(pixels[i + (bgra ? 2 : 0)]),
+                    static_cast<char>(pixels[i + 1]),
+                    static_cast<char>(pixels[i + (bgra ? 0 : 2)]) };
+    file.write(rgb, 3);
+  }
+}
+
 std::chrono::microseconds
 calculateFrameDuration(int target_fps)
 {